@@ -22,6 +22,9 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#ifdef __linux__
+	#define _GNU_SOURCE /* sendmmsg */
+#endif
 #include <stdlib.h> /* malloc, free, EXIT_X, ...*/
 #include <stdio.h> /* printf, fprintf, recvfrom */
 #include <unistd.h> /* getopt */
@@ -46,6 +49,8 @@ SOFTWARE.
 #define MIN_PKT_LEN 12
 /* Max packet length in the protocol */
 #define MAX_PKT_LEN 528
+/* Max number of packets sent in a single syscall */
+#define OUT_BATCH 32
 /* Random number between 0 and 100 */
 #define RAND_PERCENT ((unsigned int)(rand() % 101))
 
@@ -122,7 +127,47 @@ static void timeval_diff(const struct timeval *a,
 	fprintf(stderr,"[SEQ %3u] " fmt, (uint8_t)buf[1], ##__VA_ARGS__)
 #define LOG_PKT(buf, msg) LOG_PKT_FMT(buf, msg "\n")
 
-/* Send a packet to the host we're proxying */
+#ifdef __linux__
+/* Packets waiting to be sent, flushed with a single sendmmsg */
+static struct mmsghdr out_msgs[OUT_BATCH];
+static struct iovec out_iov[OUT_BATCH];
+static char out_buf[OUT_BATCH][MAX_PKT_LEN];
+static int out_count = 0;
+
+/* Send all packets queued by write_out.
+ * If the send buffer is full, the remaining packets are dropped,
+ * as a congested link would do. */
+static int flush_out()
+{
+	int sent = 0;
+	while (sent < out_count) {
+		int n = sendmmsg(sfd, out_msgs + sent, out_count - sent, 0);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EWOULDBLOCK || errno == EAGAIN) {
+				fprintf(stderr, "@@ Send buffer full, dropping %d packet(s)\n",
+						out_count - sent);
+				break;
+			}
+			out_count = 0;
+			return EXIT_FAILURE;
+		}
+		sent += n;
+	}
+	out_count = 0;
+	return EXIT_SUCCESS;
+}
+#else
+/* Packets are sent as soon as they are written out */
+static int flush_out()
+{
+	return EXIT_SUCCESS;
+}
+#endif /* __linux__ */
+
+/* Send a packet to the host we're proxying
+ * (queued until the next flush_out on Linux) */
 static int write_out(const char *buf, int len, int direction)
 {
 	struct sockaddr_in6 *addr;
@@ -135,8 +180,22 @@ static int write_out(const char *buf, int len, int direction)
 				 break;
 	};
 	LOG_PKT_FMT(buf, "Sent packet (%s).\n", get_link_direction(direction));
+#ifdef __linux__
+	memcpy(out_buf[out_count], buf, len);
+	out_iov[out_count].iov_base = out_buf[out_count];
+	out_iov[out_count].iov_len = len;
+	memset(&out_msgs[out_count], 0, sizeof(out_msgs[out_count]));
+	out_msgs[out_count].msg_hdr.msg_name = addr;
+	out_msgs[out_count].msg_hdr.msg_namelen = sizeof(*addr);
+	out_msgs[out_count].msg_hdr.msg_iov = &out_iov[out_count];
+	out_msgs[out_count].msg_hdr.msg_iovlen = 1;
+	if (++out_count == OUT_BATCH)
+		return flush_out();
+	return EXIT_SUCCESS;
+#else
 	return sendto(sfd, buf, len, 0, (struct sockaddr*)addr,
 			sizeof(*addr)) == len ? EXIT_SUCCESS : EXIT_FAILURE;
+#endif /* __linux__ */
 }
 
 /* Deliver all queued packets whose timestamps have expired */
@@ -235,8 +294,9 @@ static inline int simulate_link(char *buf, int len, int direction)
 	return EXIT_SUCCESS;
 }
 
-/* sfd has been marked for reading, handle the read and process the packet */
-static int process_incoming_pkt()
+/* sfd has been marked for reading, handle the read and process the packet.
+ * *drained is set once no more packets are waiting on sfd. */
+static int process_incoming_pkt(int *drained)
 {
 	struct sockaddr_in6 from; /* Whois the one sending us data? */
 	socklen_t len_from = sizeof(from);
@@ -247,8 +307,10 @@ static int process_incoming_pkt()
 		/* Ignore if we have been interrupted by a signal,
 		 * or if select marked sfd as ready for reading
 		 * without any no data available. */
-		if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+		if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+			*drained = 1;
 			return EXIT_SUCCESS;
+		}
 		/* Real error, abort mission */
 		perror("recv failed");
 		return EXIT_FAILURE;
@@ -338,6 +400,18 @@ static struct timeval* get_queue_timeout()
 	return &timeout;
 }
 
+/* Process up to OUT_BATCH incoming packets, so that they can be relayed
+ * with a single syscall */
+static int process_incoming_batch()
+{
+	int drained = 0;
+	int i;
+	for (i = 0; i < OUT_BATCH && !drained; ++i)
+		if (process_incoming_pkt(&drained))
+			return EXIT_FAILURE;
+	return EXIT_SUCCESS;
+}
+
 /* Loop forever, waiting on packet to process */
 static int proxy_loop()
 {
@@ -361,7 +435,9 @@ static int proxy_loop()
 		if (update_time() || /* Update time cache */
 			deliver_delayed_pkt() || /* Deliver delayed packets */
 			/* Process incoming packets, applying drop rates etc */
-			(FD_ISSET(sfd, &rfds) && process_incoming_pkt()))
+			(FD_ISSET(sfd, &rfds) && process_incoming_batch()) ||
+			/* Send everything that is ready */
+			flush_out())
 			break;
 	}
 	/* Reached only on error */
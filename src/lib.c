@@ -1,3 +1,6 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // sendmmsg, recvmmsg
+#endif
 #include "lib.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -11,38 +14,72 @@
 #include <netinet/in.h>
 #include <sys/select.h>
 #include <sys/time.h>
+#include <sys/uio.h>
+#include <netinet/udp.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <signal.h>
+#include <poll.h>
+#include <linux/errqueue.h>
 #include <unistd.h>
 #include <getopt.h>
 #include <math.h>
 #include <inttypes.h>
 #include <ctype.h>
 #include <time.h>
+#include <errno.h>
 #include <zlib.h>
+#include <endian.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
 
 // Definition de la structure d'un paquet
-struct __attribute__((__packed__)) pkt {
-  char * payload;
+/* Le header est en tete et tient dans une seule ligne de cache, le payload
+ * suit directement dans la meme allocation, dimensionnee a sa capacite */
+struct __attribute__((aligned(PKT_SLOT_ALIGN))) pkt {
   // Ne pas oublier d'inverser le sens des bits
   uint8_t window:5; // Encode sur 5 bits
   uint8_t tr:1; // Encode sur 1 bit
   uint8_t type:2; // Encode sur 2 bits
-  uint8_t seqnum; // Encode sur 8 bits
+  uint8_t ext; // 1 si le numero de sequence est encode sur 32 bits
+  uint8_t csum; // Checksum des CRC1 et CRC2 (CSUM_CRC32 ou CSUM_CRC32C)
   uint16_t length; // Encode sur 16 bits
+  uint32_t seqnum; // Encode sur 8 bits, sur 32 bits avec l'extension
   uint32_t timestamp; // Encode sur 32 bits (4 octets)
   uint32_t crc1; // Encode sur 32 bits (4 octets)
   uint32_t crc2; // Encode sur 32 bits (4 octets)
+  uint16_t capacite; // Taille maximale du payload
+  const char *payload_ref; // Payload hors du paquet (fichier projete en memoire), NULL s'il suit le header
+  char payload[];
 };
 
-struct __attribute__((__packed__)) ack {
-  uint8_t window:5; // Encode sur 5 bits
-  uint8_t tr:1; // Encode sur 1 bit
-  uint8_t type:2; // Encode sur 2 bits
-  uint8_t seqnum; // Encode sur 8 bits
-  uint16_t length; // Encode sur 16 bits
-  uint32_t timestamp; // Encode sur 32 bits (4 octets)
-  uint32_t crc1; // Encode sur 32 bits (4 octets)
+/* Slab de paquets : un tableau contigu de slots et la pile des slots libres */
+struct pkt_slab {
+  char *slots; // nb_slots paquets alignes sur une ligne de cache
+  size_t taille_slot; // Taille d'un slot, multiple de PKT_SLOT_ALIGN
+  uint16_t capacite; // Taille maximale du payload de chaque paquet
+  uint16_t *libres; // Indices des slots disponibles
+  int nb_libres;
+  int nb_slots;
 };
 
+/*
+* taille_pkt : Calcule la taille d'une allocation de paquet
+*
+* @capacite : la taille maximale du payload
+*
+* @return : la taille du header et du payload, arrondie a une ligne de cache
+*/
+static size_t taille_pkt(uint16_t capacite){
+  size_t taille = offsetof(pkt_t, payload) + capacite;
+  return (taille + PKT_SLOT_ALIGN - 1) & ~((size_t) PKT_SLOT_ALIGN - 1);
+}
+
 /*
 * pkt_new : Fonction qui crée un nouveau paquet de type PTYPE_DATA
 *
@@ -50,27 +87,51 @@ struct __attribute__((__packed__)) ack {
 */
 pkt_t* pkt_new()
 {
-  pkt_t * new = (pkt_t *) malloc(sizeof(pkt_t));
+  return pkt_new_taille(MAX_PAYLOAD_SIZE);
+}
+
+/*
+* pkt_new_taille : Fonction qui crée un nouveau paquet de type PTYPE_DATA
+* pouvant contenir un payload de taille donnee
+*
+* @capacite : la taille maximale du payload (au plus MSS_MAX)
+* @return : un nouveau paquet de type PTYPE_DATA ou NULL en cas d'erreur
+*/
+pkt_t* pkt_new_taille(uint16_t capacite)
+{
+  // Header et payload dans une seule allocation
+  pkt_t * new = (pkt_t *) aligned_alloc(PKT_SLOT_ALIGN, taille_pkt(capacite));
   if (new == NULL){
     fprintf(stderr, "Erreur du malloc");
     return NULL;
   }
-  new->window = 0; // Par definition, on fait commencer la fenetre à 1
-  new->tr = 0;
-  new->type = PTYPE_DATA;
-  new->seqnum = 0;
-  new->length = 0;
-  new->timestamp = 0;
-  new->crc1 = 0;
-  new->crc2 = 0;
-  new->payload = (char *)malloc(MAX_PAYLOAD_SIZE*sizeof(char));
-  if (new->payload == NULL){
-    fprintf(stderr, "Erreur du malloc");
-    return NULL;
-  }
+  new->capacite = capacite;
+  pkt_reset(new);
   return new;
 }
 
+/*
+* pkt_reset : Remet a zero le header d'un paquet, qui redevient un paquet
+* de type PTYPE_DATA vide
+*
+* @pkt : pointeur vers un paquet
+* @return : /
+*/
+void pkt_reset(pkt_t *pkt)
+{
+  pkt->window = 0; // Par definition, on fait commencer la fenetre à 1
+  pkt->tr = 0;
+  pkt->type = PTYPE_DATA;
+  pkt->ext = 0;
+  pkt->csum = CSUM_CRC32;
+  pkt->seqnum = 0;
+  pkt->length = 0;
+  pkt->timestamp = 0;
+  pkt->crc1 = 0;
+  pkt->crc2 = 0;
+  pkt->payload_ref = NULL;
+}
+
 /*
 * pkt_ack_new : Fonction qui crée un nouveau paquet de type PTYPE_ACK
 *
@@ -89,6 +150,17 @@ ack_t* ack_new(){
   new->length = 0;
   new->timestamp = 0;
   new->crc1 = 0;
+  new->has_sack = 0;
+  new->nb_sack = 0;
+  new->has_wscale = 0;
+  new->wscale = 0;
+  new->has_seq32 = 0;
+  new->has_mss = 0;
+  new->mss = 0;
+  new->mss_recu = 0;
+  new->sack_ok = 0;
+  new->ack_delay = 0;
+  new->csum = 0;
   return new;
 }
 
@@ -102,7 +174,6 @@ ack_t* ack_new(){
 */
 void pkt_del(pkt_t *pkt)
 {
-  free(pkt->payload);
   free(pkt);
 }
 
@@ -146,13 +217,48 @@ uint8_t  pkt_get_window(const pkt_t * pkt)
 * du paquet place en argument
 *
 * @pkt : pointeur vers un paquet
-* @return : le numero de sequence du paquet
+* @return : le numero de sequence du paquet (8 bits, ou 32 bits avec
+* l'extension de sequence)
 */
-uint8_t  pkt_get_seqnum(const pkt_t * pkt)
+uint32_t pkt_get_seqnum(const pkt_t * pkt)
 {
   return pkt->seqnum;
 }
 
+/*
+* pkt_get_ext : Indique si le paquet utilise l'extension de sequence
+*
+* @pkt : pointeur vers un paquet
+* @return : 1 si le numero de sequence est encode sur 32 bits, 0 sinon
+*/
+uint8_t  pkt_get_ext(const pkt_t * pkt)
+{
+  return pkt->ext;
+}
+
+/*
+* pkt_get_csum : Indique le checksum des CRC du paquet
+*
+* @pkt : pointeur vers un paquet
+* @return : CSUM_CRC32 ou CSUM_CRC32C
+*/
+uint8_t pkt_get_csum(const pkt_t * pkt)
+{
+  return pkt->csum;
+}
+
+/*
+* pkt_get_capacite : Fonction qui va chercher la taille maximale du payload
+* du paquet place en argument
+*
+* @pkt : pointeur vers un paquet
+* @return : la taille maximale du payload, numero de sequence etendu compris
+*/
+uint16_t pkt_get_capacite(const pkt_t * pkt)
+{
+  return pkt->capacite;
+}
+
 /*
 * pkt_get_length: Fonction qui va chercher la longueur du payload
 * du paquet place en argument
@@ -213,6 +319,30 @@ const char* pkt_get_payload(const pkt_t * pkt)
   if ((pkt->length) <= 0){
     return NULL;
   }
+  return pkt->payload_ref != NULL ? pkt->payload_ref : pkt->payload;
+}
+
+/*
+* pkt_has_payload_ref : Indique si le payload d'un paquet est reference
+* hors du paquet (pkt_set_payload_ref)
+*
+* @pkt : pointeur vers un paquet
+* @return : 1 si le payload est hors du paquet, 0 sinon
+*/
+int pkt_has_payload_ref(const pkt_t* pkt)
+{
+  return pkt->payload_ref != NULL;
+}
+
+/*
+* pkt_payload_buffer : Donne la zone du payload d'un paquet, pour y lire
+* directement des donnees avant de fixer sa longueur
+*
+* @pkt : pointeur vers un paquet
+* @return : le debut du payload, de la capacite du paquet
+*/
+char* pkt_payload_buffer(pkt_t* pkt)
+{
   return pkt->payload;
 }
 
@@ -279,15 +409,48 @@ pkt_status_code pkt_set_window(pkt_t *pkt, const uint8_t window)
 * @return : Un code indiquant si l'operation a reussi ou representant
 * l'erreur rencontree
 */
-pkt_status_code pkt_set_seqnum(pkt_t *pkt, const uint8_t seqnum)
+pkt_status_code pkt_set_seqnum(pkt_t *pkt, const uint32_t seqnum)
 {
-  if(seqnum > 255 || seqnum < 0){
-    return E_SEQNUM;
-  }
+  // Sans l'extension, seuls les 8 bits de poids faible sont encodes
   pkt->seqnum = seqnum;
   return PKT_OK;
 }
 
+/*
+* pkt_set_ext : Active ou desactive l'extension de sequence d'un paquet de
+* donnees
+*
+* @ext : 1 pour encoder le numero de sequence sur 32 bits
+* @pkt : pointeur vers un paquet
+* @return : Un code indiquant si l'operation a reussi ou representant
+* l'erreur rencontree
+*/
+pkt_status_code pkt_set_ext(pkt_t *pkt, const uint8_t ext)
+{
+  if(ext != 0 && ext != 1){
+    return E_UNCONSISTENT;
+  }
+  pkt->ext = ext;
+  return PKT_OK;
+}
+
+/*
+* pkt_set_csum : Choisit le checksum des CRC du paquet, negocie par le HELLO
+*
+* @csum : CSUM_CRC32 ou CSUM_CRC32C
+* @pkt : pointeur vers un paquet
+* @return : Un code indiquant si l'operation a reussi ou representant
+* l'erreur rencontree
+*/
+pkt_status_code pkt_set_csum(pkt_t *pkt, const uint8_t csum)
+{
+  if(csum != CSUM_CRC32 && csum != CSUM_CRC32C){
+    return E_UNCONSISTENT;
+  }
+  pkt->csum = csum;
+  return PKT_OK;
+}
+
 /*
 * pkt_set_length : Fonction qui va initialiser la longueur du payload du
 * paquet en arguments a une certaine valeur
@@ -299,7 +462,7 @@ pkt_status_code pkt_set_seqnum(pkt_t *pkt, const uint8_t seqnum)
 */
 pkt_status_code pkt_set_length(pkt_t *pkt, const uint16_t length)
 {
-  if (length > MAX_PAYLOAD_SIZE){
+  if (length > pkt->capacite){
     return E_LENGTH;
   }
   pkt->length = length;
@@ -315,13 +478,9 @@ pkt_status_code pkt_set_length(pkt_t *pkt, const uint16_t length)
 * @return : Un code indiquant si l'operation a reussi ou representant
 * l'erreur rencontree
 */
-pkt_status_code pkt_set_timestamp(pkt_t *pkt)
+pkt_status_code pkt_set_timestamp(pkt_t *pkt, const uint32_t timestamp)
 {
-  struct timeval * tv = (struct timeval *)malloc(sizeof(struct timeval));
-  gettimeofday (tv, NULL);
-  int temps_actuel = tv->tv_sec * 1000 + tv->tv_usec;
-  pkt->timestamp = temps_actuel;
-  free(tv);
+  pkt->timestamp = timestamp;
   return PKT_OK;
 }
 
@@ -367,44 +526,433 @@ pkt_status_code pkt_set_crc2(pkt_t *pkt, const uint32_t crc2)
 */
 pkt_status_code pkt_set_payload(pkt_t *pkt, const char *data, const uint16_t length)
 {
-  if (length > MAX_PAYLOAD_SIZE){
+  if (length > pkt->capacite){
     return E_LENGTH;
   }
 
-  memcpy(pkt->payload, data, length+1);
+  memcpy(pkt->payload, data, length);
 
+  pkt->payload_ref = NULL;
   pkt->length = length;
   return PKT_OK;
 }
 
 
 /*
-* pkt_decode : Decode des donnees recues et cree une nouvelle structure pkt.
-* Le paquet recu est en network byte-order.
+* pkt_set_payload_ref : Fait du payload du paquet une reference vers des
+* donnees, sans les copier. Elles doivent rester en place tant que le paquet
+* peut etre encode.
+*
+* @pkt : pointeur vers un paquet
+* @data : les donnees du payload
+* @length : la longueur du payload
+* @return : Un code indiquant si l'operation a reussi ou representant
+* l'erreur rencontree
+*/
+pkt_status_code pkt_set_payload_ref(pkt_t *pkt, const char *data, const uint16_t length)
+{
+  if (length > pkt->capacite){
+    return E_LENGTH;
+  }
+
+  pkt->payload_ref = data;
+  pkt->length = length;
+  return PKT_OK;
+}
+
+
+/* Nombre de paquets dont les checksums sont calcules ensemble par les
+ * fonctions par lot, celui d'un lot d'envoi : les lots plus grands sont
+ * traites en plusieurs fois */
+#define PKT_LOT_MAX TX_BATCH_MAX
+
+static int crc_multi_entrelace(uint8_t csum);
+static pkt_status_code pkt_view_decoder(const uint8_t *data, const size_t len, uint16_t capacite, uint8_t csums, int copie, pkt_view_t *vue);
+static void crc_multi_copier(uint8_t csum, const uint8_t **bufs, uint8_t **dsts, const size_t *lens, uint32_t *crcs, int n);
+
+
+/*
+* crc_multi_csums : Calcule les checksums de plusieurs buffers, chacun avec
+* le sien : les buffers consecutifs d'un meme checksum sont passes ensemble a
+* crc32_multi. Un lot n'en a qu'un, sauf quand le checksum negocie arrive.
+*
+* @csums : le checksum de chaque buffer (CSUM_CRC32 ou CSUM_CRC32C)
+* @bufs : les buffers
+* @dsts : ou copier chaque buffer au passage, ou NULL
+* @lens : leurs tailles
+* @crcs : les CRC courants, remplaces par les resultats
+* @n : le nombre de buffers
+*
+* @return : /
+*/
+static void crc_multi_csums(const uint8_t *csums, const uint8_t **bufs, uint8_t **dsts, const size_t *lens, uint32_t *crcs, int n){
+  int debut = 0;
+  while(debut < n){
+    int fin = debut + 1;
+    while(fin < n && csums[fin] == csums[debut]){
+      fin++;
+    }
+    crc_multi_copier(csums[debut], bufs + debut, dsts != NULL ? dsts + debut : NULL, lens + debut, crcs + debut, fin - debut);
+    debut = fin;
+  }
+}
+
+
+/*
+* pkt_view_entete : Verifie la structure d'un paquet recu et decode son
+* header dans la vue, sans verifier les CRC
+*
+* @data: Le paquet recu
+* @len: Le nombre de bytes recus
+* @capacite: La taille maximale du payload accepte
+* @header: Rempli avec les 8 premiers octets, TR mis a 0 (ceux que couvre
+* le CRC1)
+* @vue: La vue a remplir, sans checksum ni payload
+* @return: Un code indiquant si le paquet est valide ou l'erreur rencontree
+*/
+static pkt_status_code pkt_view_entete(const uint8_t *data, const size_t len, uint16_t capacite, uint8_t *header, pkt_view_t *vue){
+
+  if(len < 12){ // Il n'y a pas de header car il est encode sur 12 bytes
+    return E_NOHEADER;
+  }
+  else if(len > (size_t) 12 + capacite + 4){ // Le paquet est trop long
+    return E_UNCONSISTENT;
+  }
+
+  // Premier byte : type, tr, window. Le CRC1 est calcule avec TR a 0, sur
+  // une copie du header : le buffer recu reste intact. La copie est ecrite
+  // d'un coup, pour etre relue de meme par le checksum.
+  uint64_t mot;
+  memcpy(&mot, data, 8);
+  mot &= htole64(~(uint64_t) 0b00100000);
+  memcpy(header, &mot, 8);
+  uint8_t tr = data[0] >> 5 & 0b00000001;
+
+  uint8_t ext = 0;
+  uint8_t type = header[0] >> 6;
+  // Paquet de donnees dont le numero de sequence est etendu a 32 bits
+  if(type == WIRE_TYPE_DATA_EXT){
+    type = PTYPE_DATA;
+    ext = 1;
+  }
+  if(type != PTYPE_DATA && type != PTYPE_ACK && type != PTYPE_NACK){
+    fprintf(stderr, "Erreur type\n");
+    return E_TYPE;
+  }
+
+  // 3e et 4e bytes : length, qui compte aussi le numero de sequence etendu
+  uint16_t length;
+  memcpy(&length, data+2, 2);
+  length = ntohs(length);
+  if(length > capacite || (ext && length < SEQ_EXT_SIZE)){
+    fprintf(stderr, "Erreur length\n");
+    return E_LENGTH;
+  }
+
+  // La taille du datagramme doit correspondre exactement au header : un paquet
+  // tronque ou vide n'a que ses 12 octets, les autres ont aussi le payload et
+  // son CRC2. Seuls les paquets de donnees peuvent etre tronques.
+  if(tr == 1 && type != PTYPE_DATA){
+    fprintf(stderr, "Erreur tr\n");
+    return E_TR;
+  }
+  if(len != (size_t) 12 + (tr == 0 && length > 0 ? length + 4 : 0)){
+    fprintf(stderr, "Erreur taille du paquet\n");
+    return E_UNCONSISTENT;
+  }
+
+  // 9e -> 12e bytes : CRC1
+  uint32_t crc1_recv;
+  memcpy(&crc1_recv, data+8, 4);
+  uint32_t timestamp;
+  memcpy(&timestamp, data+4, 4);
+
+  vue->type = (ptypes_t) type;
+  vue->tr = tr;
+  vue->window = header[0] & 0b00011111;
+  vue->ext = ext;
+  // Deuxième byte : seqnum (8 bits de poids faible avec l'extension)
+  vue->seqnum = data[1];
+  vue->length = length - (ext ? SEQ_EXT_SIZE : 0);
+  vue->timestamp = ntohl(timestamp);
+  vue->crc1 = ntohl(crc1_recv);
+  vue->csum = 0;
+  vue->crc2 = 0;
+  vue->a_verifier = 0;
+  vue->payload = NULL;
+
+  return PKT_OK;
+}
+
+
+/*
+* pkt_view_payload : Verifie le CRC2 d'un paquet dont le header est decode
+* dans la vue, puis y place son payload
+*
+* @data: Le paquet recu
+* @len: Le nombre de bytes recus
+* @vue: La vue du paquet, dont le header est decode
+* @crc2: Le CRC2 calcule sur le payload recu
+* @copie: 1 si le CRC2 n'a pas ete calcule : il sera verifie par
+* pkt_from_view pendant la copie du payload
+* @return: PKT_OK, ou E_CRC si le CRC2 recu est different
+*/
+static pkt_status_code pkt_view_payload(const uint8_t *data, const size_t len, pkt_view_t *vue, uint32_t crc2, int copie){
+  uint32_t crc2_recv;
+  memcpy(&crc2_recv, data+len-4, 4);
+  crc2_recv = ntohl(crc2_recv);
+  if(!copie && crc2_recv != crc2){
+    fprintf(stderr, "Erreur CRC2\n");
+    return E_CRC;
+  }
+  vue->crc2 = crc2_recv;
+  vue->a_verifier = (uint8_t) copie;
+
+  // Le numero de sequence etendu precede les donnees
+  vue->payload = data+12;
+  if(vue->ext){
+    uint32_t seq32;
+    memcpy(&seq32, vue->payload, SEQ_EXT_SIZE);
+    vue->seqnum = ntohl(seq32);
+    vue->payload += SEQ_EXT_SIZE;
+  }
+  return PKT_OK;
+}
+
+
+/*
+* pkt_view_decode_batch : Decode sur place un lot de paquets recus, comme
+* pkt_view_decode pour chacun, mais en calculant leurs CRC1 puis leurs CRC2
+* ensemble avec crc32_multi
+*
+* @datas: Les paquets recus
+* @lens: Le nombre de bytes recus pour chacun
+* @n: Le nombre de paquets
+* @capacite: La taille maximale du payload accepte
+* @csums: Les checksums acceptes (masque de CSUM_*)
+* @copie: 1 si les payloads seront tous copies par pkt_from_view : leur
+* CRC2 est alors verifie pendant la copie (a_verifier), pas ici
+* @vues: Les vues a remplir, une par paquet
+* @codes: Rempli avec le code de pkt_view_decode de chaque paquet
+* @return: /
+*/
+void pkt_view_decode_batch(const uint8_t **datas, const size_t *lens, int n, uint16_t capacite, uint8_t csums, int copie, pkt_view_t *vues, pkt_status_code *codes){
+  // Le checksum negocie d'abord : les paquets envoyes avant que le sender
+  // ne l'apprenne sont encore en CRC32
+  uint8_t prefere = (csums & CSUM_CRC32C) ? CSUM_CRC32C : CSUM_CRC32;
+  int debut;
+  // Sans noyau qui entrelace les buffers, le CRC de chaque paquet se
+  // superpose mieux au decodage du suivant
+  if(n == 1 || !crc_multi_entrelace(prefere)){
+    for(debut = 0; debut < n; debut++){
+      codes[debut] = pkt_view_decoder(datas[debut], lens[debut], capacite, csums, copie, &vues[debut]);
+    }
+    return;
+  }
+  for(debut = 0; debut < n; debut += PKT_LOT_MAX){
+    int fin = debut + PKT_LOT_MAX < n ? debut + PKT_LOT_MAX : n;
+    uint8_t headers[PKT_LOT_MAX][8];
+    const uint8_t *zones[PKT_LOT_MAX];
+    size_t tailles[PKT_LOT_MAX];
+    uint32_t crcs[PKT_LOT_MAX];
+    uint8_t choix[PKT_LOT_MAX];
+    int indices[PKT_LOT_MAX];
+    int i, j, k = 0;
+
+    for(i = debut; i < fin; i++){
+      codes[i] = pkt_view_entete(datas[i], lens[i], capacite, headers[i - debut], &vues[i]);
+      if(codes[i] == PKT_OK){
+        zones[k] = headers[i - debut];
+        tailles[k] = 8;
+        crcs[k] = 0;
+        indices[k] = i;
+        k++;
+      }
+    }
+
+    // CRC1 de tous les paquets, puis CRC2 de ceux qui ont un payload
+    crc32_multi(prefere, zones, tailles, crcs, k);
+    int m = 0;
+    for(j = 0; j < k; j++){
+      i = indices[j];
+      pkt_view_t *vue = &vues[i];
+      if((csums & prefere) && crcs[j] == vue->crc1){
+        vue->csum = prefere;
+      }
+      else if(prefere == CSUM_CRC32C && (csums & CSUM_CRC32) && crc32_ieee(0, headers[i - debut], 8) == vue->crc1){
+        vue->csum = CSUM_CRC32;
+      }
+      else{
+        fprintf(stderr, "Erreur CRC1\n");
+        codes[i] = E_CRC;
+        continue;
+      }
+      // Seul un paquet de donnees complet a plus que son header
+      if(vue->type == PTYPE_DATA && lens[i] > 12){
+        if(copie){
+          codes[i] = pkt_view_payload(datas[i], lens[i], vue, 0, 1);
+          continue;
+        }
+        zones[m] = datas[i]+12;
+        tailles[m] = lens[i] - 16;
+        crcs[m] = 0;
+        choix[m] = vue->csum;
+        indices[m] = i;
+        m++;
+      }
+    }
+    crc_multi_csums(choix, zones, NULL, tailles, crcs, m);
+
+    for(j = 0; j < m; j++){
+      i = indices[j];
+      codes[i] = pkt_view_payload(datas[i], lens[i], &vues[i], crcs[j], 0);
+    }
+  }
+}
+
+
+/*
+* pkt_view_decode : Decode un paquet de donnees sur place, sans rien copier :
+* la vue pointe dans le buffer recu, qui n'est pas modifie. Le paquet recu
+* est en network byte-order.
 * La fonction verifie que:
 * - Le CRC32 du header recu est le même que celui decode a la fin
 *   du header (en considerant le champ TR a 0)
 * - S'il est present, le CRC32 du payload recu est le meme que celui
 *   decode a la fin du payload
-* - Le type du paquet est valide
+* - Le type du paquet est valide (un paquet de type WIRE_TYPE_DATA_EXT
+*   est un paquet de donnees avec un numero de sequence sur 32 bits)
 * - La longueur du paquet et le champ TR sont valides et coherents
-*   avec le nombre d'octets recus.
+*   avec le nombre d'octets recus, et le payload tient dans capacite.
+* Le checksum est celui, parmi csums, avec lequel le CRC1 concorde.
+*
+* @data: L'ensemble d'octets constituant le paquet recu
+* @len: Le nombre de bytes recus
+* @capacite: La taille maximale du payload accepte
+* @csums: Les checksums acceptes (masque de CSUM_*)
+* @vue: La vue a remplir
+* @post: vue represente le paquet recu, son payload pointe dans data
+* @return: Un code indiquant si l'operation a reussi ou representant
+* l'erreur rencontree
+*/
+pkt_status_code pkt_view_decode(const uint8_t *data, const size_t len, uint16_t capacite, uint8_t csums, pkt_view_t *vue){
+  return pkt_view_decoder(data, len, capacite, csums, 0, vue);
+}
+
+
+/*
+* pkt_view_decoder : pkt_view_decode, dont le CRC2 peut etre laisse a
+* pkt_from_view
+*
+* @copie: 1 pour ne pas calculer le CRC2 : la vue est marquee a_verifier
+* et pkt_from_view le verifie en copiant le payload
+*/
+static pkt_status_code pkt_view_decoder(const uint8_t *data, const size_t len, uint16_t capacite, uint8_t csums, int copie, pkt_view_t *vue){
+  uint8_t header[8];
+  pkt_status_code err_code = pkt_view_entete(data, len, capacite, header, vue);
+  if(err_code != PKT_OK){
+    return err_code;
+  }
+
+  // Le checksum negocie d'abord : les paquets envoyes avant que le sender
+  // ne l'apprenne sont encore en CRC32
+  if((csums & CSUM_CRC32C) && vue->crc1 == crc32c(0, header, 8)){
+    vue->csum = CSUM_CRC32C;
+  }
+  else if((csums & CSUM_CRC32) && vue->crc1 == crc32_ieee(0, header, 8)){
+    vue->csum = CSUM_CRC32;
+  }
+  else{
+    fprintf(stderr, "Erreur CRC1\n");
+    return E_CRC;
+  }
+
+  // Seul un paquet de donnees complet a plus que son header
+  if(vue->type == PTYPE_DATA && len > 12){
+    if(copie){
+      return pkt_view_payload(data, len, vue, 0, 1);
+    }
+    return pkt_view_payload(data, len, vue, crc_pour(vue->csum)(0, data+12, len-16), 0);
+  }
+  return PKT_OK;
+}
+
+
+/*
+* pkt_from_view : Copie un paquet decode sur place dans une struct pkt, qui
+* ne depend plus du buffer recu. C'est la seule copie du payload. Si le CRC2
+* de la vue reste a verifier, il est calcule pendant la copie.
+*
+* @pkt: Une struct pkt valide, assez grande pour le payload
+* @vue: Le paquet decode par pkt_view_decode
+* @post: pkt est la representation du paquet recu
+* @return: Un code indiquant si l'operation a reussi ou representant
+* l'erreur rencontree (E_CRC si le CRC2 verifie ici est faux)
+*/
+pkt_status_code pkt_from_view(pkt_t *pkt, const pkt_view_t *vue){
+  pkt_reset(pkt);
+  pkt->type = vue->type;
+  pkt->tr = vue->tr;
+  pkt->window = vue->window;
+  pkt->ext = vue->ext;
+  pkt->csum = vue->csum;
+  pkt->seqnum = vue->seqnum;
+  pkt->timestamp = vue->timestamp;
+  pkt->crc1 = vue->crc1;
+  pkt->crc2 = vue->crc2;
+  // Payload (peut contenir des octets nuls : on copie exactement length
+  // octets), directement depuis le datagramme recu
+  if(vue->a_verifier){
+    pkt_status_code err = pkt_set_length(pkt, vue->length);
+    if(err != PKT_OK){
+      return err;
+    }
+    // Le CRC2 couvre le numero de sequence etendu, qui precede le payload
+    const uint8_t *zone = vue->payload - (vue->ext ? SEQ_EXT_SIZE : 0);
+    uint32_t crc = crc_pour(vue->csum)(0, zone, vue->payload - zone);
+    crc = crc_copier(vue->csum, crc, pkt->payload, vue->payload, vue->length);
+    if(crc != vue->crc2){
+      fprintf(stderr, "Erreur CRC2\n");
+      return E_CRC;
+    }
+    return PKT_OK;
+  }
+  if(vue->payload != NULL){
+    return pkt_set_payload(pkt, (const char *) vue->payload, vue->length);
+  }
+  return pkt_set_length(pkt, vue->length);
+}
+
+
+/*
+* pkt_decode : Decode des donnees recues et cree une nouvelle structure pkt.
+* Le paquet recu est en network byte-order. Les verifications sont celles de
+* pkt_view_decode, le payload est copie dans pkt.
 *
 * @data: L'ensemble d'octets constituant le paquet recu
 * @len: Le nombre de bytes recus
-* @pkt: Une struct pkt valide
+* @pkt: Une struct pkt valide, dont la capacite borne le payload accepte
 * @post: pkt est la representation du paquet recu
 * @return: Un code indiquant si l'operation a reussi ou representant
 * l'erreur rencontree
 */
 pkt_status_code pkt_decode(uint8_t *data, const size_t len, pkt_t *pkt){
+  pkt_view_t vue;
+  // Le CRC2 est verifie pendant la copie du payload dans pkt
+  pkt_status_code err_code = pkt_view_decoder(data, len, pkt_get_capacite(pkt), CSUM_CRC32 | CSUM_CRC32C, 1, &vue);
+  if(err_code != PKT_OK){
+    return err_code;
+  }
+  return pkt_from_view(pkt, &vue);
+}
 
-  pkt_status_code err_code;
+
+pkt_status_code ack_decode(uint8_t *data, const size_t len, ack_t *ack){
 
   if (len < 12){ // Il n'y a pas de header car il est encode sur 12 bytes
   return E_NOHEADER;
 }
-else if(len > 528){ // Le paquet est trop long
+else if(len > 12 + MAX_ACK_PAYLOAD_SIZE + 4){ // Le paquet est trop long
   return E_UNCONSISTENT;
 }
 
@@ -421,216 +969,176 @@ uint32_t crc1_recv;
 uint8_t first_byte;
 memcpy(&first_byte, data, 1);
 
-tr = first_byte>>5 & 0b00000001;
-if(tr != 1 && tr != 0){
-  fprintf(stderr, "Erreur tr\n");
-  return E_TR;
-}
-
-if(tr == 1){
-  first_byte = first_byte & 0b11011111;
-  memcpy(data, &first_byte, 1);
-}
-
 type = first_byte>>6;
 if(type != PTYPE_DATA && type != PTYPE_ACK && type != PTYPE_NACK){
   fprintf(stderr, "Erreur type\n");
   return E_TYPE;
 }
-
+tr = first_byte>>5 & 0b00000001;
+if(tr != 1 && tr != 0){
+  fprintf(stderr, "Erreur tr\n");
+  return E_TR;
+}
 window = first_byte & 0b00011111;
-if(window > 31 || window < 0){
+if(window > 31){
   fprintf(stderr, "Erreur window\n");
   return E_WINDOW;
 }
 
 // Deuxième byte : seqnum
 memcpy(&seqnum, data+1, 1);
-if(seqnum < 0 || seqnum > 255){
-  fprintf(stderr, "Erreur seqnum\n");
-  return E_SEQNUM;
-}
 
 // 3e et 4e bytes : length
 memcpy(&length, data+2, 2);
 length = ntohs(length);
-if(length < 0 || length > 512){
+if(length > MAX_ACK_PAYLOAD_SIZE){
   fprintf(stderr, "Erreur length\n");
   return E_LENGTH;
 }
-
-// 5e -> 8e bytes : timestamp
-memcpy(&timestamp, data+4, 4);
-timestamp = ntohl(timestamp);
-
-
+// Un ACK tronque par le reseau n'a plus que son header : il reste valable,
+// sans ses options. Le CRC1 est calcule avec le champ TR a 0.
+if(tr == 1){
+  if(len != 12){
+    fprintf(stderr, "Erreur length\n");
+    return E_UNCONSISTENT;
+  }
+  length = 0;
+  data[0] &= 0b11011111;
+}
+// Les options sont suivies de leur CRC2
+else if(len != (size_t) 12 + (length > 0 ? length + 4 : 0)){
+  fprintf(stderr, "Erreur length\n");
+  return E_UNCONSISTENT;
+}
+
+// 5e -> 8e bytes : timestamp
+memcpy(&timestamp, data+4, 4);
+timestamp = ntohl(timestamp);
+
 // 9e -> 12e bytes : CRC1
 memcpy(&crc1_recv, data+8, 4);
 crc1_recv = ntohl(crc1_recv);
 // On vérifie si les deux CRC sont les mêmes
-uint32_t crc1_check = crc32(0, (const Bytef *) data, 8);
+uint32_t crc1_check = crc32_ieee(0, data, 8);
 if(crc1_recv != crc1_check){
   fprintf(stderr, "Erreur CRC1\n");
   return E_CRC;
 }
-err_code = pkt_set_crc1(pkt, crc1_recv);
-if(err_code != PKT_OK){
-  return E_CRC;
-}
-
-// Encodage des valeurs dans la structure pkt
-
-err_code = pkt_set_type(pkt, type);
-if(err_code != PKT_OK){
-  return E_TYPE;
-}
-
-err_code = pkt_set_tr(pkt, tr);
-if(err_code != PKT_OK){
-  return E_TR;
-}
-
-err_code = pkt_set_window(pkt, window);
-if(err_code != PKT_OK){
-  return E_WINDOW;
-}
-
-err_code = pkt_set_seqnum(pkt, seqnum);
-if(err_code != PKT_OK){
-  return E_SEQNUM;
-}
-
-err_code = pkt_set_length(pkt, length);
-if(err_code != PKT_OK){
-  return E_LENGTH;
-}
-err_code = pkt_set_timestamp(pkt);
-
-if(type == PTYPE_DATA && tr == 0){
 
+// Options : suite de TLV, protegee par le CRC2. Les options inconnues sont
+// ignorees pour rester compatible avec de futures extensions.
+uint8_t has_sack = 0;
+uint8_t nb_sack = 0;
+sack_bloc_t sack[ACK_SACK_MAX_BLOCS];
+uint8_t has_wscale = 0;
+uint8_t wscale = 0;
+uint8_t has_seq32 = 0;
+uint32_t seq32 = 0;
+uint8_t has_mss = 0;
+uint16_t mss = 0;
+uint16_t mss_recu = 0;
+uint8_t sack_ok = 0;
+uint32_t ack_delay = 0;
+uint8_t csum = 0;
+if(length > 0){
   uint32_t crc2_recv;
-  char * payload = (char *) malloc(512*sizeof(char));
-  if(payload == NULL){
-    fprintf(stderr, "Erreur payload\n");
-    return E_NOMEM;
-  }
-
-
-  // Payload
-  strcpy(payload, (const char*) data+12);
-  *(payload+length) = '\0';
-
-  // CRC2
   memcpy(&crc2_recv, data+12+length, 4);
   crc2_recv = ntohl(crc2_recv);
-
-  // On vérifie si les deux CRC sont les mêmes
-  uint32_t crc2_check = crc32(0, (const Bytef *) data+12, length);
-  if(crc2_recv != crc2_check){
+  if(crc2_recv != crc32_ieee(0, data+12, length)){
     fprintf(stderr, "Erreur CRC2\n");
-    free(payload);
     return E_CRC;
   }
 
-  err_code = pkt_set_payload(pkt, payload, length);
-  if(err_code != PKT_OK){
-    free(payload);
-    return E_LENGTH;
+  const uint8_t *opt = data+12;
+  uint16_t off = 0;
+  while(off + 2 <= length){
+    uint8_t opt_type = opt[off];
+    uint8_t opt_len = opt[off+1];
+    if(off + 2 + opt_len > length){
+      fprintf(stderr, "Erreur option\n");
+      return E_UNCONSISTENT;
+    }
+    if(opt_type == ACK_OPT_SACK && opt_len % ACK_OPT_SACK_BLOC_LEN == 0 &&
+       opt_len / ACK_OPT_SACK_BLOC_LEN <= ACK_SACK_MAX_BLOCS){
+      for(nb_sack = 0; nb_sack < opt_len / ACK_OPT_SACK_BLOC_LEN; nb_sack++){
+        memcpy(&sack[nb_sack].debut, opt+off+2+nb_sack*ACK_OPT_SACK_BLOC_LEN, 2);
+        memcpy(&sack[nb_sack].nb, opt+off+4+nb_sack*ACK_OPT_SACK_BLOC_LEN, 2);
+        sack[nb_sack].debut = ntohs(sack[nb_sack].debut);
+        sack[nb_sack].nb = ntohs(sack[nb_sack].nb);
+      }
+      has_sack = 1;
+    }
+    else if(opt_type == ACK_OPT_WSCALE && opt_len == ACK_OPT_WSCALE_LEN && opt[off+2] <= WSCALE_MAX){
+      wscale = opt[off+2];
+      has_wscale = 1;
+    }
+    else if(opt_type == ACK_OPT_SEQ32 && opt_len == ACK_OPT_SEQ32_LEN){
+      memcpy(&seq32, opt+off+2, 4);
+      seq32 = ntohl(seq32);
+      has_seq32 = 1;
+    }
+    else if(opt_type == ACK_OPT_MSS && opt_len == ACK_OPT_MSS_LEN){
+      memcpy(&mss, opt+off+2, 2);
+      memcpy(&mss_recu, opt+off+4, 2);
+      mss = ntohs(mss);
+      mss_recu = ntohs(mss_recu);
+      has_mss = 1;
+    }
+    else if(opt_type == ACK_OPT_SACK_OK && opt_len == ACK_OPT_SACK_OK_LEN){
+      sack_ok = 1;
+    }
+    else if(opt_type == ACK_OPT_ACK_DELAY && opt_len == ACK_OPT_ACK_DELAY_LEN){
+      memcpy(&ack_delay, opt+off+2, 4);
+      ack_delay = ntohl(ack_delay);
+    }
+    else if(opt_type == ACK_OPT_CSUM && opt_len == ACK_OPT_CSUM_LEN){
+      csum = opt[off+2];
+    }
+    off += 2 + opt_len;
   }
-
-  err_code = pkt_set_crc2(pkt, crc2_recv);
-  free(payload);
-
 }
 
+// Encodage des valeurs dans la structure pkt
 
-return PKT_OK;
+ack->type = type;
 
-}
+ack->tr = tr;
 
+ack->window = window;
 
-pkt_status_code ack_decode(uint8_t *data, const size_t len, ack_t *ack){
+ack->seqnum = has_seq32 ? seq32 : seqnum;
 
-  if (len < 12){ // Il n'y a pas de header car il est encode sur 12 bytes
-  return E_NOHEADER;
-}
-else if(len > 528){ // Le paquet est trop long
-  return E_UNCONSISTENT;
-}
+ack->length = length;
 
-// Initialisation des variables
-ptypes_t type;
-uint8_t tr;
-uint8_t window;
-uint8_t seqnum;
-uint16_t length;
-uint32_t timestamp;
-uint32_t crc1_recv;
+ack->timestamp = timestamp;
 
-// Premier byte : type, tr, window
-uint8_t first_byte;
-memcpy(&first_byte, data, 1);
+ack->crc1 = crc1_recv;
 
-type = first_byte>>6;
-if(type != PTYPE_DATA && type != PTYPE_ACK && type != PTYPE_NACK){
-  fprintf(stderr, "Erreur type\n");
-  return E_TYPE;
-}
-tr = first_byte>>5 & 0b00000001;
-if(tr != 1 && tr != 0){
-  fprintf(stderr, "Erreur tr\n");
-  return E_TR;
-}
-window = first_byte & 0b00011111;
-if(window > 31 || window < 0){
-  fprintf(stderr, "Erreur window\n");
-  return E_WINDOW;
-}
+ack->has_sack = has_sack;
 
-// Deuxième byte : seqnum
-memcpy(&seqnum, data+1, 1);
-if(seqnum < 0 || seqnum > 255){
-  fprintf(stderr, "Erreur seqnum\n");
-  return E_SEQNUM;
-}
+ack->nb_sack = nb_sack;
 
-// 3e et 4e bytes : length
-memcpy(&length, data+2, 2);
-length = ntohs(length);
-if(length < 0 || length > 512){
-  fprintf(stderr, "Erreur length\n");
-  return E_LENGTH;
+if(nb_sack > 0){
+  memcpy(ack->sack, sack, nb_sack * sizeof(sack_bloc_t));
 }
 
-// 5e -> 8e bytes : timestamp
-memcpy(&timestamp, data+4, 4);
-timestamp = ntohl(timestamp);
-
-// 9e -> 12e bytes : CRC1
-memcpy(&crc1_recv, data+8, 4);
-crc1_recv = ntohl(crc1_recv);
-// On vérifie si les deux CRC sont les mêmes
-uint32_t crc1_check = crc32(0, (const Bytef *) data, 8);
-if(crc1_recv != crc1_check){
-  fprintf(stderr, "Erreur CRC1\n");
-  return E_CRC;
-}
+ack->has_wscale = has_wscale;
 
-// Encodage des valeurs dans la structure pkt
+ack->wscale = wscale;
 
-ack->type = type;
+ack->has_seq32 = has_seq32;
 
-ack->tr = tr;
+ack->has_mss = has_mss;
 
-ack->window = window;
+ack->mss = mss;
 
-ack->seqnum = seqnum;
+ack->mss_recu = mss_recu;
 
-ack->length = length;
+ack->sack_ok = sack_ok;
 
-ack->timestamp = timestamp;
+ack->ack_delay = ack_delay;
 
-ack->crc1 = crc1_recv;
+ack->csum = csum;
 
 return PKT_OK;
 
@@ -638,23 +1146,25 @@ return PKT_OK;
 
 
 /*
-* pkt_encode : Encode une struct pkt dans un buffer, pret a etre envoye sur le reseau
-* (c-a-d en network byte-order), incluant le CRC32 du header et
-* eventuellement le CRC32 du payload si celui-ci est non nul.
+* pkt_encode_header : Verifie un paquet et encode son header de 12 octets,
+* sans le CRC1, suivi du numero de sequence etendu si le payload est present
 *
 * @pkt: La structure a encoder
-* @buf: Le buffer dans lequel la structure sera encodee
-* @len: La taille disponible dans le buffer
-* @len-POST: Le nombre de d'octets ecrit dans le buffer
+* @buf: Le buffer dans lequel le header sera encode
+* @len: La taille disponible dans le buffer, qui doit contenir le header, le
+* payload si copie vaut 1, et le CRC2
+* @copie: 1 si le payload sera copie a la suite du header
+* @len-POST: La taille du header, numero de sequence etendu compris
+* @donnees: Mis au nombre d'octets de donnees du payload, s'il est present
 * @return: Un code indiquant si l'operation a reussi ou E_NOMEM si
 * le buffer est trop petit.
 */
-pkt_status_code pkt_encode(const pkt_t* pkt, uint8_t *buf, size_t len)
+static pkt_status_code pkt_encode_header(const pkt_t* pkt, uint8_t *buf, size_t *len, int copie, uint16_t *donnees)
 {
 
   // Gerer le header
   uint8_t window = pkt_get_window(pkt);
-  if(window > 31 || window < 0){
+  if(window > 31){
     fprintf(stderr, "Erreur window\n");
     return E_WINDOW;
   }
@@ -668,29 +1178,36 @@ pkt_status_code pkt_encode(const pkt_t* pkt, uint8_t *buf, size_t len)
     fprintf(stderr, "Erreur tr\n");
     return E_TR;
   }
-  uint8_t seqnum = pkt_get_seqnum(pkt);
-  if(seqnum < 0 || seqnum > 255){
-    fprintf(stderr, "Erreur seqnum\n");
-    return E_SEQNUM;
-  }
+  uint8_t seqnum = (uint8_t) pkt_get_seqnum(pkt); // 8 bits de poids faible
   uint16_t length = pkt_get_length(pkt); // 2 bytes
-  if(length < 0 || length > 512){
+
+  // Avec l'extension, le numero de sequence sur 32 bits precede les donnees
+  // et fait partie du payload annonce
+  int ext = type == PTYPE_DATA && pkt_get_ext(pkt);
+  uint16_t ext_size = ext ? SEQ_EXT_SIZE : 0;
+  if(length + ext_size > pkt_get_capacite(pkt)){
     fprintf(stderr, "Erreur length\n");
     return E_LENGTH;
   }
   uint32_t timestamp = htonl(pkt_get_timestamp(pkt)); // 4 bytes
 
+  // Le payload et son CRC2 ne sont presents que pour un paquet de donnees
+  // non tronque et non vide
+  int avec_payload = tr == 0 && type == PTYPE_DATA && length + ext_size > 0;
+  size_t taille = 12 + (avec_payload ? (copie ? length : 0) + ext_size + 4 : 0);
 
   // Teste si le buffer est trop petit
-  if(len < 528){
+  if(*len < taille){
     fprintf(stderr, "Erreur nomem\n");
     return E_NOMEM;
   }
+  *len = 12 + (avec_payload ? ext_size : 0);
+  *donnees = avec_payload ? length : 0;
 
-  length = htons(length);
+  length = htons(length + ext_size);
 
   // Premier byte
-  uint8_t type_format = type<<6 & 0b00000011000000;
+  uint8_t type_format = (ext ? WIRE_TYPE_DATA_EXT : type)<<6 & 0b00000011000000;
   uint8_t tr_format = tr<<5 & 0b00000100000;
   uint8_t window_format = window & 0b00011111;
   uint8_t first_byte = type_format | tr_format | window_format;
@@ -705,34 +1222,255 @@ pkt_status_code pkt_encode(const pkt_t* pkt, uint8_t *buf, size_t len)
   // Quatrième au huitième byte
   memcpy(buf+4, &timestamp, 4); // timestamp
 
-  // Gerer les CRC
-  uint32_t crc1 = htonl(crc32(0, (const Bytef *) buf, 8));
-  // Huitième au douzième byte : crc1
-  memcpy(buf+8, &crc1, 4);
+  // Huitième au douzième byte : crc1, calcule par l'appelant
 
+  if(avec_payload && ext){
+    uint32_t seq32 = htonl(pkt_get_seqnum(pkt));
+    memcpy(buf+12, &seq32, SEQ_EXT_SIZE);
+  }
 
-  // Si le paquet n'est pas tronqué
-  if(tr == 0 && type == PTYPE_DATA){
+  return PKT_OK;
+}
+
+
+/*
+* pkt_encode_lot : Encode un lot de paquets, en calculant leurs CRC1 puis
+* leurs CRC2 ensemble avec crc32_multi. Les payloads copies le sont par le
+* calcul du CRC2, en une seule lecture.
+*
+* @pkts: Les structures a encoder
+* @n: Le nombre de paquets
+* @bufs: Les buffers dans lesquels les paquets seront encodes
+* @lens: La taille disponible dans chaque buffer
+* @len-POST: Le nombre de d'octets ecrit dans chaque buffer
+* @headers: Mis a la taille de chaque header si copie vaut 0, NULL sinon
+* @copie: 1 pour copier le payload a la suite du header, 0 pour qu'il soit
+* envoye depuis sa place (pkt_encode_sg)
+* @return: PKT_OK, ou le code du premier paquet qui n'a pu etre encode :
+* aucun buffer n'est alors utilisable
+*/
+static pkt_status_code pkt_encode_lot(const pkt_t **pkts, int n, uint8_t **bufs, size_t *lens, size_t *headers, int copie){
+  int debut;
+  // Sans noyau qui entrelace les buffers, le CRC de chaque paquet se
+  // superpose mieux a l'encodage du suivant
+  if(n == 1 || (n > 0 && !crc_multi_entrelace(pkts[0]->csum))){
+    for(debut = 0; debut < n; debut++){
+      pkt_status_code err = copie ? pkt_encode(pkts[debut], bufs[debut], &lens[debut]) :
+        pkt_encode_sg(pkts[debut], bufs[debut], &lens[debut], &headers[debut]);
+      if(err != PKT_OK){
+        return err;
+      }
+    }
+    return PKT_OK;
+  }
+  for(debut = 0; debut < n; debut += PKT_LOT_MAX){
+    int fin = debut + PKT_LOT_MAX < n ? debut + PKT_LOT_MAX : n;
+    const uint8_t *zones[PKT_LOT_MAX];
+    uint8_t *copies[PKT_LOT_MAX];
+    size_t tailles[PKT_LOT_MAX];
+    uint32_t crcs[PKT_LOT_MAX];
+    uint8_t choix[PKT_LOT_MAX];
+    size_t tete[PKT_LOT_MAX];
+    uint16_t donnees[PKT_LOT_MAX];
+    int indices[PKT_LOT_MAX];
+    int i, j, k = 0;
+
+    for(i = debut; i < fin; i++){
+      j = i - debut;
+      tete[j] = lens[i];
+      pkt_status_code err = pkt_encode_header(pkts[i], bufs[i], &tete[j], copie, &donnees[j]);
+      if(err != PKT_OK){
+        return err;
+      }
+      zones[j] = bufs[i];
+      tailles[j] = 8;
+      crcs[j] = 0;
+      choix[j] = pkts[i]->csum;
+    }
+    crc_multi_csums(choix, zones, NULL, tailles, crcs, fin - debut);
+
+    for(i = debut; i < fin; i++){
+      j = i - debut;
+      uint32_t crc1 = htonl(crcs[j]);
+      memcpy(bufs[i]+8, &crc1, 4);
+      if(headers != NULL){
+        headers[i] = tete[j];
+      }
 
-    const char* payload = pkt_get_payload(pkt); // up to 512 bytes
+      // Si le paquet est tronque, ou vide sans extension, il n'a pas de CRC2
+      if(tete[j] == 12 && donnees[j] == 0){
+        lens[i] = 12;
+        continue;
+      }
+      // Le CRC2 couvre le numero de sequence etendu puis les donnees. Le
+      // paquet de fin etendu n'a que son numero de sequence. Les donnees
+      // copiees le sont pendant le calcul de leur CRC2.
+      const char *payload = pkt_get_payload(pkts[i]);
+      crcs[k] = crc_pour(pkts[i]->csum)(0, bufs[i]+12, tete[j] - 12);
+      zones[k] = donnees[j] > 0 ? (const uint8_t *) payload : bufs[i]+12;
+      copies[k] = bufs[i]+tete[j];
+      tailles[k] = donnees[j];
+      choix[k] = pkts[i]->csum;
+      indices[k] = i;
+      k++;
+    }
+    crc_multi_csums(choix, zones, copie ? copies : NULL, tailles, crcs, k);
+
+    for(j = 0; j < k; j++){
+      i = indices[j];
+      size_t fin_donnees = tete[i - debut] + (copie ? donnees[i - debut] : 0);
+      uint32_t crc2 = htonl(crcs[j]);
+      memcpy(bufs[i]+fin_donnees, &crc2, 4);
+      lens[i] = fin_donnees + 4;
+    }
+  }
+  return PKT_OK;
+}
 
-    memcpy(buf+12, payload, ntohs(length)); // 12e -> 524e byte : payload
 
+/*
+* pkt_encode : Encode une struct pkt dans un buffer, pret a etre envoye sur le reseau
+* (c-a-d en network byte-order), incluant le CRC32 du header et
+* eventuellement le CRC32 du payload si celui-ci est non nul.
+*
+* @pkt: La structure a encoder
+* @buf: Le buffer dans lequel la structure sera encodee
+* @len: La taille disponible dans le buffer
+* @len-POST: Le nombre de d'octets ecrit dans le buffer (12, plus le payload
+* et son CRC32 s'il y en a un)
+* @return: Un code indiquant si l'operation a reussi ou E_NOMEM si
+* le buffer est trop petit.
+*/
+pkt_status_code pkt_encode(const pkt_t* pkt, uint8_t *buf, size_t *len)
+{
+  size_t header = *len;
+  uint16_t data_len;
+  pkt_status_code err = pkt_encode_header(pkt, buf, &header, 1, &data_len);
+  if(err != PKT_OK){
+    return err;
+  }
+  crc_fn_t crc_fn = crc_pour(pkt->csum);
+  uint32_t crc1 = htonl(crc_fn(0, buf, 8));
+  memcpy(buf+8, &crc1, 4);
 
-    uint32_t crc2 = htonl(crc32(0, (const Bytef *) buf+12, ntohs(length))); // Calcul du crc2
-    memcpy(buf+12+ntohs(length), &crc2, 4);
+  // Si le paquet n'est pas tronqué
+  if(header > 12 || data_len > 0){
+
+    // Le CRC2 couvre le numero de sequence etendu, deja en place, puis le
+    // payload, copie pendant son calcul. Le paquet de fin etendu n'a que
+    // son numero de sequence.
+    uint32_t crc = crc_fn(0, buf+12, header - 12);
+    if(data_len > 0){
+      const char* payload = pkt_get_payload(pkt); // jusqu'a la capacite du paquet
+      crc = crc_copier(pkt->csum, crc, buf+header, payload, data_len);
+    }
+    uint32_t crc2 = htonl(crc);
+    memcpy(buf+header+data_len, &crc2, 4);
+    *len = header + data_len + 4;
   }
+  else{
+    *len = 12;
+  }
+
+  return PKT_OK;
+}
+
+
+/*
+* pkt_encode_batch : Encode un lot de paquets comme pkt_encode, leurs
+* checksums etant calcules ensemble
+*
+* @pkts: Les structures a encoder
+* @n: Le nombre de paquets
+* @bufs: Les buffers dans lesquels les paquets seront encodes
+* @lens: La taille disponible dans chaque buffer
+* @len-POST: Le nombre de d'octets ecrit dans chaque buffer
+* @return: PKT_OK, ou le code du premier paquet qui n'a pu etre encode :
+* aucun buffer n'est alors utilisable
+*/
+pkt_status_code pkt_encode_batch(const pkt_t **pkts, int n, uint8_t **bufs, size_t *lens)
+{
+  return pkt_encode_lot(pkts, n, bufs, lens, NULL, 1);
+}
 
+
+/*
+* pkt_encode_sg : Encode un paquet sans copier son payload. Le header (avec
+* le numero de sequence etendu) est encode dans buf, suivi directement du
+* CRC2 : le datagramme est header, payload (pkt_get_payload) puis CRC2.
+*
+* @pkt: La structure a encoder
+* @buf: Le buffer dans lequel le header et le CRC2 seront encodes
+* @len: La taille disponible dans le buffer
+* @len-POST: Le nombre de d'octets ecrit dans le buffer
+* @header: Mis a la taille du header, avant laquelle s'insere le payload
+* @return: Un code indiquant si l'operation a reussi ou E_NOMEM si
+* le buffer est trop petit.
+*/
+pkt_status_code pkt_encode_sg(const pkt_t* pkt, uint8_t *buf, size_t *len, size_t *header)
+{
+  *header = *len;
+  uint16_t data_len;
+  pkt_status_code err = pkt_encode_header(pkt, buf, header, 0, &data_len);
+  if(err != PKT_OK){
+    return err;
+  }
+  crc_fn_t crc_fn = crc_pour(pkt->csum);
+  uint32_t crc1 = htonl(crc_fn(0, buf, 8));
+  memcpy(buf+8, &crc1, 4);
+  if(*header == 12 && data_len == 0){
+    *len = 12;
+    return PKT_OK;
+  }
+  // Le CRC2 couvre le numero de sequence etendu puis les donnees
+  uint32_t crc = crc_fn(0, buf+12, *header - 12);
+  if(data_len > 0){
+    crc = crc_fn(crc, pkt_get_payload(pkt), data_len);
+  }
+  uint32_t crc2 = htonl(crc);
+  memcpy(buf+*header, &crc2, 4);
+  *len = *header + 4;
   return PKT_OK;
 }
 
 
-pkt_status_code ack_encode(const ack_t* ack, uint8_t *buf, size_t len)
+/*
+* pkt_encode_sg_batch : Encode un lot de paquets comme pkt_encode_sg, leurs
+* checksums etant calcules ensemble
+*
+* @pkts: Les structures a encoder
+* @n: Le nombre de paquets
+* @bufs: Les buffers dans lesquels les headers et les CRC2 seront encodes
+* @lens: La taille disponible dans chaque buffer
+* @len-POST: Le nombre de d'octets ecrit dans chaque buffer
+* @headers: Mis a la taille de chaque header
+* @return: PKT_OK, ou le code du premier paquet qui n'a pu etre encode :
+* aucun buffer n'est alors utilisable
+*/
+pkt_status_code pkt_encode_sg_batch(const pkt_t **pkts, int n, uint8_t **bufs, size_t *lens, size_t *headers)
+{
+  return pkt_encode_lot(pkts, n, bufs, lens, headers, 0);
+}
+
+
+/*
+* ack_encode : Encode une struct ack dans un buffer, pret a etre envoye sur le reseau
+* (c-a-d en network byte-order), incluant le CRC32 du header et
+* eventuellement les options et leur CRC32.
+*
+* @ack: La structure a encoder
+* @buf: Le buffer dans lequel la structure sera encodee
+* @len: La taille disponible dans le buffer
+* @len-POST: Le nombre de d'octets ecrit dans le buffer
+* @return: Un code indiquant si l'operation a reussi ou E_NOMEM si
+* le buffer est trop petit.
+*/
+pkt_status_code ack_encode(const ack_t* ack, uint8_t *buf, size_t *len)
 {
 
   // Gerer le header
   uint8_t window = ack->window;
-  if(window > 31 || window < 0){
+  if(window > 31){
     fprintf(stderr, "Erreur window\n");
     return E_WINDOW;
   }
@@ -746,13 +1484,9 @@ pkt_status_code ack_encode(const ack_t* ack, uint8_t *buf, size_t len)
     fprintf(stderr, "Erreur tr\n");
     return E_TR;
   }
-  uint8_t seqnum = ack->seqnum;
-  if(seqnum < 0 || seqnum > 255){
-    fprintf(stderr, "Erreur seqnum\n");
-    return E_SEQNUM;
-  }
+  uint8_t seqnum = (uint8_t) ack->seqnum; // 8 bits de poids faible
   uint16_t length = ack->length; // 2 bytes
-  if(length < 0 || length > 512){
+  if(length > MAX_ACK_PAYLOAD_SIZE){
     fprintf(stderr, "Erreur length\n");
     return E_LENGTH;
   }
@@ -760,10 +1494,11 @@ pkt_status_code ack_encode(const ack_t* ack, uint8_t *buf, size_t len)
 
 
   // Teste si le buffer est trop petit
-  if(len < 12){
+  if(*len < ack_get_size(ack)){
     fprintf(stderr, "Erreur nomem\n");
     return E_NOMEM;
   }
+  *len = ack_get_size(ack);
 
   length = htons(length);
 
@@ -784,46 +1519,210 @@ pkt_status_code ack_encode(const ack_t* ack, uint8_t *buf, size_t len)
   memcpy(buf+4, &timestamp, 4); // timestamp
 
   // Gerer les CRC
-  uint32_t crc1 = htonl(crc32(0, (const Bytef *) buf, 8));
+  uint32_t crc1 = htonl(crc32_ieee(0, buf, 8));
   // Huitième au douzième byte : crc1
   memcpy(buf+8, &crc1, 4);
 
+  // Options, puis leur CRC2
+  if(ack->length > 0){
+    uint8_t *opt = buf+12;
+    if(ack->has_sack){
+      opt[0] = ACK_OPT_SACK;
+      opt[1] = ack->nb_sack * ACK_OPT_SACK_BLOC_LEN;
+      int i;
+      for(i = 0; i < ack->nb_sack; i++){
+        uint16_t debut = htons(ack->sack[i].debut);
+        uint16_t nb = htons(ack->sack[i].nb);
+        memcpy(opt+2+i*ACK_OPT_SACK_BLOC_LEN, &debut, 2);
+        memcpy(opt+4+i*ACK_OPT_SACK_BLOC_LEN, &nb, 2);
+      }
+      opt += 2 + opt[1];
+    }
+    if(ack->has_wscale){
+      opt[0] = ACK_OPT_WSCALE;
+      opt[1] = ACK_OPT_WSCALE_LEN;
+      opt[2] = ack->wscale;
+      opt += 2 + ACK_OPT_WSCALE_LEN;
+    }
+    if(ack->has_seq32){
+      uint32_t seq32 = htonl(ack->seqnum);
+      opt[0] = ACK_OPT_SEQ32;
+      opt[1] = ACK_OPT_SEQ32_LEN;
+      memcpy(opt+2, &seq32, 4);
+      opt += 2 + ACK_OPT_SEQ32_LEN;
+    }
+    if(ack->has_mss){
+      uint16_t mss = htons(ack->mss);
+      uint16_t mss_recu = htons(ack->mss_recu);
+      opt[0] = ACK_OPT_MSS;
+      opt[1] = ACK_OPT_MSS_LEN;
+      memcpy(opt+2, &mss, 2);
+      memcpy(opt+4, &mss_recu, 2);
+      opt += 2 + ACK_OPT_MSS_LEN;
+    }
+    if(ack->sack_ok){
+      opt[0] = ACK_OPT_SACK_OK;
+      opt[1] = ACK_OPT_SACK_OK_LEN;
+      opt += 2 + ACK_OPT_SACK_OK_LEN;
+    }
+    if(ack->ack_delay > 0){
+      uint32_t ack_delay = htonl(ack->ack_delay);
+      opt[0] = ACK_OPT_ACK_DELAY;
+      opt[1] = ACK_OPT_ACK_DELAY_LEN;
+      memcpy(opt+2, &ack_delay, 4);
+      opt += 2 + ACK_OPT_ACK_DELAY_LEN;
+    }
+    if(ack->csum != 0){
+      opt[0] = ACK_OPT_CSUM;
+      opt[1] = ACK_OPT_CSUM_LEN;
+      opt[2] = ack->csum;
+      opt += 2 + ACK_OPT_CSUM_LEN;
+    }
+    uint32_t crc2 = htonl(crc32_ieee(0, buf+12, ack->length));
+    memcpy(buf+12+ack->length, &crc2, 4);
+  }
 
   return PKT_OK;
 }
 
 
 /*
-* real_address : Trouve le nom de la ressource correspondant à une adresse IPv6
+* ack_maj_length : Recalcule la taille des options d'un acquittement
 *
-* @address: L'adresse a trouver
-* @rval: Où le resultat de la description de l'adresse IPv6 sera stockee
+* @ack : l'acquittement
 *
-* @return: - NULL si tout s'est bien deroule
-*          - un pointeur vers un string decrivant l'erreur sinon
+* @return : /
 */
-const char *real_address(const char *address, struct sockaddr_in6 *rval){
+static void ack_maj_length(ack_t *ack){
+  ack->length = (ack->has_sack ? 2 + ack->nb_sack * ACK_OPT_SACK_BLOC_LEN : 0) +
+                (ack->has_wscale ? 2 + ACK_OPT_WSCALE_LEN : 0) +
+                (ack->has_seq32 ? 2 + ACK_OPT_SEQ32_LEN : 0) +
+                (ack->has_mss ? 2 + ACK_OPT_MSS_LEN : 0) +
+                (ack->sack_ok ? 2 + ACK_OPT_SACK_OK_LEN : 0) +
+                (ack->ack_delay > 0 ? 2 + ACK_OPT_ACK_DELAY_LEN : 0) +
+                (ack->csum != 0 ? 2 + ACK_OPT_CSUM_LEN : 0);
+}
 
-  int err;
 
-  struct addrinfo *hints = (struct addrinfo *) calloc(1, sizeof(struct addrinfo));
-  if(hints == NULL){
-    return "Erreur d'alloction de mémoire.";
+/*
+* ack_set_sack : Ajoute l'option SACK a un acquittement, ou la retire
+*
+* @ack : l'acquittement
+* @has_sack : 1 pour ajouter l'option, 0 pour la retirer
+* @blocs : les blocs de paquets recus apres le numero de sequence acquitte
+* @nb_blocs : le nombre de blocs, au plus ACK_SACK_MAX_BLOCS
+*
+* @return : /
+*/
+void ack_set_sack(ack_t *ack, uint8_t has_sack, const sack_bloc_t *blocs, int nb_blocs){
+  ack->has_sack = has_sack;
+  ack->nb_sack = has_sack ? nb_blocs : 0;
+  if(ack->nb_sack > 0){
+    memcpy(ack->sack, blocs, ack->nb_sack * sizeof(sack_bloc_t));
   }
-  struct addrinfo *results;
+  ack_maj_length(ack);
+}
 
-  //memset(hints, 0, sizeof(hints)); inutile si on fait calloc() au-dessus
-  hints->ai_family = AF_INET6;
-  hints->ai_protocol = IPPROTO_UDP;
-  hints->ai_socktype = SOCK_DGRAM; // Car UDP packets
-  // hints.ai_socktype = SOCK_STREAM; si TCP packets
 
-  err = getaddrinfo(address, NULL, hints, &results);
-  if(err != 0){
-    return "Erreur d'exécution de la fonction addrinfo.";
-  }
+/*
+* ack_set_ext : Ajoute a un acquittement les options de l'extension de
+* sequence, ou les retire
+*
+* @ack : l'acquittement
+* @has_wscale : 1 pour offrir l'extension (option WSCALE)
+* @wscale : le facteur d'echelle de la fenetre
+* @has_seq32 : 1 pour transmettre seqnum sur 32 bits (option SEQ32)
+*
+* @return : /
+*/
+void ack_set_ext(ack_t *ack, uint8_t has_wscale, uint8_t wscale, uint8_t has_seq32){
+  ack->has_wscale = has_wscale;
+  ack->wscale = has_wscale ? wscale : 0;
+  ack->has_seq32 = has_seq32;
+  ack_maj_length(ack);
+}
 
-  struct sockaddr *temp = results->ai_addr;
+
+/*
+* ack_set_mss : Ajoute l'option MSS a un acquittement, ou la retire
+*
+* @ack : l'acquittement
+* @has_mss : 1 pour ajouter l'option, 0 pour la retirer
+* @mss : le payload maximal accepte
+* @mss_recu : le plus grand payload recu jusqu'ici
+*
+* @return : /
+*/
+void ack_set_mss(ack_t *ack, uint8_t has_mss, uint16_t mss, uint16_t mss_recu){
+  ack->has_mss = has_mss;
+  ack->mss = has_mss ? mss : 0;
+  ack->mss_recu = has_mss ? mss_recu : 0;
+  ack_maj_length(ack);
+}
+
+
+/*
+* ack_set_hello : Ajoute a un acquittement les options propres a la
+* connexion, ou les retire
+*
+* @ack : l'acquittement (ou le paquet de connexion)
+* @sack_ok : 1 pour ajouter l'option SACK_OK
+* @ack_delay : le delai maximal avant d'acquitter, 0 pour retirer l'option
+* @csum : le masque des checksums, 0 pour retirer l'option
+*
+* @return : /
+*/
+void ack_set_hello(ack_t *ack, uint8_t sack_ok, uint32_t ack_delay, uint8_t csum){
+  ack->sack_ok = sack_ok;
+  ack->ack_delay = ack_delay;
+  ack->csum = csum;
+  ack_maj_length(ack);
+}
+
+
+/*
+* ack_get_size : Donne la taille d'un acquittement encode
+*
+* @ack : l'acquittement
+*
+* @return : 12 octets de header, plus les options et leur CRC2 s'il y en a
+*/
+size_t ack_get_size(const ack_t *ack){
+  return 12 + (ack->length > 0 ? ack->length + 4 : 0);
+}
+
+
+/*
+* real_address : Trouve le nom de la ressource correspondant à une adresse IPv6
+*
+* @address: L'adresse a trouver
+* @rval: Où le resultat de la description de l'adresse IPv6 sera stockee
+*
+* @return: - NULL si tout s'est bien deroule
+*          - un pointeur vers un string decrivant l'erreur sinon
+*/
+const char *real_address(const char *address, struct sockaddr_in6 *rval){
+
+  int err;
+
+  struct addrinfo *hints = (struct addrinfo *) calloc(1, sizeof(struct addrinfo));
+  if(hints == NULL){
+    return "Erreur d'alloction de mémoire.";
+  }
+  struct addrinfo *results;
+
+  //memset(hints, 0, sizeof(hints)); inutile si on fait calloc() au-dessus
+  hints->ai_family = AF_INET6;
+  hints->ai_protocol = IPPROTO_UDP;
+  hints->ai_socktype = SOCK_DGRAM; // Car UDP packets
+  // hints.ai_socktype = SOCK_STREAM; si TCP packets
+
+  err = getaddrinfo(address, NULL, hints, &results);
+  if(err != 0){
+    return "Erreur d'exécution de la fonction addrinfo.";
+  }
+
+  struct sockaddr *temp = results->ai_addr;
   struct sockaddr_in6 *final = (struct sockaddr_in6 *) temp;
   *rval = *final;
 
@@ -964,111 +1863,142 @@ int wait_for_client(int sfd){
 
 
 /*
-* seqnum_inc : Incremente le numéro de sequence de 1.
-* Si le numero de sequence etait 255, le remet à 0.
+* seq_lt : Compare deux numeros de sequence sur 32 bits (arithmetique des
+* numeros de serie, RFC 1982)
 *
-* @seqnum : numero de sequence à incrementer
+* @a : un numero de sequence
+* @b : un numero de sequence
 *
-* @return : 0 si le numéro de séquence a été incrémenté
-*           1 si le numéro de séquence a été remis à 0
-*           -1 si le numéro de séquence n'était pas valide
+* @return : 1 si a precede b, 0 sinon
 */
-int seqnum_inc(uint8_t* seqnum){
-  if(*seqnum >= 0 && *seqnum <= 254){
-    *seqnum = *seqnum + 1;
-    return 0;
-  }
-  else if(*seqnum == 255){
-    *seqnum = 0;
-    return 1;
-  }
-  else{
-    return -1;
-  }
+int seq_lt(uint32_t a, uint32_t b){
+  return (int32_t) (a - b) < 0;
 }
 
 
 /*
-* in_window : Vérifie si le numéro de séquence est dans la fenetre
+* seq_in_window : Vérifie si le numéro de séquence est dans la fenetre
 *
 * @seqnum : numero de sequence à verifier
-* @min_window : le plus petit numero de sequence present dans la fenetre
-* @max_window : le plus grand numero de sequence present dans la fenetre
+* @debut : le premier numero de sequence de la fenetre
+* @taille : le nombre de numeros de sequence de la fenetre
+*
+* @return : 1 si il est dans la fenetre, 0 sinon
+*/
+int seq_in_window(uint32_t seqnum, uint32_t debut, uint32_t taille){
+  return seqnum - debut < taille;
+}
+
+
+/*
+* seq_unwrap8 : Retrouve le numero de sequence sur 32 bits dont on ne
+* connait que les 8 bits de poids faible, le plus proche d'une reference
 *
-* @return : 0 si il est dans la fenetre
-*					 -1 si il est hors de la fenetre
-*					 1 si une erreur d'argument
+* @ref : le numero de sequence de reference (32 bits)
+* @seqnum : les 8 bits de poids faible
 *
+* @return : le numero de sequence dans [ref - 128, ref + 127]
 */
-int in_window (uint8_t seqnum, uint8_t min_window, uint8_t max_window){
+uint32_t seq_unwrap8(uint32_t ref, uint8_t seqnum){
+  return ref + (int8_t) (uint8_t) (seqnum - (uint8_t) ref);
+}
 
-  if (seqnum < 0 || seqnum > 255){
-    printf("Le numero de sequence n'est pas valide\n");
-    return 1;
-  }
+/* Buffer de paquets indexe par numero de sequence : le paquet seqnum est dans
+ * le slot seqnum % capacite, et un bitmap indique les slots occupes */
+struct pkt_buffer {
+  pkt_t **slots; // capacite paquets
+  uint64_t *occupe; // Bit i a 1 : le slot i contient un paquet
+  uint32_t capacite; // Puissance de 2, au moins 64
+  int nb_mots; // Nombre de mots de 64 bits du bitmap
+  int nb_pkts; // Nombre de paquets presents
+};
 
-  if(min_window < max_window){
-    if(seqnum >= min_window && seqnum <= max_window){
-      return 0;
-    }
-    else{
-      return -1;
-    }
+
+/*
+* pkt_buffer_new : Cree un buffer de paquets vide
+*
+* @capacite : nombre minimal de slots, arrondi a une puissance de 2 (au
+* moins 64). Elle doit depasser la taille de la fenetre.
+*
+* @return : un nouveau buffer ou NULL en cas d'erreur
+*/
+pkt_buffer_t* pkt_buffer_new(uint32_t capacite){
+  uint32_t cap = 64;
+  while(cap < capacite){
+    cap <<= 1;
   }
-  else{
-    if(seqnum >= min_window || seqnum <= max_window){
-      return 0;
-    }
-    else{
-      return -1;
-    }
+  pkt_buffer_t *buffer = (pkt_buffer_t *) calloc(1, sizeof(pkt_buffer_t));
+  if(buffer == NULL){
+    fprintf(stderr, "Erreur du malloc");
+    return NULL;
   }
+  buffer->slots = (pkt_t **) calloc(cap, sizeof(pkt_t *));
+  buffer->occupe = (uint64_t *) calloc(cap / 64, sizeof(uint64_t));
+  if(buffer->slots == NULL || buffer->occupe == NULL){
+    fprintf(stderr, "Erreur du malloc");
+    pkt_buffer_del(buffer);
+    return NULL;
+  }
+  buffer->capacite = cap;
+  buffer->nb_mots = cap / 64;
+  return buffer;
 }
 
 
 /*
-* decale_window : Decale la fenetre de reception ou d'envoi
+* pkt_buffer_del : Libere un buffer de paquets (mais pas les paquets)
 *
-* @min_window : un pointeur vers le plus petit numero de sequence present dans la fenetre
-* @max_window : un pointeur vers le plus grand numero de sequence present dans la fenetre
+* @buffer : le buffer de paquets
 *
 * @return : /
 */
-void decale_window(uint8_t *min_window, uint8_t *max_window){
-  if(*max_window == 255){
-    *min_window = *min_window + 1;
-    *max_window = 0;
-  }
-  else if(*min_window == 255){
-    *min_window = 0;
-    *max_window = *max_window + 1;
-  }
-  else{
-    *min_window = *min_window + 1;
-    *max_window = *max_window + 1;
+void pkt_buffer_del(pkt_buffer_t *buffer){
+  free(buffer->slots);
+  free(buffer->occupe);
+  free(buffer);
+}
+
+
+/*
+* buffer_bits : Donne 64 bits d'occupation a partir d'un slot, en revenant
+* au debut du bitmap apres le dernier slot
+*
+* @buffer : le buffer de paquets
+* @slot : le premier slot (bit 0 du resultat)
+*
+* @return : le bit i vaut 1 si le slot slot + i est occupe
+*/
+static uint64_t buffer_bits(const pkt_buffer_t *buffer, uint32_t slot){
+  int mot = slot / 64;
+  int decalage = slot % 64;
+  uint64_t bits = buffer->occupe[mot] >> decalage;
+  if(decalage != 0){
+    bits |= buffer->occupe[(mot + 1) % buffer->nb_mots] << (64 - decalage);
   }
+  return bits;
 }
 
+
 /*
-* ajout_buffer : Ajoute un buffer dans le buffer d'envoi ou de reception
+* ajout_buffer : Ajoute un paquet dans le buffer d'envoi ou de reception, a
+* la place correspondant a son numero de sequence
 *
 * @pkt : un pointeur vers un paquet
-* @buffer_recept : buffer de reception qui contient lui-meme des buffer
-* @min_window : le plus petit numero de sequence present dans la fenetre
+* @buffer : buffer d'envoi ou de reception
 *
 * @return : 0 si le paquet a bien été ajouté au buffer
-*           1 si le paquet n'a pas été ajouté au buffer
+*           1 si le paquet n'a pas été ajouté au buffer (place deja prise)
 */
-void ajout_buffer (pkt_t* pkt, pkt_t** buffer_recept, uint8_t min_window){
-  int i;
-  if(min_window <= pkt_get_seqnum(pkt)){
-    i = pkt_get_seqnum(pkt) - min_window;
-    *(buffer_recept + i) = pkt;
-  }
-  else{
-    i = (255-min_window+1+pkt_get_seqnum(pkt));
-    *(buffer_recept + i) = pkt;
+int ajout_buffer (pkt_t* pkt, pkt_buffer_t* buffer){
+  uint32_t slot = pkt_get_seqnum(pkt) & (buffer->capacite - 1);
+  uint64_t bit = (uint64_t) 1 << (slot % 64);
+  if(buffer->occupe[slot / 64] & bit){
+    return 1;
   }
+  buffer->occupe[slot / 64] |= bit;
+  buffer->slots[slot] = pkt;
+  buffer->nb_pkts++;
+  return 0;
 }
 
 /*
@@ -1081,16 +2011,18 @@ void ajout_buffer (pkt_t* pkt, pkt_t** buffer_recept, uint8_t min_window){
 * @return : - le paquet qui a pour numero de sequence seqnum
 *           - NULL en cas d'erreur
 */
-pkt_t* get_from_buffer(pkt_t ** buffer, uint8_t seqnum){
-  int i;
-  for(i = 0; i < MAX_WINDOW_SIZE; i++){
-    if(*(buffer+i) != NULL){
-      if(seqnum == pkt_get_seqnum(*(buffer+i))){
-        return *(buffer+i);
-      }
-    }
+pkt_t* get_from_buffer(pkt_buffer_t * buffer, uint32_t seqnum){
+  uint32_t slot = seqnum & (buffer->capacite - 1);
+  if((buffer->occupe[slot / 64] >> (slot % 64) & 1) == 0){
+    return NULL;
   }
-  return NULL;
+  // Un numero de sequence hors de la fenetre peut tomber sur le slot d'un
+  // autre paquet
+  pkt_t *pkt = buffer->slots[slot];
+  if(pkt_get_seqnum(pkt) != seqnum){
+    return NULL;
+  }
+  return pkt;
 }
 
 /*
@@ -1102,72 +2034,179 @@ pkt_t* get_from_buffer(pkt_t ** buffer, uint8_t seqnum){
 * @return : - 0 si l'element a ete correctement retire du buffer
 * 					 - 1 si l'element n'a pas ete retire correctement
 */
-int retire_buffer(pkt_t ** buffer, uint8_t seqnum){
-  int i;
-  for(i = 0; i < MAX_WINDOW_SIZE; i++){
-    if(*(buffer+i) != NULL){
-      if(seqnum == pkt_get_seqnum(*(buffer+i))){
-        *(buffer+i) = NULL;
-        return 0;
-      }
-    }
+int retire_buffer(pkt_buffer_t * buffer, uint32_t seqnum){
+  if(get_from_buffer(buffer, seqnum) == NULL){
+    return 1;
   }
-  return 1;
+  uint32_t slot = seqnum & (buffer->capacite - 1);
+  buffer->occupe[slot / 64] &= ~((uint64_t) 1 << (slot % 64));
+  buffer->slots[slot] = NULL;
+  buffer->nb_pkts--;
+  return 0;
 }
 
 
 /*
-* buffer_plein : Verifie si le buffer est plein ou pas
+* buffer_taille : Donne le nombre de paquets presents dans le buffer
 *
-* @buffer : buffer de paquets a parcourir
+* @buffer : buffer de paquets
 *
-* @return : - 1 si le buffer est plein
-*  					- 0 si il reste au moins une place dans le buffer
+* @return : le nombre de paquets
 */
-int buffer_plein(pkt_t ** buffer){
-  int i;
-  for(i = 0; i < LENGTH_BUF_REC; i++){
-    if (buffer[i] == NULL){
-      return 0;
-    }
+int buffer_taille(const pkt_buffer_t * buffer){
+  return buffer->nb_pkts;
+}
+
+/*
+* buffer_premier_trou : Cherche le premier numero de sequence absent du
+* buffer a partir d'un numero donne
+*
+* @buffer : buffer de paquets
+* @seqnum : le numero de sequence de depart
+*
+* @return : le plus petit numero de sequence >= seqnum absent du buffer
+*/
+uint32_t buffer_premier_trou(const pkt_buffer_t * buffer, uint32_t seqnum){
+  uint32_t trou = seqnum;
+  uint64_t bits;
+  // Les paquets presents a la suite sont comptes par mots de 64 bits
+  while((bits = ~buffer_bits(buffer, trou & (buffer->capacite - 1))) == 0){
+    trou += 64;
   }
-  return 1;
+  return trou + __builtin_ctzll(bits);
 }
 
 /*
-* write_buffer : Ecrit tous les éléments du buffer qui sont disponible et dans l'ordre
+* buffer_premier_present : Cherche le premier numero de sequence present dans
+* le buffer a partir d'un numero donne. Le buffer ne doit pas etre vide.
+*
+* @buffer : buffer de paquets
+* @seqnum : le numero de sequence de depart
 *
-* @fd : un numero de file descriptor representant le socket
-* @buffer : un buffer de paquets
-* @min_window : un pointeur vers le plus petit numero de sequence present dans la fenetre
-* @max_window : un pointeur vers le plus grand numero de sequence present dans la fenetre
+* @return : le plus petit numero de sequence >= seqnum present dans le buffer
+*/
+static uint32_t buffer_premier_present(const pkt_buffer_t * buffer, uint32_t seqnum){
+  uint32_t present = seqnum;
+  uint64_t bits;
+  while((bits = buffer_bits(buffer, present & (buffer->capacite - 1))) == 0){
+    present += 64;
+  }
+  return present + __builtin_ctzll(bits);
+}
+
+/*
+* buffer_trou_avant : Cherche le dernier numero de sequence absent du buffer
+* jusqu'a un numero donne
 *
-* @return : le nombre d'elements ecrits
+* @buffer : buffer de paquets
+* @seqnum : le numero de sequence de depart
 *
+* @return : le plus grand numero de sequence <= seqnum absent du buffer
 */
-int write_buffer(int fd, pkt_t **buffer, uint8_t *min_window, uint8_t *max_window){
-  int i = 0;
-  for(; i < LENGTH_BUF_REC; i++){
-    if(buffer[i] == NULL){
-      return i;
+static uint32_t buffer_trou_avant(const pkt_buffer_t * buffer, uint32_t seqnum){
+  // Le bit 63 des mots lus correspond a fin
+  uint32_t fin = seqnum;
+  uint64_t bits;
+  while((bits = ~buffer_bits(buffer, (fin - 63) & (buffer->capacite - 1))) == 0){
+    fin -= 64;
+  }
+  return fin - __builtin_clzll(bits);
+}
+
+/*
+* sack_bloc_connu : Verifie si un bloc SACK commencant a un ecart donne est
+* deja dans la liste
+*
+* @blocs : les blocs deja construits
+* @nb : le nombre de blocs
+* @debut : l'ecart du premier paquet du bloc
+*
+* @return : 1 si le bloc est deja dans la liste, 0 sinon
+*/
+static int sack_bloc_connu(const sack_bloc_t *blocs, int nb, uint16_t debut){
+  int i;
+  for(i = 0; i < nb; i++){
+    if(blocs[i].debut == debut){
+      return 1;
     }
-    else{
-      if(fd == STDOUT){
-        printf("Données reçues :\n");
-        printf("%s\n", pkt_get_payload(buffer[i]));
-        buffer[i] = NULL;
-        decale_window(min_window, max_window);
+  }
+  return 0;
+}
+
+/*
+* buffer_vider : Retire tous les paquets du buffer
+*
+* @buffer : buffer de paquets
+* @slab : le slab auquel rendre les paquets (NULL : ils sont liberes)
+*
+* @return : /
+*/
+void buffer_vider(pkt_buffer_t * buffer, pkt_slab_t *slab){
+  int mot;
+  for(mot = 0; mot < buffer->nb_mots; mot++){
+    while(buffer->occupe[mot] != 0){
+      uint32_t slot = mot * 64 + __builtin_ctzll(buffer->occupe[mot]);
+      buffer->occupe[mot] &= buffer->occupe[mot] - 1;
+      if(slab != NULL){
+        pkt_slot_release(slab, buffer->slots[slot]);
       }
       else{
-        write(fd, pkt_get_payload(buffer[i]), pkt_get_length(buffer[i]));
-        buffer[i] = NULL;
-        decale_window(min_window, max_window);
+        pkt_del(buffer->slots[slot]);
       }
+      buffer->slots[slot] = NULL;
     }
   }
-  return i;
+  buffer->nb_pkts = 0;
 }
 
+/*
+* sack_blocs : Construit les blocs SACK des paquets hors-sequence presents
+* dans le buffer de reception. Les premiers contiennent les derniers paquets
+* recus : chacun est ainsi annonce au moins une fois au sender, meme quand
+* les trous sont plus nombreux que les blocs. Les autres suivent dans l'ordre
+* a partir du trou.
+*
+* @buffer : le buffer de reception
+* @min_window : le prochain numero de sequence attendu (le trou), acquitte
+* @recents : les derniers paquets hors-sequence recus, du plus recent au plus ancien
+* @nb_recents : le nombre de paquets de recents
+* @blocs : ou stocker les blocs, au moins ACK_SACK_MAX_BLOCS
+*
+* @return : le nombre de blocs
+*/
+int sack_blocs(pkt_buffer_t * buffer, uint32_t min_window, const uint32_t *recents, int nb_recents,
+               sack_bloc_t *blocs){
+  int nb = 0;
+  int i;
+  // Bloc de chacun des derniers paquets recus encore dans le buffer
+  for(i = 0; i < nb_recents && nb < ACK_SACK_MAX_BLOCS; i++){
+    if(!seq_lt(min_window, recents[i]) || get_from_buffer(buffer, recents[i]) == NULL){
+      continue;
+    }
+    uint32_t debut = buffer_trou_avant(buffer, recents[i]) + 1;
+    if(!sack_bloc_connu(blocs, nb, (uint16_t) (debut - min_window))){
+      blocs[nb].debut = (uint16_t) (debut - min_window);
+      blocs[nb].nb = (uint16_t) (buffer_premier_trou(buffer, debut) - debut);
+      nb++;
+    }
+  }
+
+  // Les autres dans l'ordre, jusqu'au dernier paquet du buffer
+  int restants = buffer->nb_pkts;
+  uint32_t seq = min_window + 1;
+  while(nb < ACK_SACK_MAX_BLOCS && restants > 0){
+    uint32_t debut = buffer_premier_present(buffer, seq);
+    uint32_t fin = buffer_premier_trou(buffer, debut);
+    if(!sack_bloc_connu(blocs, nb, (uint16_t) (debut - min_window))){
+      blocs[nb].debut = (uint16_t) (debut - min_window);
+      blocs[nb].nb = (uint16_t) (fin - debut);
+      nb++;
+    }
+    restants -= fin - debut;
+    seq = fin + 1;
+  }
+  return nb;
+}
 
 
 /*
@@ -1191,3 +2230,2853 @@ int arg_check(int argc, int n_min, int n_max){
   }
   return 0;
 }
+
+
+/*
+* arg_entier : Lit un entier passe en ligne de commande
+*
+* @arg : l'argument
+* @min : la plus petite valeur acceptee
+* @max : la plus grande valeur acceptee
+* @val : ou stocker la valeur lue
+*
+* @return : - 0 si l'argument est un entier decimal entre min et max
+*           - -1 sinon
+*/
+int arg_entier(const char *arg, long min, long max, long *val){
+  char *fin;
+  errno = 0;
+  long v = strtol(arg, &fin, 10);
+  if(fin == arg || *fin != '\0' || errno == ERANGE || v < min || v > max){
+    return -1;
+  }
+  *val = v;
+  return 0;
+}
+
+
+/*
+* time_now_us : Donne l'heure d'une horloge monotone, en microsecondes
+*
+* @return : le temps ecoule depuis un instant de reference arbitraire
+*/
+uint64_t time_now_us(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+// Un timer de la roue : il y en a un par cle, chaine dans la case de son echeance
+struct timer_entry {
+  uint64_t deadline; // Echeance en microsecondes
+  uint32_t slot; // Case dans laquelle le timer est chaine (roue fine puis
+                 // roue de debordement)
+  int armed; // 1 si le timer est arme
+  struct timer_entry *prev;
+  struct timer_entry *next;
+};
+
+// Roue de timers hierarchique a deux niveaux. La roue fine couvre les
+// TIMER_WHEEL_SLOTS ticks a partir du tick courant, une case par tick : la
+// premiere case non vide contient donc la plus proche echeance. Les timers
+// plus lointains sont dans la roue de debordement, une case par tour de la
+// roue fine (prise modulo TIMER_WHEEL_SLOTS), et descendent dans la roue fine
+// au debut de leur tour.
+struct timer_wheel {
+  struct timer_entry *entries; // nb_keys timers, indexes par cle
+  uint32_t nb_keys;
+  struct timer_entry *slots[2 * TIMER_WHEEL_SLOTS]; // Roue fine puis roue de debordement
+  uint64_t current_tick; // Dernier tick traite par timer_expire
+  uint64_t tour_descendu; // Dernier tour dont les timers sont descendus
+  int nb_armed;
+  int nb_proches; // Timers armes dans la roue fine
+};
+
+
+/*
+* timer_wheel_new : Cree une roue de timers vide
+*
+* @nb_keys : nombre de cles differentes (les cles sont prises modulo nb_keys)
+* @now : le temps actuel, en microsecondes
+*
+* @return : une nouvelle roue de timers ou NULL en cas d'erreur
+*/
+timer_wheel_t* timer_wheel_new(uint32_t nb_keys, uint64_t now){
+  timer_wheel_t *tw = (timer_wheel_t *) calloc(1, sizeof(timer_wheel_t));
+  if(tw == NULL){
+    fprintf(stderr, "Erreur du malloc");
+    return NULL;
+  }
+  tw->entries = (struct timer_entry *) calloc(nb_keys, sizeof(struct timer_entry));
+  if(tw->entries == NULL){
+    fprintf(stderr, "Erreur du malloc");
+    free(tw);
+    return NULL;
+  }
+  tw->nb_keys = nb_keys;
+  tw->current_tick = now / TIMER_WHEEL_TICK_US;
+  tw->tour_descendu = tw->current_tick / TIMER_WHEEL_SLOTS;
+  return tw;
+}
+
+
+/*
+* timer_wheel_del : Libere une roue de timers
+*
+* @tw : la roue de timers
+*
+* @return : /
+*/
+void timer_wheel_del(timer_wheel_t *tw){
+  if(tw == NULL){
+    return;
+  }
+  free(tw->entries);
+  free(tw);
+}
+
+
+// Retire un timer arme de la liste de sa case
+static void timer_unlink(timer_wheel_t *tw, struct timer_entry *e){
+  if(e->prev != NULL){
+    e->prev->next = e->next;
+  }
+  else{
+    tw->slots[e->slot] = e->next;
+  }
+  if(e->next != NULL){
+    e->next->prev = e->prev;
+  }
+  if(e->slot < TIMER_WHEEL_SLOTS){
+    tw->nb_proches--;
+  }
+  e->prev = NULL;
+  e->next = NULL;
+  e->armed = 0;
+  tw->nb_armed--;
+}
+
+
+// Chaine un timer dans la case de son echeance : la roue fine si elle tombe
+// dans le tour en cours a partir du tick courant, la roue de debordement sinon
+static void timer_link(timer_wheel_t *tw, struct timer_entry *e){
+  // Une echeance deja depassee est placee dans la case courante pour etre
+  // traitee au prochain appel a timer_expire
+  uint64_t tick = e->deadline / TIMER_WHEEL_TICK_US;
+  if(tick < tw->current_tick){
+    tick = tw->current_tick;
+  }
+  if(tick - tw->current_tick < TIMER_WHEEL_SLOTS){
+    e->slot = tick & (TIMER_WHEEL_SLOTS - 1);
+    tw->nb_proches++;
+  }
+  else{
+    e->slot = TIMER_WHEEL_SLOTS + ((tick / TIMER_WHEEL_SLOTS) & (TIMER_WHEEL_SLOTS - 1));
+  }
+  e->armed = 1;
+  e->prev = NULL;
+  e->next = tw->slots[e->slot];
+  if(e->next != NULL){
+    e->next->prev = e;
+  }
+  tw->slots[e->slot] = e;
+  tw->nb_armed++;
+}
+
+
+// Fait descendre dans la roue fine les timers d'un tour de la roue de
+// debordement, qui commence au tick courant. Ceux des tours suivants qui
+// partagent la case y retournent.
+static void timer_descendre(timer_wheel_t *tw, uint64_t tour){
+  uint32_t slot = TIMER_WHEEL_SLOTS + (tour & (TIMER_WHEEL_SLOTS - 1));
+  struct timer_entry *e = tw->slots[slot];
+  tw->slots[slot] = NULL;
+  while(e != NULL){
+    struct timer_entry *next = e->next;
+    tw->nb_armed--;
+    timer_link(tw, e);
+    e = next;
+  }
+  tw->tour_descendu = tour;
+}
+
+
+/*
+* timer_arm : Arme (ou rearme) le timer associe a une cle
+*
+* @tw : la roue de timers
+* @key : la cle du timer (par exemple un numero de sequence)
+* @deadline : l'echeance du timer, en microsecondes
+*
+* @return : /
+*/
+void timer_arm(timer_wheel_t *tw, uint32_t key, uint64_t deadline){
+  struct timer_entry *e = &tw->entries[key % tw->nb_keys];
+  if(e->armed){
+    timer_unlink(tw, e);
+  }
+  e->deadline = deadline;
+  timer_link(tw, e);
+}
+
+
+/*
+* timer_cancel : Desarme le timer associe a une cle (sans effet s'il ne l'est pas)
+*
+* @tw : la roue de timers
+* @key : la cle du timer
+*
+* @return : /
+*/
+void timer_cancel(timer_wheel_t *tw, uint32_t key){
+  struct timer_entry *e = &tw->entries[key % tw->nb_keys];
+  if(e->armed){
+    timer_unlink(tw, e);
+  }
+}
+
+
+/*
+* timer_is_armed : Verifie si le timer associe a une cle est arme
+*
+* @tw : la roue de timers
+* @key : la cle du timer
+*
+* @return : 1 si le timer est arme, 0 sinon
+*/
+int timer_is_armed(const timer_wheel_t *tw, uint32_t key){
+  return tw->entries[key % tw->nb_keys].armed;
+}
+
+
+/*
+* timer_next_deadline : Donne la plus proche echeance parmi les timers armes.
+* Si tous sont dans la roue de debordement, c'est le debut du tour ou le plus
+* proche descend dans la roue fine : timer_expire l'y fait descendre, et
+* l'echeance exacte est connue au prochain appel.
+*
+* @tw : la roue de timers
+* @deadline : ou stocker l'echeance la plus proche
+*
+* @return : 1 si au moins un timer est arme (et *deadline est rempli)
+*           0 si aucun timer n'est arme
+*/
+int timer_next_deadline(timer_wheel_t *tw, uint64_t *deadline){
+  if(tw->nb_armed == 0){
+    return 0;
+  }
+
+  // La roue fine ne couvre qu'un tour de roue a partir du tick courant : la
+  // premiere case non vide contient la plus proche echeance. Ce tour deborde
+  // sur le suivant, dont les timers armes plus tot sont encore dans la roue
+  // de debordement : le debut de ce tour borne alors l'echeance.
+  uint64_t premier = tw->current_tick / TIMER_WHEEL_SLOTS + 1;
+  uint64_t t;
+  if(tw->nb_proches > 0){
+    for(t = tw->current_tick; t < tw->current_tick + TIMER_WHEEL_SLOTS; t++){
+      struct timer_entry *e = tw->slots[t & (TIMER_WHEEL_SLOTS - 1)];
+      if(e == NULL){
+        continue;
+      }
+      *deadline = e->deadline;
+      for(e = e->next; e != NULL; e = e->next){
+        if(e->deadline < *deadline){
+          *deadline = e->deadline;
+        }
+      }
+      uint64_t debut = premier * TIMER_WHEEL_SLOTS * TIMER_WHEEL_TICK_US;
+      if(debut < *deadline && tw->slots[TIMER_WHEEL_SLOTS + (premier & (TIMER_WHEEL_SLOTS - 1))] != NULL){
+        *deadline = debut;
+      }
+      return 1;
+    }
+  }
+
+  // Premier tour de la roue de debordement qui contient un timer
+  uint64_t tour;
+  for(tour = premier; tour < premier + TIMER_WHEEL_SLOTS; tour++){
+    if(tw->slots[TIMER_WHEEL_SLOTS + (tour & (TIMER_WHEEL_SLOTS - 1))] != NULL){
+      *deadline = tour * TIMER_WHEEL_SLOTS * TIMER_WHEEL_TICK_US;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+
+/*
+* timer_expire : Desarme et renvoie les cles des timers dont l'echeance est depassee
+*
+* @tw : la roue de timers
+* @now : le temps actuel, en microsecondes
+* @keys : tableau ou stocker les cles des timers expires
+* @max_keys : taille du tableau keys
+*
+* @return : le nombre de cles stockees dans keys
+*/
+int timer_expire(timer_wheel_t *tw, uint64_t now, uint32_t *keys, int max_keys){
+  int n = 0;
+  uint64_t now_tick = now / TIMER_WHEEL_TICK_US;
+  if(now_tick < tw->current_tick){
+    now_tick = tw->current_tick;
+  }
+
+  uint64_t t = tw->current_tick;
+  while(t <= now_tick){
+    // Debut d'un tour : ses timers descendent de la roue de debordement
+    uint64_t tour = t / TIMER_WHEEL_SLOTS;
+    if(tour != tw->tour_descendu){
+      tw->current_tick = t;
+      timer_descendre(tw, tour);
+    }
+    struct timer_entry *e = tw->slots[t & (TIMER_WHEEL_SLOTS - 1)];
+    while(e != NULL){
+      struct timer_entry *next = e->next;
+      if(e->deadline <= now){
+        if(n == max_keys){
+          // Plus de place : on reprendra a partir de cette case
+          tw->current_tick = t;
+          return n;
+        }
+        keys[n++] = (uint32_t) (e - tw->entries);
+        timer_unlink(tw, e);
+      }
+      e = next;
+    }
+    if(t == now_tick){
+      break;
+    }
+    // Roue fine vide : rien a faire avant le debut du tour suivant
+    t = tw->nb_proches > 0 ? t + 1 : (tour + 1) * TIMER_WHEEL_SLOTS;
+  }
+  tw->current_tick = now_tick;
+  return n;
+}
+
+
+/*
+* rtt_init : Initialise l'estimateur de RTT, avant toute mesure
+*
+* @rtt : l'estimateur a initialiser
+*
+* @return : /
+*/
+void rtt_init(rtt_t *rtt){
+  rtt->srtt = 0;
+  rtt->rttvar = 0;
+  rtt->rto = RTO_INIT_US;
+  rtt->has_sample = 0;
+}
+
+
+/*
+* rtt_update : Met a jour SRTT, RTTVAR et le RTO avec une nouvelle mesure de RTT
+* (algorithme de Jacobson/Karels, RFC 6298)
+*
+* @rtt : l'estimateur
+* @sample : le RTT mesure, en microsecondes
+*
+* @return : /
+*/
+void rtt_update(rtt_t *rtt, uint64_t sample){
+  if(!rtt->has_sample){
+    rtt->srtt = sample;
+    rtt->rttvar = sample / 2;
+    rtt->has_sample = 1;
+  }
+  else{
+    uint64_t delta = rtt->srtt > sample ? rtt->srtt - sample : sample - rtt->srtt;
+    // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R| ; SRTT = 7/8 SRTT + 1/8 R
+    rtt->rttvar = (3 * rtt->rttvar + delta) / 4;
+    rtt->srtt = (7 * rtt->srtt + sample) / 8;
+  }
+
+  // RTO = SRTT + max(G, 4 RTTVAR), G etant la granularite des timers. Sur
+  // un chemin tres regulier RTTVAR tend vers 0 : on garde une marge d'un
+  // quart de SRTT pour absorber la gigue des files d'attente.
+  uint64_t var = 4 * rtt->rttvar;
+  if(var < rtt->srtt / 4){
+    var = rtt->srtt / 4;
+  }
+  if(var < TIMER_WHEEL_TICK_US){
+    var = TIMER_WHEEL_TICK_US;
+  }
+  rtt->rto = rtt->srtt + var;
+  if(rtt->rto < RTO_MIN_US){
+    rtt->rto = RTO_MIN_US;
+  }
+  if(rtt->rto > RTO_MAX_US){
+    rtt->rto = RTO_MAX_US;
+  }
+}
+
+
+/*
+* rtt_backoff : Double le RTO apres l'expiration d'un timer de retransmission
+*
+* @rtt : l'estimateur
+*
+* @return : /
+*/
+void rtt_backoff(rtt_t *rtt){
+  rtt->rto *= 2;
+  if(rtt->rto > RTO_MAX_US){
+    rtt->rto = RTO_MAX_US;
+  }
+}
+
+
+// NewReno (RFC 6582) : slow start puis augmentation d'un paquet par RTT,
+// fenetre divisee par deux a chaque perte
+
+static void newreno_init(cc_t *cc, uint64_t now){
+  (void) now;
+  cc->cwnd = CC_INIT_CWND;
+  cc->ssthresh = CC_MAX_CWND;
+}
+
+static void newreno_on_ack(cc_t *cc, uint32_t acked, uint64_t now, const rtt_t *rtt){
+  (void) now;
+  (void) rtt;
+  if(cc->cwnd < cc->ssthresh){
+    cc->cwnd += acked; // Slow start
+  }
+  else{
+    cc->cwnd += (double) acked / cc->cwnd; // Congestion avoidance
+  }
+}
+
+static void newreno_on_loss(cc_t *cc, uint64_t now){
+  (void) now;
+  cc->ssthresh = cc->cwnd / 2 < 2 ? 2 : cc->cwnd / 2;
+  cc->cwnd = cc->ssthresh;
+}
+
+static void newreno_on_timeout(cc_t *cc, uint64_t now){
+  (void) now;
+  cc->ssthresh = cc->cwnd / 2 < 2 ? 2 : cc->cwnd / 2;
+  cc->cwnd = 1;
+}
+
+static uint32_t generic_cwnd(const cc_t *cc){
+  return cc->cwnd < 1 ? 1 : (uint32_t) cc->cwnd;
+}
+
+static const cc_ops_t cc_newreno = {
+  "newreno", newreno_init, newreno_on_ack, newreno_on_loss, newreno_on_timeout, generic_cwnd
+};
+
+
+// CUBIC (RFC 8312) : la fenetre suit une fonction cubique du temps ecoule
+// depuis la derniere perte, centree sur la fenetre a laquelle elle a eu lieu
+
+#define CUBIC_C 0.4
+#define CUBIC_BETA 0.7
+
+static void cubic_init(cc_t *cc, uint64_t now){
+  (void) now;
+  cc->cwnd = CC_INIT_CWND;
+  cc->ssthresh = CC_MAX_CWND;
+  cc->w_max = 0;
+  cc->k = 0;
+  cc->w_est = 0;
+  cc->epoch_start = 0;
+}
+
+static void cubic_on_ack(cc_t *cc, uint32_t acked, uint64_t now, const rtt_t *rtt){
+  if(cc->cwnd < cc->ssthresh){
+    cc->cwnd += acked; // Slow start
+    return;
+  }
+
+  if(cc->epoch_start == 0){
+    // Debut d'une nouvelle epoque de congestion avoidance
+    cc->epoch_start = now;
+    if(cc->cwnd < cc->w_max){
+      cc->k = cbrt((cc->w_max - cc->cwnd) / CUBIC_C);
+    }
+    else{
+      cc->k = 0;
+      cc->w_max = cc->cwnd;
+    }
+    cc->w_est = cc->cwnd;
+  }
+
+  // Fenetre visee un RTT plus tard : W(t) = C (t - K)^3 + W_max
+  double t = (double) (now - cc->epoch_start + rtt->srtt) / 1000000;
+  double target = CUBIC_C * (t - cc->k) * (t - cc->k) * (t - cc->k) + cc->w_max;
+
+  // Region TCP-friendly : on ne fait jamais moins bien que Reno
+  cc->w_est += 3 * (1 - CUBIC_BETA) / (1 + CUBIC_BETA) * acked / cc->cwnd;
+
+  if(target > cc->cwnd){
+    cc->cwnd += (target - cc->cwnd) / cc->cwnd * acked;
+  }
+  else{
+    cc->cwnd += 0.01 * acked / cc->cwnd;
+  }
+  if(cc->w_est > cc->cwnd){
+    cc->cwnd = cc->w_est;
+  }
+}
+
+static void cubic_reduce(cc_t *cc){
+  // Fast convergence : on libere de la bande passante pour les nouveaux flux
+  if(cc->cwnd < cc->w_max){
+    cc->w_max = cc->cwnd * (1 + CUBIC_BETA) / 2;
+  }
+  else{
+    cc->w_max = cc->cwnd;
+  }
+  cc->ssthresh = cc->cwnd * CUBIC_BETA < 2 ? 2 : cc->cwnd * CUBIC_BETA;
+  cc->epoch_start = 0;
+}
+
+static void cubic_on_loss(cc_t *cc, uint64_t now){
+  (void) now;
+  cubic_reduce(cc);
+  cc->cwnd = cc->ssthresh;
+}
+
+static void cubic_on_timeout(cc_t *cc, uint64_t now){
+  (void) now;
+  cubic_reduce(cc);
+  cc->cwnd = 1;
+}
+
+static const cc_ops_t cc_cubic = {
+  "cubic", cubic_init, cubic_on_ack, cubic_on_loss, cubic_on_timeout, generic_cwnd
+};
+
+
+/*
+* cc_find : Cherche un algorithme de controle de congestion par son nom
+*
+* @name : le nom de l'algorithme ("newreno" ou "cubic")
+*
+* @return : l'algorithme ou NULL s'il n'existe pas
+*/
+const cc_ops_t* cc_find(const char *name){
+  if(strcmp(name, cc_newreno.name) == 0){
+    return &cc_newreno;
+  }
+  if(strcmp(name, cc_cubic.name) == 0){
+    return &cc_cubic;
+  }
+  return NULL;
+}
+
+
+/*
+* cc_init : Initialise le controle de congestion avec un algorithme donne
+*
+* @cc : l'etat a initialiser
+* @ops : l'algorithme a utiliser
+* @now : le temps actuel, en microsecondes
+*
+* @return : /
+*/
+void cc_init(cc_t *cc, const cc_ops_t *ops, uint64_t now){
+  memset(cc, 0, sizeof(cc_t));
+  cc->ops = ops;
+  ops->init(cc, now);
+}
+
+
+/*
+* cc_on_ack : Signale que des paquets ont ete acquittes
+*
+* @cc : l'etat du controle de congestion
+* @acked : le nombre de paquets nouvellement acquittes
+* @nb_acquittes : le nombre total de paquets acquittes depuis le debut
+* @en_vol : le nombre de paquets en vol avant cet acquittement
+* @now : le temps actuel, en microsecondes
+* @rtt : l'estimation courante du RTT
+*
+* @return : /
+*/
+void cc_on_ack(cc_t *cc, uint32_t acked, uint32_t nb_acquittes, uint32_t en_vol,
+  uint64_t now, const rtt_t *rtt){
+
+  // La recuperation se termine quand tout ce qui etait en vol lors de la
+  // perte a ete acquitte
+  if(cc->in_recovery && (int32_t) (nb_acquittes - cc->recover) >= 0){
+    cc->in_recovery = 0;
+  }
+  // Pendant la recuperation d'une perte la fenetre reste figee ; apres un
+  // timeout, on repart par contre directement en slow start
+  if(cc->in_recovery == CC_RECOVERY_LOSS || acked == 0){
+    return;
+  }
+
+  // On n'agrandit la fenetre que si elle limite vraiment l'envoi
+  // (et pas la fenetre du receiver ou les donnees a envoyer)
+  if(2 * en_vol < cc_cwnd(cc)){
+    return;
+  }
+
+  cc->ops->on_ack(cc, acked, now, rtt);
+  if(cc->cwnd > CC_MAX_CWND){
+    cc->cwnd = CC_MAX_CWND;
+  }
+}
+
+
+/*
+* cc_on_loss : Signale une perte detectee sans timeout. La fenetre n'est
+* reduite qu'une fois par fenetre de donnees envoyees.
+*
+* @cc : l'etat du controle de congestion
+* @nb_envoyes : le nombre total de paquets envoyes depuis le debut
+* @now : le temps actuel, en microsecondes
+*
+* @return : /
+*/
+void cc_on_loss(cc_t *cc, uint32_t nb_envoyes, uint64_t now){
+  if(cc->in_recovery){
+    return;
+  }
+  cc->in_recovery = CC_RECOVERY_LOSS;
+  cc->recover = nb_envoyes;
+  cc->ops->on_loss(cc, now);
+}
+
+
+/*
+* cc_on_timeout : Signale l'expiration d'un timer de retransmission
+*
+* @cc : l'etat du controle de congestion
+* @nb_envoyes : le nombre total de paquets envoyes depuis le debut
+* @now : le temps actuel, en microsecondes
+*
+* @return : /
+*/
+void cc_on_timeout(cc_t *cc, uint32_t nb_envoyes, uint64_t now){
+  // Plusieurs timers expirent souvent pour une meme perte en rafale : on ne
+  // revient en slow start qu'une fois par fenetre
+  if(cc->in_recovery == CC_RECOVERY_TIMEOUT){
+    return;
+  }
+  cc->in_recovery = CC_RECOVERY_TIMEOUT;
+  cc->recover = nb_envoyes;
+  cc->ops->on_timeout(cc, now);
+}
+
+
+/*
+* cc_cwnd : Donne la fenetre de congestion courante
+*
+* @cc : l'etat du controle de congestion
+*
+* @return : la fenetre de congestion, en paquets (au moins 1)
+*/
+uint32_t cc_cwnd(const cc_t *cc){
+  return cc->ops->cwnd(cc);
+}
+
+
+/*
+* cc_in_slow_start : Verifie si le controle de congestion est en slow start
+*
+* @cc : l'etat du controle de congestion
+*
+* @return : 1 si cwnd < ssthresh, 0 sinon
+*/
+int cc_in_slow_start(const cc_t *cc){
+  return cc->cwnd < cc->ssthresh;
+}
+
+
+/*
+* pacer_init : Initialise un pacer, sans limite de debit
+*
+* @p : le pacer
+* @mss : la taille d'un paquet sur le reseau, en octets
+*
+* @return : /
+*/
+void pacer_init(pacer_t *p, uint32_t mss){
+  p->rate = 0;
+  p->next_send = 0;
+  p->mss = mss;
+}
+
+
+/*
+* pacer_set_rate : Recalcule le debit du pacer : gain * cwnd * mss / SRTT
+*
+* @p : le pacer
+* @cc : l'etat du controle de congestion
+* @rtt : l'estimation courante du RTT (pas de pacing sans mesure)
+*
+* @return : le nouveau debit, en octets par seconde (0 si pas de pacing)
+*/
+uint64_t pacer_set_rate(pacer_t *p, const cc_t *cc, const rtt_t *rtt){
+  if(!rtt->has_sample || rtt->srtt == 0){
+    p->rate = 0;
+    return 0;
+  }
+  // En slow start la fenetre double a chaque RTT : le debit doit suivre
+  double gain = cc_in_slow_start(cc) ? PACING_GAIN_SS : PACING_GAIN_CA;
+  p->rate = (uint64_t) (gain * cc_cwnd(cc) * p->mss * 1000000 / rtt->srtt);
+  return p->rate;
+}
+
+
+/*
+* pacer_delay : Donne le temps a attendre avant de pouvoir envoyer un paquet
+*
+* @p : le pacer
+* @now : le temps actuel, en microsecondes
+*
+* @return : 0 si un paquet peut partir maintenant, le temps d'attente en
+* microsecondes sinon
+*/
+uint64_t pacer_delay(const pacer_t *p, uint64_t now){
+  if(p->rate == 0 || p->next_send <= now){
+    return 0;
+  }
+  return p->next_send - now;
+}
+
+
+/*
+* pacer_on_send : Comptabilise l'envoi d'un paquet
+*
+* @p : le pacer
+* @bytes : la taille du paquet envoye
+* @now : le temps actuel, en microsecondes
+*
+* @return : l'heure de depart prevue du paquet (au plus tot now)
+*/
+uint64_t pacer_on_send(pacer_t *p, size_t bytes, uint64_t now){
+  if(p->rate == 0){
+    p->next_send = now;
+    return now;
+  }
+
+  // Un reveil en retard peut etre rattrape, mais au plus de PACING_BURST
+  // paquets : au-dela, le temps perdu l'est definitivement
+  uint64_t burst = (uint64_t) PACING_BURST * p->mss * 1000000 / p->rate;
+  uint64_t depart = p->next_send;
+  if(depart + burst < now){
+    depart = now - burst;
+  }
+
+  p->next_send = depart + bytes * 1000000 / p->rate;
+  return depart > now ? depart : now;
+}
+
+
+/*
+* ack_policy_init : Initialise la politique d'acquittement
+*
+* @p : la politique d'acquittement
+* @every : le nombre de paquets dans l'ordre acquittes par un meme ACK
+* @delay : le delai maximal avant d'acquitter un paquet, en microsecondes
+*
+* @return : /
+*/
+void ack_policy_init(ack_policy_t *p, uint32_t every, uint64_t delay){
+  p->every = every > 0 ? every : 1;
+  p->delay = delay;
+  p->pending = 0;
+  p->deadline = 0;
+}
+
+
+/*
+* ack_policy_on_data : Signale la reception d'un paquet de donnees et decide
+* s'il faut l'acquitter tout de suite
+*
+* @p : la politique d'acquittement
+* @immediate : 1 si le paquet doit etre acquitte sans attendre (hors
+* sequence, trou dans la fenetre, trou comble, doublon)
+* @now : le temps actuel, en microsecondes
+*
+* @return : 1 s'il faut envoyer un ACK maintenant, 0 sinon
+*/
+int ack_policy_on_data(ack_policy_t *p, int immediate, uint64_t now){
+  if(p->pending == 0){
+    p->deadline = now + p->delay;
+  }
+  p->pending++;
+  return immediate || p->pending >= p->every || p->delay == 0;
+}
+
+
+/*
+* ack_policy_timeout : Donne le temps restant avant l'envoi de l'ACK en attente
+*
+* @p : la politique d'acquittement
+* @now : le temps actuel, en microsecondes
+*
+* @return : le temps d'attente en microsecondes, ou -1 si aucun ACK n'est en attente
+*/
+int64_t ack_policy_timeout(const ack_policy_t *p, uint64_t now){
+  if(p->pending == 0){
+    return -1;
+  }
+  return p->deadline > now ? (int64_t) (p->deadline - now) : 0;
+}
+
+
+/*
+* ack_policy_on_sent : Signale qu'un ACK a ete envoye
+*
+* @p : la politique d'acquittement
+*
+* @return : /
+*/
+void ack_policy_on_sent(ack_policy_t *p){
+  p->pending = 0;
+}
+
+
+/*
+* pkt_slab_new : Alloue d'un bloc un slab de paquets, tous disponibles
+*
+* @nb_slots : le nombre de paquets du slab (au plus 65535)
+* @capacite : la taille maximale du payload de chaque paquet
+*
+* @return : un nouveau slab ou NULL en cas d'erreur
+*/
+pkt_slab_t* pkt_slab_new(int nb_slots, uint16_t capacite){
+  pkt_slab_t *slab = (pkt_slab_t *) calloc(1, sizeof(pkt_slab_t));
+  if(slab == NULL){
+    fprintf(stderr, "Erreur du malloc");
+    return NULL;
+  }
+  slab->taille_slot = taille_pkt(capacite);
+  slab->capacite = capacite;
+  slab->slots = (char *) aligned_alloc(PKT_SLOT_ALIGN, nb_slots * slab->taille_slot);
+  slab->libres = (uint16_t *) malloc(nb_slots * sizeof(uint16_t));
+  if(slab->slots == NULL || slab->libres == NULL){
+    fprintf(stderr, "Erreur du malloc");
+    pkt_slab_del(slab);
+    return NULL;
+  }
+  slab->nb_slots = nb_slots;
+  // Les premiers slots sont au sommet de la pile : ils sont servis en premier
+  int i;
+  for(i = 0; i < nb_slots; i++){
+    slab->libres[i] = nb_slots - 1 - i;
+  }
+  for(i = 0; i < nb_slots; i++){
+    ((pkt_t *) (slab->slots + i * slab->taille_slot))->capacite = capacite;
+  }
+  slab->nb_libres = nb_slots;
+  return slab;
+}
+
+
+/*
+* pkt_slab_del : Libere un slab et tous ses paquets
+*
+* @slab : le slab de paquets
+*
+* @return : /
+*/
+void pkt_slab_del(pkt_slab_t *slab){
+  free(slab->slots);
+  free(slab->libres);
+  free(slab);
+}
+
+
+/*
+* pkt_slot_acquire : Prend un paquet libre dans le slab, remis a zero. Un
+* paquet est alloue a part seulement si le slab est epuise.
+*
+* @slab : le slab de paquets
+*
+* @return : un paquet de type PTYPE_DATA ou NULL en cas d'erreur
+*/
+pkt_t* pkt_slot_acquire(pkt_slab_t *slab){
+  if(slab->nb_libres == 0){
+    return pkt_new_taille(slab->capacite);
+  }
+  pkt_t *pkt = (pkt_t *) (slab->slots + slab->libres[--slab->nb_libres] * slab->taille_slot);
+  // Le payload est ecrase par le prochain pkt_set_payload : seul le header
+  // est remis a zero
+  pkt_reset(pkt);
+  return pkt;
+}
+
+
+/*
+* pkt_slot_release : Rend un paquet au slab. Un paquet alloue hors du slab
+* est libere.
+*
+* @slab : le slab de paquets
+* @pkt : le paquet dont on n'a plus besoin
+*
+* @return : /
+*/
+void pkt_slot_release(pkt_slab_t *slab, pkt_t *pkt){
+  char *slot = (char *) pkt;
+  if(slot < slab->slots || slot >= slab->slots + slab->nb_slots * slab->taille_slot){
+    pkt_del(pkt);
+    return;
+  }
+  slab->libres[slab->nb_libres++] = (uint16_t) ((slot - slab->slots) / slab->taille_slot);
+}
+
+
+/*
+* pkt_slab_region : Donne la zone memoire contigue de tous les paquets du
+* slab, pour l'enregistrer aupres du noyau
+*
+* @slab : le slab de paquets
+* @taille : la taille de la zone
+*
+* @return : le debut de la zone
+*/
+void* pkt_slab_region(const pkt_slab_t *slab, size_t *taille){
+  *taille = (size_t) slab->nb_slots * slab->taille_slot;
+  return slab->slots;
+}
+
+
+/* Lot d'envoi : les datagrammes sont encodes directement dans leurs buffers
+ * et partent ensemble par sendmmsg. Un datagramme peut aussi envoyer son
+ * payload depuis la memoire de l'appelant, sans copie. */
+struct tx_batch {
+  int sockfd; // Socket connecte au destinataire
+  int nb; // Nombre de datagrammes en attente
+  int nb_max; // Taille maximale du lot
+  size_t taille; // Taille maximale d'un datagramme
+  int txtime; // 1 si chaque datagramme porte son heure de depart
+  int gso; // 1 si les datagrammes de meme taille partent en trains (UDP_SEGMENT)
+  uint8_t *buffers; // nb_max buffers de taille octets, deux fois avec MSG_ZEROCOPY
+  struct mmsghdr *msgs; // Un message par datagramme, ou par train avec GSO
+  struct iovec *iov; // Morceaux des datagrammes, a la suite : un train en couvre plusieurs
+  int nb_iov; // Nombre de morceaux en attente
+  int *iov_debut; // Premier morceau de chaque datagramme, et fin du dernier
+  size_t *longueur; // Taille de chaque datagramme
+  char *control; // Heure de depart de chaque datagramme (SO_TXTIME) ou taille des segments d'un train
+  int *premier; // Premier datagramme de chaque message
+  int zerocopy; // 1 si les datagrammes partent sans copie (MSG_ZEROCOPY)
+  size_t page; // Taille d'une page memoire, avec MSG_ZEROCOPY
+  int moitie; // Moitie des buffers remplie par le lot en cours, avec MSG_ZEROCOPY
+  uint32_t zc_envoyes; // Nombre de messages envoyes avec MSG_ZEROCOPY
+  uint32_t zc_termines; // Nombre de ces messages dont le noyau a rendu les pages
+  uint32_t zc_fin[2]; // zc_envoyes apres le dernier envoi de chaque moitie
+};
+
+/* Un datagramme envoye sans copie a trois morceaux : header, payload, CRC2 */
+#define TX_BATCH_IOV 3
+
+/* Taille du message de controle portant l'heure de depart d'un datagramme,
+ * qui suffit aussi pour la taille des segments d'un train */
+#define TX_BATCH_CONTROL CMSG_SPACE(sizeof(uint64_t))
+
+/* Un train de datagrammes tient dans un seul datagramme UDP avant que le
+ * noyau ne le decoupe : 64 segments et 64 Ko au plus */
+#define GSO_SEGMENTS_MAX 64
+#define GSO_TAILLE_MAX 65000
+
+/* Envoye sans copie, un message garde ses pages : un train ne peut pas en
+ * toucher plus que de fragments dans un paquet du noyau (MAX_SKB_FRAGS),
+ * sinon sendmmsg le refuse (EMSGSIZE) */
+#define ZEROCOPY_FRAGS_MAX 17
+
+
+/*
+* tx_batch_new : Cree un lot d'envoi vide pour un socket connecte
+*
+* @sockfd : le socket, connecte a son destinataire
+* @nb_max : le nombre de datagrammes au-dela duquel le lot est envoye
+* @taille : la taille maximale d'un datagramme
+* @txtime : 1 si chaque datagramme porte son heure de depart (SO_TXTIME)
+*
+* @return : un nouveau lot ou NULL en cas d'erreur
+*/
+tx_batch_t* tx_batch_new(int sockfd, int nb_max, size_t taille, int txtime){
+  tx_batch_t *b = (tx_batch_t *) calloc(1, sizeof(tx_batch_t));
+  if(b == NULL){
+    fprintf(stderr, "Erreur du malloc");
+    return NULL;
+  }
+  b->sockfd = sockfd;
+  b->nb_max = nb_max;
+  b->taille = taille;
+  b->txtime = txtime;
+  b->buffers = (uint8_t *) malloc(nb_max * taille);
+  b->msgs = (struct mmsghdr *) calloc(nb_max, sizeof(struct mmsghdr));
+  b->iov = (struct iovec *) calloc(nb_max * TX_BATCH_IOV, sizeof(struct iovec));
+  b->iov_debut = (int *) calloc(nb_max + 1, sizeof(int));
+  b->longueur = (size_t *) calloc(nb_max, sizeof(size_t));
+  b->control = (char *) calloc(nb_max, TX_BATCH_CONTROL);
+  b->premier = (int *) calloc(nb_max, sizeof(int));
+  if(b->buffers == NULL || b->msgs == NULL || b->iov == NULL || b->iov_debut == NULL ||
+     b->longueur == NULL || b->control == NULL || b->premier == NULL){
+    fprintf(stderr, "Erreur du malloc");
+    tx_batch_del(b);
+    return NULL;
+  }
+#ifdef UDP_SEGMENT
+  // Le noyau sait decouper un train si l'option existe. Avec SO_TXTIME, tout
+  // le train partirait a l'heure du premier datagramme : pas de GSO.
+  int segment;
+  socklen_t len = sizeof(segment);
+  b->gso = !txtime && getsockopt(sockfd, SOL_UDP, UDP_SEGMENT, &segment, &len) == 0;
+#endif
+  return b;
+}
+
+
+/*
+* tx_batch_del : Libere un lot d'envoi, sans envoyer son contenu
+*
+* @b : le lot d'envoi
+*
+* @return : /
+*/
+void tx_batch_del(tx_batch_t *b){
+  free(b->buffers);
+  free(b->msgs);
+  free(b->iov);
+  free(b->iov_debut);
+  free(b->longueur);
+  free(b->control);
+  free(b->premier);
+  free(b);
+}
+
+
+/*
+* tx_batch_zerocopy : Envoie desormais les datagrammes sans copie
+* (MSG_ZEROCOPY) : le noyau garde leurs pages jusqu'a la fin de l'envoi. Les
+* buffers du lot sont doubles, on remplit l'un pendant que l'autre part. A
+* appeler avant le premier datagramme.
+*
+* @b : le lot d'envoi
+*
+* @return : 0 si le noyau le permet
+*           -1 sinon
+*/
+int tx_batch_zerocopy(tx_batch_t *b){
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+  int un = 1;
+  if(setsockopt(b->sockfd, SOL_SOCKET, SO_ZEROCOPY, &un, sizeof(un)) == -1){
+    return -1;
+  }
+  uint8_t *buffers = (uint8_t *) realloc(b->buffers, 2 * b->nb_max * b->taille);
+  if(buffers == NULL){
+    return -1;
+  }
+  b->buffers = buffers;
+  b->page = (size_t) sysconf(_SC_PAGESIZE);
+  b->zerocopy = 1;
+  return 0;
+#else
+  (void) b;
+  errno = ENOPROTOOPT;
+  return -1;
+#endif
+}
+
+
+/*
+* tx_batch_recolter : Recolte les notifications de fin d'envoi sans copie,
+* dans la file d'erreurs du socket
+*
+* @b : le lot d'envoi
+* @attendre : 1 pour attendre que les pages de la moitie des buffers a
+* remplir soient rendues
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur
+*/
+static int tx_batch_recolter(tx_batch_t *b, int attendre){
+#ifdef MSG_ZEROCOPY
+  char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+  while(1){
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if(recvmsg(b->sockfd, &msg, MSG_ERRQUEUE) == -1){
+      if(errno == EINTR){
+        continue;
+      }
+      if(errno != EAGAIN && errno != EWOULDBLOCK){
+        perror("Erreur recvmsg MSG_ERRQUEUE");
+        return -1;
+      }
+      if(!attendre || (int32_t) (b->zc_termines - b->zc_fin[b->moitie]) >= 0){
+        return 0;
+      }
+      // POLLERR est signale des qu'une notification arrive. Une erreur en
+      // attente sur le socket (ICMP) le signale aussi : on l'efface.
+      struct pollfd pfd;
+      pfd.fd = b->sockfd;
+      pfd.events = 0;
+      if(poll(&pfd, 1, -1) == -1 && errno != EINTR){
+        perror("Erreur poll");
+        return -1;
+      }
+      int err;
+      socklen_t len = sizeof(err);
+      getsockopt(b->sockfd, SOL_SOCKET, SO_ERROR, &err, &len);
+      continue;
+    }
+    struct cmsghdr *cmsg;
+    for(cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+      if(!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+         !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)){
+        continue;
+      }
+      struct sock_extended_err ee;
+      memcpy(&ee, CMSG_DATA(cmsg), sizeof(ee));
+      if(ee.ee_errno != 0 || ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY){
+        continue;
+      }
+      // Les envois numerotes de ee_info a ee_data sont termines
+      b->zc_termines += ee.ee_data - ee.ee_info + 1;
+      // Le noyau a du copier les donnees (interface sans scatter-gather,
+      // boucle locale) : l'envoi sans copie ne fait que couter
+      if((ee.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && b->zerocopy){
+        fprintf(stderr, "MSG_ZEROCOPY : le noyau copie les données, envoi ordinaire\n");
+        b->zerocopy = 0;
+      }
+    }
+  }
+#else
+  (void) b;
+  (void) attendre;
+  return 0;
+#endif
+}
+
+
+/*
+* tx_batch_completions : Recolte les notifications de fin d'envoi sans copie
+* deja arrivees. Le socket est signale en erreur (EPOLLERR) tant qu'il en
+* reste.
+*
+* @b : le lot d'envoi
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur
+*/
+int tx_batch_completions(tx_batch_t *b){
+  return tx_batch_recolter(b, 0);
+}
+
+
+/*
+* tx_batch_buffer : Donne le buffer dans lequel encoder le prochain datagramme
+*
+* @b : le lot d'envoi
+* @len : la taille du buffer
+*
+* @return : le buffer du prochain datagramme
+*/
+uint8_t* tx_batch_buffer(tx_batch_t *b, size_t *len){
+  return tx_batch_buffer_at(b, 0, len);
+}
+
+
+/*
+* tx_batch_buffer_at : Donne le buffer d'un des prochains datagrammes, pour
+* en encoder plusieurs avant de les ajouter au lot dans l'ordre
+*
+* @b : le lot d'envoi
+* @i : le rang du datagramme apres le prochain, moins que tx_batch_place
+* @len : la taille du buffer
+*
+* @return : le buffer du datagramme
+*/
+uint8_t* tx_batch_buffer_at(tx_batch_t *b, int i, size_t *len){
+  *len = b->taille;
+  return b->buffers + (b->moitie * b->nb_max + b->nb + i) * b->taille;
+}
+
+
+/*
+* tx_batch_ajouter : Ajoute au lot le datagramme dont les morceaux viennent
+* d'etre decrits. Le lot est envoye des qu'il est plein.
+*
+* @b : le lot d'envoi
+* @depart : l'heure de depart du datagramme, en microsecondes
+* (CLOCK_MONOTONIC), utilisee seulement avec SO_TXTIME
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur d'envoi
+*/
+static int tx_batch_ajouter(tx_batch_t *b, uint64_t depart){
+  struct msghdr *msg = &b->msgs[b->nb].msg_hdr;
+#ifdef SO_TXTIME
+  if(b->txtime){
+    char *control = b->control + b->nb * TX_BATCH_CONTROL;
+    msg->msg_control = control;
+    msg->msg_controllen = TX_BATCH_CONTROL;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_TXTIME;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+    uint64_t depart_ns = depart * 1000;
+    memcpy(CMSG_DATA(cmsg), &depart_ns, sizeof(depart_ns));
+  }
+#else
+  (void) depart;
+  (void) msg;
+#endif
+  b->nb++;
+  if(b->nb == b->nb_max){
+    return tx_batch_flush(b);
+  }
+  return 0;
+}
+
+
+/*
+* tx_batch_push : Ajoute au lot le datagramme encode dans tx_batch_buffer.
+* Le lot est envoye des qu'il est plein.
+*
+* @b : le lot d'envoi
+* @len : la taille du datagramme
+* @depart : l'heure de depart du datagramme, en microsecondes
+* (CLOCK_MONOTONIC), utilisee seulement avec SO_TXTIME
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur d'envoi
+*/
+int tx_batch_push(tx_batch_t *b, size_t len, uint64_t depart){
+  size_t taille;
+  b->iov_debut[b->nb] = b->nb_iov;
+  b->iov[b->nb_iov].iov_base = tx_batch_buffer(b, &taille);
+  b->iov[b->nb_iov++].iov_len = len;
+  b->longueur[b->nb] = len;
+  return tx_batch_ajouter(b, depart);
+}
+
+
+/*
+* tx_batch_push_sg : Ajoute au lot un datagramme dont le payload n'est pas
+* copie : son header et son CRC2 sont encodes a la suite dans
+* tx_batch_buffer (pkt_encode_sg), le payload est envoye depuis sa place. Il
+* doit y rester jusqu'a la fin de l'envoi. Le lot est envoye des qu'il est
+* plein.
+*
+* @b : le lot d'envoi
+* @len : le nombre d'octets encodes dans tx_batch_buffer
+* @header : la taille du header, avant laquelle s'insere le payload
+* @payload : le payload
+* @len_payload : la taille du payload
+* @depart : l'heure de depart du datagramme, en microsecondes
+* (CLOCK_MONOTONIC), utilisee seulement avec SO_TXTIME
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur d'envoi
+*/
+int tx_batch_push_sg(tx_batch_t *b, size_t len, size_t header, const void *payload, size_t len_payload, uint64_t depart){
+  size_t taille;
+  uint8_t *buf = tx_batch_buffer(b, &taille);
+  b->iov_debut[b->nb] = b->nb_iov;
+  b->iov[b->nb_iov].iov_base = buf;
+  b->iov[b->nb_iov++].iov_len = header;
+  if(len_payload > 0){
+    b->iov[b->nb_iov].iov_base = (void *) payload;
+    b->iov[b->nb_iov++].iov_len = len_payload;
+  }
+  if(len > header){
+    b->iov[b->nb_iov].iov_base = buf + header;
+    b->iov[b->nb_iov++].iov_len = len - header;
+  }
+  b->longueur[b->nb] = len + len_payload;
+  return tx_batch_ajouter(b, depart);
+}
+
+
+/*
+* tx_batch_pages : Compte les pages memoire que touchent les morceaux d'un
+* datagramme du lot
+*
+* @b : le lot d'envoi
+* @i : le datagramme
+*
+* @return : le nombre de pages
+*/
+static int tx_batch_pages(const tx_batch_t *b, int i){
+  int pages = 0;
+  int j;
+  for(j = b->iov_debut[i]; j < b->iov_debut[i + 1]; j++){
+    uintptr_t debut = (uintptr_t) b->iov[j].iov_base;
+    if(b->iov[j].iov_len > 0){
+      pages += (debut + b->iov[j].iov_len - 1) / b->page - debut / b->page + 1;
+    }
+  }
+  return pages;
+}
+
+
+/*
+* tx_batch_trains : Prepare les messages qui envoient les datagrammes du lot a
+* partir de debut. Avec GSO, des datagrammes consecutifs de meme taille (le
+* dernier pouvant etre plus court) forment un train, envoye en un seul
+* message que le noyau decoupe (UDP_SEGMENT). Sinon, chaque datagramme a son
+* message.
+*
+* @b : le lot d'envoi
+* @debut : le premier datagramme a envoyer
+*
+* @return : le nombre de messages, ranges dans b->msgs a partir de debut
+*/
+static int tx_batch_trains(tx_batch_t *b, int debut){
+  int i;
+  b->iov_debut[b->nb] = b->nb_iov;
+  if(!b->gso){
+    for(i = debut; i < b->nb; i++){
+      struct msghdr *msg = &b->msgs[i].msg_hdr;
+      msg->msg_iov = &b->iov[b->iov_debut[i]];
+      msg->msg_iovlen = b->iov_debut[i + 1] - b->iov_debut[i];
+      if(!b->txtime){
+        msg->msg_control = NULL;
+        msg->msg_controllen = 0;
+      }
+      b->premier[i] = i;
+    }
+    return b->nb - debut;
+  }
+
+  // Un train remplace au moins un datagramme : le message d'un train peut
+  // prendre la place de celui de son premier datagramme
+  int t = debut;
+  i = debut;
+  while(i < b->nb){
+    size_t segment = b->longueur[i];
+    size_t total = segment;
+    int pages = b->zerocopy ? tx_batch_pages(b, i) : 0;
+    int fin = i + 1;
+    while(fin < b->nb && fin - i < GSO_SEGMENTS_MAX && b->longueur[fin] <= segment &&
+          total + b->longueur[fin] <= GSO_TAILLE_MAX){
+      if(b->zerocopy){
+        pages += tx_batch_pages(b, fin);
+        if(pages > ZEROCOPY_FRAGS_MAX){
+          break;
+        }
+      }
+      total += b->longueur[fin];
+      fin++;
+      // Seul le dernier segment peut etre plus court
+      if(b->longueur[fin - 1] < segment){
+        break;
+      }
+    }
+    struct msghdr *msg = &b->msgs[t].msg_hdr;
+    msg->msg_iov = &b->iov[b->iov_debut[i]];
+    msg->msg_iovlen = b->iov_debut[fin] - b->iov_debut[i];
+    msg->msg_control = NULL;
+    msg->msg_controllen = 0;
+#ifdef UDP_SEGMENT
+    if(fin - i > 1){
+      msg->msg_control = b->control + t * TX_BATCH_CONTROL;
+      msg->msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+      struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+      cmsg->cmsg_level = SOL_UDP;
+      cmsg->cmsg_type = UDP_SEGMENT;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      uint16_t taille_segment = (uint16_t) segment;
+      memcpy(CMSG_DATA(cmsg), &taille_segment, sizeof(taille_segment));
+    }
+#endif
+    b->premier[t] = i;
+    t++;
+    i = fin;
+  }
+  return t - debut;
+}
+
+
+/*
+* tx_batch_flush : Envoie tous les datagrammes du lot. Un datagramme refuse
+* (destinataire injoignable, trop grand) est perdu, comme sur le reseau.
+*
+* @b : le lot d'envoi
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur d'envoi
+*/
+int tx_batch_flush(tx_batch_t *b){
+  int debut = 0;
+  int nb_msgs = tx_batch_trains(b, debut);
+  int envoyes = 0;
+  while(envoyes < nb_msgs){
+    int zerocopy = b->zerocopy;
+#ifdef MSG_ZEROCOPY
+    int n = sendmmsg(b->sockfd, b->msgs + debut + envoyes, nb_msgs - envoyes, zerocopy ? MSG_ZEROCOPY : 0);
+#else
+    int n = sendmmsg(b->sockfd, b->msgs + debut + envoyes, nb_msgs - envoyes, 0);
+#endif
+    if(n == -1){
+      if(errno == EINTR){
+        continue;
+      }
+      // Trop d'envois sans copie attendent leur notification : on les recolte
+      if(zerocopy && errno == ENOBUFS){
+        if(tx_batch_recolter(b, 0) == -1){
+          b->nb = 0;
+          b->nb_iov = 0;
+          return -1;
+        }
+        continue;
+      }
+      // Le datagramme (ou le train) qui bloque le lot est perdu, on envoie
+      // les suivants
+      if(errno == ECONNREFUSED || errno == EMSGSIZE){
+        envoyes++;
+        continue;
+      }
+      // L'interface ne sait pas decouper les trains : on renonce au GSO et
+      // on reprend au premier datagramme du train refuse
+      if(b->gso && (errno == EIO || errno == EINVAL)){
+        fprintf(stderr, "GSO indisponible, envoi datagramme par datagramme\n");
+        b->gso = 0;
+        debut = b->premier[debut + envoyes];
+        nb_msgs = tx_batch_trains(b, debut);
+        envoyes = 0;
+        continue;
+      }
+      perror("Erreur sendmmsg");
+      b->nb = 0;
+      b->nb_iov = 0;
+      return -1;
+    }
+    if(zerocopy){
+      b->zc_envoyes += n;
+    }
+    envoyes += n;
+  }
+  b->nb = 0;
+  b->nb_iov = 0;
+  // Avec MSG_ZEROCOPY, le noyau lit encore cette moitie des buffers : le lot
+  // suivant remplit l'autre, une fois ses propres envois termines
+  if(b->zc_envoyes != 0){
+    b->zc_fin[b->moitie] = b->zc_envoyes;
+    b->moitie ^= 1;
+    return tx_batch_recolter(b, 1);
+  }
+  return 0;
+}
+
+
+/*
+* tx_batch_pending : Donne le nombre de datagrammes en attente dans le lot
+*
+* @b : le lot d'envoi
+*
+* @return : le nombre de datagrammes pas encore envoyes
+*/
+int tx_batch_pending(const tx_batch_t *b){
+  return b->nb;
+}
+
+
+/*
+* tx_batch_place : Donne le nombre de datagrammes que le lot peut encore
+* recevoir avant d'etre envoye
+*
+* @b : le lot d'envoi
+*
+* @return : le nombre de buffers libres, au moins 1
+*/
+int tx_batch_place(const tx_batch_t *b){
+  return b->nb_max - b->nb;
+}
+
+
+struct rx_batch {
+  int sockfd; // Socket sur lequel on recoit
+  int nb_max; // Nombre de buffers de l'anneau
+  size_t taille; // Taille d'un buffer
+  int gro; // 1 si le noyau peut livrer des trains de datagrammes (UDP_GRO)
+  uint8_t *buffers; // nb_max buffers de taille octets
+  struct mmsghdr *msgs;
+  struct iovec *iov;
+  struct sockaddr_in6 *addrs; // Emetteur de chaque message
+  char *control; // Taille des segments de chaque message recu (UDP_GRO)
+  size_t *segments; // Taille des segments de chaque message, 0 s'il n'est pas un train
+  int nb_recus; // Nombre de messages du dernier rx_batch_recv
+  int courant; // Message dont rx_batch_next donne les datagrammes
+  size_t offset; // Debut du prochain datagramme dans le message courant
+};
+
+/* Taille du message de controle portant la taille des segments d'un train */
+#define RX_BATCH_CONTROL CMSG_SPACE(sizeof(int))
+
+/* Taille d'un buffer qui recoit des trains : un datagramme UDP maximal */
+#define GRO_TAILLE 65535
+
+
+/*
+* rx_batch_new : Cree un anneau de buffers de reception pour un socket
+*
+* @sockfd : le socket sur lequel recevoir
+* @nb_max : le nombre maximal de messages recus par appel systeme
+* @taille : la taille d'un buffer ; un datagramme plus long est coupe
+* @gro : 1 pour demander au noyau des trains de datagrammes (UDP_GRO), s'il
+* le permet ; les buffers font alors GRO_TAILLE octets
+*
+* @return : un nouvel anneau ou NULL en cas d'erreur
+*/
+rx_batch_t* rx_batch_new(int sockfd, int nb_max, size_t taille, int gro){
+  rx_batch_t *b = (rx_batch_t *) calloc(1, sizeof(rx_batch_t));
+  if(b == NULL){
+    fprintf(stderr, "Erreur du malloc");
+    return NULL;
+  }
+#ifdef UDP_GRO
+  int un = 1;
+  if(gro && setsockopt(sockfd, SOL_UDP, UDP_GRO, &un, sizeof(un)) == 0){
+    b->gro = 1;
+    taille = GRO_TAILLE;
+  }
+#else
+  (void) gro;
+#endif
+  b->sockfd = sockfd;
+  b->nb_max = nb_max;
+  b->taille = taille;
+  b->buffers = (uint8_t *) malloc(nb_max * taille);
+  b->msgs = (struct mmsghdr *) calloc(nb_max, sizeof(struct mmsghdr));
+  b->iov = (struct iovec *) calloc(nb_max, sizeof(struct iovec));
+  b->addrs = (struct sockaddr_in6 *) calloc(nb_max, sizeof(struct sockaddr_in6));
+  b->control = (char *) calloc(nb_max, RX_BATCH_CONTROL);
+  b->segments = (size_t *) calloc(nb_max, sizeof(size_t));
+  if(b->buffers == NULL || b->msgs == NULL || b->iov == NULL || b->addrs == NULL ||
+     b->control == NULL || b->segments == NULL){
+    fprintf(stderr, "Erreur du malloc");
+    rx_batch_del(b);
+    return NULL;
+  }
+  int i;
+  for(i = 0; i < nb_max; i++){
+    b->iov[i].iov_base = b->buffers + i * taille;
+    b->iov[i].iov_len = taille;
+    b->msgs[i].msg_hdr.msg_iov = &b->iov[i];
+    b->msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  return b;
+}
+
+
+/*
+* rx_batch_del : Libere un anneau de buffers de reception
+*
+* @b : l'anneau de reception
+*
+* @return : /
+*/
+void rx_batch_del(rx_batch_t *b){
+  free(b->buffers);
+  free(b->msgs);
+  free(b->iov);
+  free(b->addrs);
+  free(b->control);
+  free(b->segments);
+  free(b);
+}
+
+
+/*
+* rx_batch_recv : Recoit d'un coup tous les messages deja arrives, dans la
+* limite de la taille de l'anneau. Sans MSG_DONTWAIT, attend le premier.
+* Leurs datagrammes sont ensuite donnes un par un par rx_batch_next.
+*
+* @b : l'anneau de reception
+* @flags : options de reception supplementaires (MSG_DONTWAIT)
+*
+* @return : le nombre de messages recus
+*           -1 en cas d'erreur (errno est conserve)
+*/
+int rx_batch_recv(rx_batch_t *b, int flags){
+  // recvmmsg ecrit la taille de l'adresse et du controle de chaque message :
+  // on les remet
+  int i;
+  for(i = 0; i < b->nb_max; i++){
+    b->msgs[i].msg_hdr.msg_name = &b->addrs[i];
+    b->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in6);
+    if(b->gro){
+      b->msgs[i].msg_hdr.msg_control = b->control + i * RX_BATCH_CONTROL;
+      b->msgs[i].msg_hdr.msg_controllen = RX_BATCH_CONTROL;
+    }
+  }
+  b->nb_recus = 0;
+  b->courant = 0;
+  b->offset = 0;
+  // MSG_WAITFORONE : on n'attend que le premier message. Avec MSG_TRUNC,
+  // un datagramme trop long donne sa vraie taille et sera rejete au decodage
+  // au lieu d'etre pris pour un paquet complet.
+  int n = recvmmsg(b->sockfd, b->msgs, b->nb_max, MSG_WAITFORONE | MSG_TRUNC | flags, NULL);
+  if(n <= 0){
+    return n;
+  }
+  // Un train porte la taille de ses segments, tous egaux sauf le dernier
+  for(i = 0; i < n; i++){
+    b->segments[i] = 0;
+#ifdef UDP_GRO
+    struct cmsghdr *cmsg;
+    for(cmsg = b->gro ? CMSG_FIRSTHDR(&b->msgs[i].msg_hdr) : NULL; cmsg != NULL;
+        cmsg = CMSG_NXTHDR(&b->msgs[i].msg_hdr, cmsg)){
+      if(cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO){
+        int segment;
+        memcpy(&segment, CMSG_DATA(cmsg), sizeof(segment));
+        b->segments[i] = segment > 0 ? (size_t) segment : 0;
+      }
+    }
+#endif
+  }
+  b->nb_recus = n;
+  return n;
+}
+
+
+/*
+* rx_batch_next : Donne le prochain datagramme du dernier rx_batch_recv, en
+* decoupant les trains
+*
+* @b : l'anneau de reception
+* @len : la vraie taille du datagramme, qui depasse celle du buffer s'il a
+* ete coupe
+*
+* @return : le buffer du datagramme, ou NULL s'il n'en reste plus
+*/
+uint8_t* rx_batch_next(rx_batch_t *b, size_t *len){
+  if(b->courant >= b->nb_recus){
+    return NULL;
+  }
+  int i = b->courant;
+  size_t total = b->msgs[i].msg_len;
+  uint8_t *data = b->buffers + i * b->taille + b->offset;
+  size_t segment = b->segments[i];
+  if(segment == 0 || b->offset + segment >= total){
+    // Dernier (ou seul) datagramme du message
+    *len = total - b->offset;
+    b->courant++;
+    b->offset = 0;
+  }
+  else{
+    *len = segment;
+    b->offset += segment;
+  }
+  return data;
+}
+
+
+/*
+* rx_batch_addr : Donne l'adresse de l'emetteur du dernier datagramme donne
+* par rx_batch_next
+*
+* @b : l'anneau de reception
+* @len : la taille de l'adresse
+*
+* @return : l'adresse de l'emetteur
+*/
+struct sockaddr* rx_batch_addr(rx_batch_t *b, socklen_t *len){
+  // Apres le dernier datagramme d'un message, rx_batch_next est deja passe
+  // au message suivant
+  int i = b->offset > 0 ? b->courant : b->courant - 1;
+  *len = b->msgs[i].msg_hdr.msg_namelen;
+  return (struct sockaddr *) &b->addrs[i];
+}
+
+
+/* Sources de la boucle d'evenements qui ne sont pas des descripteurs ajoutes */
+#define EVENT_SOURCE_TIMER EVENT_LOOP_MAX_FD
+#define EVENT_SOURCE_SIGNAL (EVENT_LOOP_MAX_FD + 1)
+
+struct event_loop {
+  int epfd; // Instance epoll
+  int timerfd; // Echeance de la boucle
+  int signalfd; // SIGINT et SIGTERM
+  sigset_t signaux; // Signaux bloques et recus par signalfd
+  uint64_t echeance; // Echeance armee (us, CLOCK_MONOTONIC), 0 si aucune
+  void *ctx; // Contexte passe aux callbacks
+  event_cb_t avant_attente;
+  event_cb_t echeance_cb;
+  int nb_fd; // Nombre de descripteurs ajoutes
+  event_cb_t lisible[EVENT_LOOP_MAX_FD]; // Callback de chaque descripteur ajoute
+};
+
+
+/*
+* event_loop_new : Cree une boucle d'evenements. SIGINT et SIGTERM sont
+* bloques et recus par la boucle, qui s'arrete alors en erreur.
+*
+* @ctx : le contexte passe a tous les callbacks
+* @avant_attente : appele avant chaque attente, pour faire le travail pret
+* et armer l'echeance suivante avec event_loop_timer
+* @echeance : appele quand l'echeance armee expire
+*
+* @return : une nouvelle boucle ou NULL en cas d'erreur
+*/
+event_loop_t* event_loop_new(void *ctx, event_cb_t avant_attente, event_cb_t echeance){
+  event_loop_t *l = (event_loop_t *) calloc(1, sizeof(event_loop_t));
+  if(l == NULL){
+    fprintf(stderr, "Erreur du malloc");
+    return NULL;
+  }
+  l->ctx = ctx;
+  l->avant_attente = avant_attente;
+  l->echeance_cb = echeance;
+  sigemptyset(&l->signaux);
+  sigaddset(&l->signaux, SIGINT);
+  sigaddset(&l->signaux, SIGTERM);
+  sigprocmask(SIG_BLOCK, &l->signaux, NULL);
+
+  l->epfd = epoll_create1(EPOLL_CLOEXEC);
+  l->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  l->signalfd = signalfd(-1, &l->signaux, SFD_NONBLOCK | SFD_CLOEXEC);
+  if(l->epfd == -1 || l->timerfd == -1 || l->signalfd == -1){
+    perror("Erreur de création de la boucle d'événements");
+    event_loop_del(l);
+    return NULL;
+  }
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.u32 = EVENT_SOURCE_TIMER;
+  int err = epoll_ctl(l->epfd, EPOLL_CTL_ADD, l->timerfd, &ev);
+  ev.data.u32 = EVENT_SOURCE_SIGNAL;
+  if(err == -1 || epoll_ctl(l->epfd, EPOLL_CTL_ADD, l->signalfd, &ev) == -1){
+    perror("Erreur epoll_ctl");
+    event_loop_del(l);
+    return NULL;
+  }
+  return l;
+}
+
+
+/*
+* event_loop_del : Libere une boucle d'evenements et debloque les signaux
+*
+* @l : la boucle d'evenements
+*
+* @return : /
+*/
+void event_loop_del(event_loop_t *l){
+  if(l->epfd != -1){
+    close(l->epfd);
+  }
+  if(l->timerfd != -1){
+    close(l->timerfd);
+  }
+  if(l->signalfd != -1){
+    close(l->signalfd);
+  }
+  sigprocmask(SIG_UNBLOCK, &l->signaux, NULL);
+  free(l);
+}
+
+
+/*
+* event_loop_add : Surveille un descripteur en lecture
+*
+* @l : la boucle d'evenements
+* @fd : le descripteur
+* @front : 1 pour n'etre prevenu que quand le descripteur redevient lisible
+* (EPOLLET), 0 tant qu'il reste lisible
+* @lisible : appele quand le descripteur est lisible
+*
+* @return : 0 si le descripteur est surveille
+*           -1 en cas d'erreur (EPERM : fichier regulier, toujours lisible)
+*/
+int event_loop_add(event_loop_t *l, int fd, int front, event_cb_t lisible){
+  if(l->nb_fd == EVENT_LOOP_MAX_FD){
+    errno = ENOSPC;
+    return -1;
+  }
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | (front ? EPOLLET : 0);
+  ev.data.u32 = l->nb_fd;
+  if(epoll_ctl(l->epfd, EPOLL_CTL_ADD, fd, &ev) == -1){
+    return -1;
+  }
+  l->lisible[l->nb_fd++] = lisible;
+  return 0;
+}
+
+
+/*
+* event_loop_timer : Arme l'echeance de la boucle. Une echeance deja armee
+* plus tot est gardee : le callback d'echeance doit accepter un reveil
+* anticipe.
+*
+* @l : la boucle d'evenements
+* @timeout_us : le temps avant l'echeance en microsecondes, ou -1 s'il n'y
+* en a aucune
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur
+*/
+int event_loop_timer(event_loop_t *l, int64_t timeout_us){
+  if(timeout_us < 0){
+    return 0;
+  }
+  // Les echeances reculent le plus souvent (pacing, RTO relances) : garder
+  // la plus proche evite un appel systeme par tour de boucle
+  uint64_t echeance = time_now_us() + timeout_us;
+  if(l->echeance != 0 && l->echeance <= echeance){
+    return 0;
+  }
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = echeance / 1000000;
+  its.it_value.tv_nsec = (echeance % 1000000) * 1000;
+  if(timerfd_settime(l->timerfd, TFD_TIMER_ABSTIME, &its, NULL) == -1){
+    perror("Erreur timerfd_settime");
+    return -1;
+  }
+  l->echeance = echeance;
+  return 0;
+}
+
+
+/*
+* event_loop_run : Fait tourner la boucle jusqu'a ce qu'un callback
+* l'arrete, qu'une erreur survienne ou qu'un signal soit recu
+*
+* @l : la boucle d'evenements
+*
+* @return : 0 si un callback a arrete la boucle
+*           -1 en cas d'erreur ou de signal
+*/
+int event_loop_run(event_loop_t *l){
+  struct epoll_event evs[EVENT_LOOP_MAX_FD + 2];
+  while(1){
+    int ret = l->avant_attente(l->ctx);
+    if(ret != 0){
+      return ret == 1 ? 0 : -1;
+    }
+
+    int n = epoll_wait(l->epfd, evs, EVENT_LOOP_MAX_FD + 2, -1);
+    if(n == -1){
+      if(errno == EINTR){
+        continue;
+      }
+      perror("Erreur epoll_wait");
+      return -1;
+    }
+
+    int i;
+    for(i = 0; i < n; i++){
+      uint32_t source = evs[i].data.u32;
+      if(source == EVENT_SOURCE_SIGNAL){
+        struct signalfd_siginfo info;
+        if(read(l->signalfd, &info, sizeof(info)) == sizeof(info)){
+          fprintf(stderr, "Interrompu par le signal %u\n", info.ssi_signo);
+        }
+        return -1;
+      }
+      if(source == EVENT_SOURCE_TIMER){
+        // L'echeance a pu etre reculee depuis son expiration : rien a lire
+        uint64_t expirations;
+        if(read(l->timerfd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN){
+          perror("Erreur read timerfd");
+          return -1;
+        }
+        l->echeance = 0;
+        ret = l->echeance_cb(l->ctx);
+      }
+      else{
+        ret = l->lisible[source](l->ctx);
+      }
+      if(ret != 0){
+        return ret == 1 ? 0 : -1;
+      }
+    }
+  }
+}
+
+
+#ifdef HAVE_LIBURING
+
+/* Anneau io_uring : les operations preparees partent ensemble a la
+ * soumission, et leurs fins sont recoltees sans appel systeme */
+struct io_ring {
+  struct io_uring ring;
+  char *region; // Zone enregistree (buffer fixe 0), NULL si aucune
+  size_t taille_region;
+  unsigned en_vol; // Operations preparees pas encore recoltees
+};
+
+
+/*
+* io_ring_new : Cree un anneau io_uring. Une operation dont le buffer est
+* dans la region enregistree evite au noyau de re-mapper ses pages.
+*
+* @profondeur : le nombre d'operations preparees avant une soumission
+* @region : la zone a enregistrer (le slab de paquets), ou NULL
+* @taille : la taille de la zone
+*
+* @return : un nouvel anneau, ou NULL si io_uring n'est pas disponible
+*/
+io_ring_t* io_ring_new(unsigned profondeur, void *region, size_t taille){
+  io_ring_t *r = (io_ring_t *) calloc(1, sizeof(io_ring_t));
+  if(r == NULL){
+    return NULL;
+  }
+  int err = io_uring_queue_init(profondeur, &r->ring, 0);
+  if(err < 0){
+    free(r);
+    errno = -err;
+    return NULL;
+  }
+  // Sans enregistrement (limite de memoire verrouillee), les operations
+  // passent par des buffers ordinaires
+  if(region != NULL){
+    struct iovec iov;
+    iov.iov_base = region;
+    iov.iov_len = taille;
+    if(io_uring_register_buffers(&r->ring, &iov, 1) == 0){
+      r->region = (char *) region;
+      r->taille_region = taille;
+    }
+  }
+  return r;
+}
+
+
+/*
+* io_ring_del : Libere un anneau. Les operations doivent etre terminees.
+*
+* @r : l'anneau
+*
+* @return : /
+*/
+void io_ring_del(io_ring_t *r){
+  io_uring_queue_exit(&r->ring);
+  free(r);
+}
+
+
+/*
+* io_ring_fd : Donne le descripteur de l'anneau, lisible (epoll) quand des
+* operations sont terminees
+*
+* @r : l'anneau
+*
+* @return : le descripteur
+*/
+int io_ring_fd(const io_ring_t *r){
+  return r->ring.ring_fd;
+}
+
+
+/*
+* io_ring_en_vol : Donne le nombre d'operations preparees pas encore
+* recoltees
+*
+* @r : l'anneau
+*
+* @return : le nombre d'operations
+*/
+unsigned io_ring_en_vol(const io_ring_t *r){
+  return r->en_vol;
+}
+
+
+/*
+* io_ring_sqe : Donne une entree libre de la file de soumission, en
+* soumettant les operations deja preparees si elle est pleine
+*
+* @r : l'anneau
+* @buf : le buffer de l'operation
+* @len : sa taille
+* @fixe : mis a 1 si le buffer est dans la region enregistree
+*
+* @return : l'entree, ou NULL en cas d'erreur
+*/
+static struct io_uring_sqe* io_ring_sqe(io_ring_t *r, const void *buf, unsigned len, int *fixe){
+  struct io_uring_sqe *sqe = io_uring_get_sqe(&r->ring);
+  if(sqe == NULL){
+    if(io_ring_submit(r) == -1){
+      return NULL;
+    }
+    sqe = io_uring_get_sqe(&r->ring);
+    if(sqe == NULL){
+      errno = EBUSY;
+      return NULL;
+    }
+  }
+  const char *debut = (const char *) buf;
+  *fixe = r->region != NULL && debut >= r->region && debut + len <= r->region + r->taille_region;
+  r->en_vol++;
+  return sqe;
+}
+
+
+/*
+* io_ring_read : Prepare la lecture d'un fichier a une position donnee.
+* Elle part a la prochaine soumission.
+*
+* @r : l'anneau
+* @fd : le fichier
+* @buf : la destination
+* @len : le nombre d'octets a lire
+* @offset : la position dans le fichier
+* @tag : rendu au callback a la fin de la lecture
+*
+* @return : 0 si la lecture est preparee
+*           -1 en cas d'erreur
+*/
+int io_ring_read(io_ring_t *r, int fd, void *buf, unsigned len, uint64_t offset, void *tag){
+  int fixe;
+  struct io_uring_sqe *sqe = io_ring_sqe(r, buf, len, &fixe);
+  if(sqe == NULL){
+    return -1;
+  }
+  if(fixe){
+    io_uring_prep_read_fixed(sqe, fd, buf, len, offset, 0);
+  }
+  else{
+    io_uring_prep_read(sqe, fd, buf, len, offset);
+  }
+  io_uring_sqe_set_data(sqe, tag);
+  return 0;
+}
+
+
+/*
+* io_ring_write : Prepare l'ecriture d'un fichier a une position donnee.
+* Elle part a la prochaine soumission.
+*
+* @r : l'anneau
+* @fd : le fichier
+* @buf : les donnees, a garder intactes jusqu'a la fin de l'ecriture
+* @len : le nombre d'octets a ecrire
+* @offset : la position dans le fichier
+* @tag : rendu au callback a la fin de l'ecriture
+*
+* @return : 0 si l'ecriture est preparee
+*           -1 en cas d'erreur
+*/
+int io_ring_write(io_ring_t *r, int fd, const void *buf, unsigned len, uint64_t offset, void *tag){
+  int fixe;
+  struct io_uring_sqe *sqe = io_ring_sqe(r, buf, len, &fixe);
+  if(sqe == NULL){
+    return -1;
+  }
+  if(fixe){
+    io_uring_prep_write_fixed(sqe, fd, buf, len, offset, 0);
+  }
+  else{
+    io_uring_prep_write(sqe, fd, buf, len, offset);
+  }
+  io_uring_sqe_set_data(sqe, tag);
+  return 0;
+}
+
+
+/*
+* io_ring_writev : Prepare l'ecriture de plusieurs buffers a la suite
+* dans un fichier, a partir d'une position donnee. Elle part a la
+* prochaine soumission.
+*
+* @r : l'anneau
+* @fd : le fichier
+* @iov : les buffers, a garder intacts (comme le tableau) jusqu'a la fin
+* de l'ecriture
+* @nb : le nombre de buffers
+* @offset : la position dans le fichier
+* @tag : rendu au callback a la fin de l'ecriture
+*
+* @return : 0 si l'ecriture est preparee
+*           -1 en cas d'erreur
+*/
+int io_ring_writev(io_ring_t *r, int fd, const struct iovec *iov, int nb, uint64_t offset, void *tag){
+  int fixe;
+  struct io_uring_sqe *sqe = io_ring_sqe(r, NULL, 0, &fixe);
+  if(sqe == NULL){
+    return -1;
+  }
+  io_uring_prep_writev(sqe, fd, iov, nb, offset);
+  io_uring_sqe_set_data(sqe, tag);
+  return 0;
+}
+
+
+/*
+* io_ring_submit : Soumet au noyau, en un appel systeme, toutes les
+* operations preparees
+*
+* @r : l'anneau
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur
+*/
+int io_ring_submit(io_ring_t *r){
+  int err;
+  do{
+    err = io_uring_submit(&r->ring);
+  } while(err == -EINTR);
+  if(err < 0){
+    errno = -err;
+    perror("Erreur io_uring_submit");
+    return -1;
+  }
+  return 0;
+}
+
+
+/*
+* io_ring_reap : Recolte les operations terminees et appelle le callback
+* pour chacune
+*
+* @r : l'anneau
+* @cb : le callback de fin d'operation
+* @ctx : le contexte passe au callback
+* @attendre : 1 pour soumettre et attendre qu'au moins une operation se
+* termine s'il en reste en vol
+*
+* @return : le nombre d'operations recoltees
+*           -1 en cas d'erreur ou si un callback a renvoye -1
+*/
+int io_ring_reap(io_ring_t *r, io_cb_t cb, void *ctx, int attendre){
+  if(attendre && io_ring_submit(r) == -1){
+    return -1;
+  }
+  int n = 0;
+  while(r->en_vol > 0){
+    struct io_uring_cqe *cqe = NULL;
+    int err = attendre && n == 0 ? io_uring_wait_cqe(&r->ring, &cqe) : io_uring_peek_cqe(&r->ring, &cqe);
+    if(err == -EAGAIN){
+      break;
+    }
+    if(err == -EINTR){
+      continue;
+    }
+    if(err < 0){
+      errno = -err;
+      perror("Erreur io_uring_wait_cqe");
+      return -1;
+    }
+    void *tag = io_uring_cqe_get_data(cqe);
+    int res = cqe->res;
+    io_uring_cqe_seen(&r->ring, cqe);
+    r->en_vol--;
+    n++;
+    if(cb(ctx, tag, res) == -1){
+      return -1;
+    }
+  }
+  return n;
+}
+
+#else
+
+/* Sans liburing, aucun anneau n'est cree : les appelants gardent leurs
+ * appels systeme read et write */
+io_ring_t* io_ring_new(unsigned profondeur, void *region, size_t taille){
+  (void) profondeur;
+  (void) region;
+  (void) taille;
+  errno = ENOSYS;
+  return NULL;
+}
+
+void io_ring_del(io_ring_t *r){
+  (void) r;
+}
+
+int io_ring_fd(const io_ring_t *r){
+  (void) r;
+  return -1;
+}
+
+unsigned io_ring_en_vol(const io_ring_t *r){
+  (void) r;
+  return 0;
+}
+
+int io_ring_read(io_ring_t *r, int fd, void *buf, unsigned len, uint64_t offset, void *tag){
+  (void) r; (void) fd; (void) buf; (void) len; (void) offset; (void) tag;
+  errno = ENOSYS;
+  return -1;
+}
+
+int io_ring_write(io_ring_t *r, int fd, const void *buf, unsigned len, uint64_t offset, void *tag){
+  (void) r; (void) fd; (void) buf; (void) len; (void) offset; (void) tag;
+  errno = ENOSYS;
+  return -1;
+}
+
+int io_ring_writev(io_ring_t *r, int fd, const struct iovec *iov, int nb, uint64_t offset, void *tag){
+  (void) r; (void) fd; (void) iov; (void) nb; (void) offset; (void) tag;
+  errno = ENOSYS;
+  return -1;
+}
+
+int io_ring_submit(io_ring_t *r){
+  (void) r;
+  errno = ENOSYS;
+  return -1;
+}
+
+int io_ring_reap(io_ring_t *r, io_cb_t cb, void *ctx, int attendre){
+  (void) r; (void) cb; (void) ctx; (void) attendre;
+  errno = ENOSYS;
+  return -1;
+}
+
+#endif
+
+
+/* Polynomes reflechis des CRC : IEEE 802.3 (celui de zlib) et Castagnoli */
+#define CRC32_POLY 0xEDB88320
+#define CRC32C_POLY 0x82F63B78
+
+/* Tables du slicing-by-8 : t[k][i] est le CRC de l'octet i suivi de k zeros */
+static uint32_t crc32_tables[8][256];
+static uint32_t crc32c_tables[8][256];
+
+static uint32_t crc32_choisir(uint32_t crc, const void *buf, size_t len);
+static uint32_t crc32c_choisir(uint32_t crc, const void *buf, size_t len);
+
+/* Moteurs retenus par crc_init, choisis au premier appel sinon */
+static crc_fn_t crc32_moteur = crc32_choisir;
+static crc_fn_t crc32c_moteur = crc32c_choisir;
+static const char *crc32_nom = NULL;
+static const char *crc32c_nom = NULL;
+
+/* Moteurs qui copient les donnees en calculant leur CRC */
+typedef uint32_t (*crc_copie_fn_t)(uint32_t crc, void *dst, const void *src, size_t len);
+static uint32_t crc32_copier_logiciel(uint32_t crc, void *dst, const void *src, size_t len);
+static uint32_t crc32c_copier_logiciel(uint32_t crc, void *dst, const void *src, size_t len);
+static crc_copie_fn_t crc32_copie_moteur = crc32_copier_logiciel;
+static crc_copie_fn_t crc32c_copie_moteur = crc32c_copier_logiciel;
+
+/* Noyaux multi-buffer CRC32C : crcs contient les CRC courants, puis les
+ * resultats. Si dsts n'est pas NULL, chaque buffer y est aussi copie. */
+typedef void (*crc_multi_fn_t)(const uint8_t **bufs, uint8_t **dsts, const size_t *lens, uint32_t *crcs, int n);
+static void crc32c_multi_logiciel(const uint8_t **bufs, uint8_t **dsts, const size_t *lens, uint32_t *crcs, int n);
+static crc_multi_fn_t crc32c_multi_moteur = crc32c_multi_logiciel;
+static int crc32c_entrelace = 0;
+
+
+/*
+* crc_tables : Remplit les tables du slicing-by-8 d'un polynome
+*
+* @t : les tables
+* @poly : le polynome reflechi
+*
+* @return : /
+*/
+static void crc_tables(uint32_t t[8][256], uint32_t poly){
+  uint32_t i;
+  int k;
+  for(i = 0; i < 256; i++){
+    uint32_t c = i;
+    for(k = 0; k < 8; k++){
+      c = c & 1 ? (c >> 1) ^ poly : c >> 1;
+    }
+    t[0][i] = c;
+  }
+  for(i = 0; i < 256; i++){
+    for(k = 1; k < 8; k++){
+      t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+    }
+  }
+}
+
+
+/*
+* crc_slicing8 : Calcule un CRC reflechi huit octets a la fois, avec une
+* table par octet du mot lu, en copiant eventuellement les donnees
+*
+* @t : les tables du polynome
+* @crc : le CRC des donnees precedentes (0 au depart)
+* @dst : ou copier les donnees au passage, NULL pour ne pas les copier
+* @p : les donnees
+* @len : leur taille
+*
+* @return : le CRC des donnees precedentes suivies de p
+*/
+static uint32_t crc_slicing8(uint32_t t[8][256], uint32_t crc, uint8_t *dst, const uint8_t *p, size_t len){
+  crc = ~crc;
+  while(len > 0 && ((uintptr_t) p & 7) != 0){
+    if(dst != NULL){
+      *dst++ = *p;
+    }
+    crc = t[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    len--;
+  }
+  while(len >= 8){
+    uint32_t un, deux;
+    memcpy(&un, p, 4);
+    memcpy(&deux, p + 4, 4);
+    if(dst != NULL){
+      memcpy(dst, &un, 4);
+      memcpy(dst + 4, &deux, 4);
+      dst += 8;
+    }
+    un = le32toh(un) ^ crc;
+    deux = le32toh(deux);
+    crc = t[7][un & 0xff] ^ t[6][(un >> 8) & 0xff] ^ t[5][(un >> 16) & 0xff] ^ t[4][un >> 24] ^
+          t[3][deux & 0xff] ^ t[2][(deux >> 8) & 0xff] ^ t[1][(deux >> 16) & 0xff] ^ t[0][deux >> 24];
+    p += 8;
+    len -= 8;
+  }
+  while(len > 0){
+    if(dst != NULL){
+      *dst++ = *p;
+    }
+    crc = t[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    len--;
+  }
+  return ~crc;
+}
+
+
+/*
+* crc32_logiciel, crc32c_logiciel : Moteurs portables, par slicing-by-8
+*/
+static uint32_t crc32_logiciel(uint32_t crc, const void *buf, size_t len){
+  return crc_slicing8(crc32_tables, crc, NULL, (const uint8_t *) buf, len);
+}
+
+
+static uint32_t crc32c_logiciel(uint32_t crc, const void *buf, size_t len){
+  return crc_slicing8(crc32c_tables, crc, NULL, (const uint8_t *) buf, len);
+}
+
+
+static uint32_t crc32_copier_logiciel(uint32_t crc, void *dst, const void *src, size_t len){
+  return crc_slicing8(crc32_tables, crc, (uint8_t *) dst, (const uint8_t *) src, len);
+}
+
+
+static uint32_t crc32c_copier_logiciel(uint32_t crc, void *dst, const void *src, size_t len){
+  return crc_slicing8(crc32c_tables, crc, (uint8_t *) dst, (const uint8_t *) src, len);
+}
+
+
+/*
+* crc32c_multi_logiciel : Noyau multi-buffer CRC32C sans instruction
+* particuliere, un buffer apres l'autre
+*/
+static void crc32c_multi_logiciel(const uint8_t **bufs, uint8_t **dsts, const size_t *lens, uint32_t *crcs, int n){
+  int i;
+  for(i = 0; i < n; i++){
+    crcs[i] = crc_slicing8(crc32c_tables, crcs[i], dsts != NULL ? dsts[i] : NULL, bufs[i], lens[i]);
+  }
+}
+
+
+#if defined(__x86_64__)
+
+/* Constantes du repliement du polynome IEEE d'apres "Fast CRC Computation
+ * for Generic Polynomials Using PCLMULQDQ" (Intel) : k1, k2 replient un bloc
+ * sur celui situe 64 octets plus loin, k3, k4 sur le suivant, k5 ramene 64
+ * bits a 32, et P et u servent a la reduction de Barrett */
+#define CRC32_K1K2 _mm_set_epi64x(0x01c6e41596, 0x0154442bd4)
+#define CRC32_K3K4 _mm_set_epi64x(0x00ccaa009e, 0x01751997d0)
+#define CRC32_K5 _mm_set_epi64x(0, 0x0163cd6124)
+#define CRC32_PU _mm_set_epi64x(0x01f7011641, 0x01db710641)
+
+/* Nombre de flux calcules ensemble par le noyau multi-buffer CRC32C : une
+ * instruction crc32 a une latence de 3 cycles mais en demarre une par cycle */
+#define CRC_FLUX 4
+
+
+/*
+* crc32_replier : Replie un bloc de 128 bits sur le bloc de donnees suivant
+*
+* @x : le bloc courant
+* @suivant : les 16 octets suivants
+*
+* @return : le nouveau bloc courant
+*/
+__attribute__((target("pclmul,sse4.1")))
+static inline __m128i crc32_replier(__m128i x, __m128i suivant){
+  __m128i bas = _mm_clmulepi64_si128(x, CRC32_K3K4, 0x00);
+  x = _mm_clmulepi64_si128(x, CRC32_K3K4, 0x11);
+  return _mm_xor_si128(_mm_xor_si128(x, suivant), bas);
+}
+
+
+/*
+* crc32_reduire64 : Ramene un bloc de 64 bits (moitie haute nulle) au CRC,
+* en un repliement puis une reduction de Barrett
+*
+* @x1 : le bloc, CRC courant deja combine
+*
+* @return : le CRC, sans inversion
+*/
+__attribute__((target("pclmul,sse4.1")))
+static inline uint32_t crc32_reduire64(__m128i x1){
+  const __m128i masque = _mm_setr_epi32(~0, 0, ~0, 0);
+
+  // 64 bits ramenes a 32
+  __m128i x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, masque);
+  x1 = _mm_clmulepi64_si128(x1, CRC32_K5, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  // Reduction de Barrett a 32 bits
+  x2 = _mm_and_si128(x1, masque);
+  x2 = _mm_clmulepi64_si128(x2, CRC32_PU, 0x10);
+  x2 = _mm_and_si128(x2, masque);
+  x2 = _mm_clmulepi64_si128(x2, CRC32_PU, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  return (uint32_t) _mm_extract_epi32(x1, 1);
+}
+
+
+/*
+* crc32_reduire : Ramene le dernier bloc de 128 bits au CRC, en deux
+* repliements puis une reduction de Barrett
+*
+* @x1 : le bloc, CRC courant deja combine
+*
+* @return : le CRC, sans inversion
+*/
+__attribute__((target("pclmul,sse4.1")))
+static inline uint32_t crc32_reduire(__m128i x1){
+  // 128 bits ramenes a 64
+  __m128i x2 = _mm_clmulepi64_si128(x1, CRC32_K3K4, 0x10);
+  return crc32_reduire64(_mm_xor_si128(_mm_srli_si128(x1, 8), x2));
+}
+
+
+/*
+* crc32_huit : CRC32 (IEEE) de 8 octets, un header TRTP : ils forment la
+* seconde moitie d'un bloc dont la premiere, nulle, ne change pas le CRC,
+* d'ou un repliement de moins
+*
+* @p : les 8 octets
+* @crc : le CRC courant, sans inversion
+*
+* @return : le CRC courant apres les 8 octets, sans inversion
+*/
+__attribute__((target("pclmul,sse4.1")))
+static inline uint32_t crc32_huit(const uint8_t *p, uint32_t crc){
+  __m128i x = _mm_xor_si128(_mm_loadl_epi64((const __m128i *) p), _mm_cvtsi32_si128((int) crc));
+  return crc32_reduire64(x);
+}
+
+
+/*
+* crc32_plier : Calcule le CRC32 (IEEE) d'au moins 64 octets, multiple de 16,
+* par multiplications sans retenue (PCLMULQDQ) : quatre blocs de 128 bits
+* sont replies en parallele sur les suivants, puis en un seul. Les blocs
+* lus sont ecrits dans dst au passage si dst n'est pas NULL.
+*
+* @dst : ou copier les donnees, ou NULL
+* @p : les donnees
+* @len : leur taille
+* @crc : le CRC courant, sans inversion
+*
+* @return : le CRC courant apres les donnees, sans inversion
+*/
+__attribute__((target("pclmul,sse4.1")))
+static inline __attribute__((always_inline)) uint32_t crc32_plier(uint8_t *dst, const uint8_t *p, size_t len, uint32_t crc){
+  const __m128i k1k2 = CRC32_K1K2;
+
+  __m128i x1 = _mm_loadu_si128((const __m128i *) (p + 0x00));
+  __m128i x2 = _mm_loadu_si128((const __m128i *) (p + 0x10));
+  __m128i x3 = _mm_loadu_si128((const __m128i *) (p + 0x20));
+  __m128i x4 = _mm_loadu_si128((const __m128i *) (p + 0x30));
+  if(dst != NULL){
+    _mm_storeu_si128((__m128i *) (dst + 0x00), x1);
+    _mm_storeu_si128((__m128i *) (dst + 0x10), x2);
+    _mm_storeu_si128((__m128i *) (dst + 0x20), x3);
+    _mm_storeu_si128((__m128i *) (dst + 0x30), x4);
+    dst += 64;
+  }
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+  p += 64;
+  len -= 64;
+
+  // Quatre blocs replies en parallele sur les 64 octets suivants
+  while(len >= 64){
+    __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+    __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+    __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+    __m128i y1 = _mm_loadu_si128((const __m128i *) (p + 0x00));
+    __m128i y2 = _mm_loadu_si128((const __m128i *) (p + 0x10));
+    __m128i y3 = _mm_loadu_si128((const __m128i *) (p + 0x20));
+    __m128i y4 = _mm_loadu_si128((const __m128i *) (p + 0x30));
+    if(dst != NULL){
+      _mm_storeu_si128((__m128i *) (dst + 0x00), y1);
+      _mm_storeu_si128((__m128i *) (dst + 0x10), y2);
+      _mm_storeu_si128((__m128i *) (dst + 0x20), y3);
+      _mm_storeu_si128((__m128i *) (dst + 0x30), y4);
+      dst += 64;
+    }
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y1);
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y2);
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y3);
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y4);
+    p += 64;
+    len -= 64;
+  }
+
+  // Les quatre blocs replies en un seul, puis les blocs de 16 octets restants
+  x1 = crc32_replier(x1, x2);
+  x1 = crc32_replier(x1, x3);
+  x1 = crc32_replier(x1, x4);
+  while(len >= 16){
+    __m128i y = _mm_loadu_si128((const __m128i *) p);
+    if(dst != NULL){
+      _mm_storeu_si128((__m128i *) dst, y);
+      dst += 16;
+    }
+    x1 = crc32_replier(x1, y);
+    p += 16;
+    len -= 16;
+  }
+  return crc32_reduire(x1);
+}
+
+
+/*
+* crc32_pclmul_copier : CRC32 (IEEE) par PCLMULQDQ, le reste de moins de
+* 16 octets (et les petits buffers autres qu'un header) par slicing-by-8,
+* en copiant les donnees dans dst si dst n'est pas NULL
+*/
+__attribute__((target("pclmul,sse4.1")))
+static inline __attribute__((always_inline)) uint32_t crc32_pclmul_copier(uint32_t crc, uint8_t *dst, const uint8_t *p, size_t len){
+  if(len == 8){
+    if(dst != NULL){
+      memcpy(dst, p, 8);
+    }
+    return ~crc32_huit(p, ~crc);
+  }
+  if(len >= 64){
+    size_t bloc = len & ~(size_t) 15;
+    crc = ~crc32_plier(dst, p, bloc, ~crc);
+    p += bloc;
+    len -= bloc;
+    if(dst != NULL){
+      dst += bloc;
+    }
+  }
+  return crc_slicing8(crc32_tables, crc, dst, p, len);
+}
+
+
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul(uint32_t crc, const void *buf, size_t len){
+  return crc32_pclmul_copier(crc, NULL, (const uint8_t *) buf, len);
+}
+
+
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_copier_pclmul(uint32_t crc, void *dst, const void *src, size_t len){
+  return crc32_pclmul_copier(crc, (uint8_t *) dst, (const uint8_t *) src, len);
+}
+
+
+/*
+* crc32c_sse42_copier : CRC32C par l'instruction crc32 de SSE4.2, huit
+* octets a la fois, en copiant les donnees dans dst si dst n'est pas NULL
+*/
+__attribute__((target("sse4.2")))
+static inline __attribute__((always_inline)) uint32_t crc32c_sse42_copier(uint32_t crc, uint8_t *dst, const uint8_t *p, size_t len){
+  uint64_t c = ~crc;
+  while(len > 0 && ((uintptr_t) p & 7) != 0){
+    if(dst != NULL){
+      *dst++ = *p;
+    }
+    c = _mm_crc32_u8((uint32_t) c, *p++);
+    len--;
+  }
+  while(len >= 8){
+    uint64_t mot;
+    memcpy(&mot, p, 8);
+    if(dst != NULL){
+      memcpy(dst, &mot, 8);
+      dst += 8;
+    }
+    c = _mm_crc32_u64(c, mot);
+    p += 8;
+    len -= 8;
+  }
+  while(len > 0){
+    if(dst != NULL){
+      *dst++ = *p;
+    }
+    c = _mm_crc32_u8((uint32_t) c, *p++);
+    len--;
+  }
+  return ~(uint32_t) c;
+}
+
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const void *buf, size_t len){
+  return crc32c_sse42_copier(crc, NULL, (const uint8_t *) buf, len);
+}
+
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_copier_sse42(uint32_t crc, void *dst, const void *src, size_t len){
+  return crc32c_sse42_copier(crc, (uint8_t *) dst, (const uint8_t *) src, len);
+}
+
+
+/*
+* crc32c_multi_sse42 : CRC32C de plusieurs buffers, CRC_FLUX a la fois :
+* l'instruction crc32 d'un flux s'execute pendant que celles des autres
+* attendent leur resultat. Le reste de chaque flux est calcule seul. Les
+* mots lus sont copies dans dsts au passage si dsts n'est pas NULL.
+*/
+__attribute__((target("sse4.2")))
+static void crc32c_multi_sse42(const uint8_t **bufs, uint8_t **dsts, const size_t *lens, uint32_t *crcs, int n){
+  int i = 0;
+  for(; i + CRC_FLUX <= n; i += CRC_FLUX){
+    size_t commun = lens[i];
+    int f;
+    for(f = 1; f < CRC_FLUX; f++){
+      if(lens[i + f] < commun){
+        commun = lens[i + f];
+      }
+    }
+    commun &= ~(size_t) 7;
+    const uint8_t *p0 = bufs[i], *p1 = bufs[i + 1], *p2 = bufs[i + 2], *p3 = bufs[i + 3];
+    uint64_t c0 = (uint32_t) ~crcs[i], c1 = (uint32_t) ~crcs[i + 1];
+    uint64_t c2 = (uint32_t) ~crcs[i + 2], c3 = (uint32_t) ~crcs[i + 3];
+    size_t k;
+    for(k = 0; k < commun; k += 8){
+      uint64_t m0, m1, m2, m3;
+      memcpy(&m0, p0 + k, 8);
+      memcpy(&m1, p1 + k, 8);
+      memcpy(&m2, p2 + k, 8);
+      memcpy(&m3, p3 + k, 8);
+      if(dsts != NULL){
+        memcpy(dsts[i] + k, &m0, 8);
+        memcpy(dsts[i + 1] + k, &m1, 8);
+        memcpy(dsts[i + 2] + k, &m2, 8);
+        memcpy(dsts[i + 3] + k, &m3, 8);
+      }
+      c0 = _mm_crc32_u64(c0, m0);
+      c1 = _mm_crc32_u64(c1, m1);
+      c2 = _mm_crc32_u64(c2, m2);
+      c3 = _mm_crc32_u64(c3, m3);
+    }
+    crcs[i] = crc32c_sse42_copier(~(uint32_t) c0, dsts != NULL ? dsts[i] + commun : NULL, p0 + commun, lens[i] - commun);
+    crcs[i + 1] = crc32c_sse42_copier(~(uint32_t) c1, dsts != NULL ? dsts[i + 1] + commun : NULL, p1 + commun, lens[i + 1] - commun);
+    crcs[i + 2] = crc32c_sse42_copier(~(uint32_t) c2, dsts != NULL ? dsts[i + 2] + commun : NULL, p2 + commun, lens[i + 2] - commun);
+    crcs[i + 3] = crc32c_sse42_copier(~(uint32_t) c3, dsts != NULL ? dsts[i + 3] + commun : NULL, p3 + commun, lens[i + 3] - commun);
+  }
+  for(; i < n; i++){
+    crcs[i] = crc32c_sse42_copier(crcs[i], dsts != NULL ? dsts[i] : NULL, bufs[i], lens[i]);
+  }
+}
+
+#endif
+
+
+/*
+* crc_init : Choisit les moteurs de checksum. Avec materiel, le processeur
+* est interroge (cpuid) : PCLMULQDQ pour CRC32, SSE4.2 pour CRC32C. Sinon,
+* ou s'il ne les a pas, le slicing-by-8 est utilise. Sans appel, le choix
+* materiel est fait au premier checksum.
+*
+* @materiel : 1 pour utiliser les instructions du processeur s'il les a
+*
+* @return : /
+*/
+void crc_init(int materiel){
+  if(crc32_nom == NULL){
+    crc_tables(crc32_tables, CRC32_POLY);
+    crc_tables(crc32c_tables, CRC32C_POLY);
+  }
+  crc32_moteur = crc32_logiciel;
+  crc32_copie_moteur = crc32_copier_logiciel;
+  crc32_nom = "slicing-by-8";
+  crc32c_moteur = crc32c_logiciel;
+  crc32c_copie_moteur = crc32c_copier_logiciel;
+  crc32c_multi_moteur = crc32c_multi_logiciel;
+  crc32c_entrelace = 0;
+  crc32c_nom = "slicing-by-8";
+#if defined(__x86_64__)
+  if(materiel){
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")){
+      crc32_moteur = crc32_pclmul;
+      crc32_copie_moteur = crc32_copier_pclmul;
+      crc32_nom = "pclmul";
+    }
+    if(__builtin_cpu_supports("sse4.2")){
+      crc32c_moteur = crc32c_sse42;
+      crc32c_copie_moteur = crc32c_copier_sse42;
+      crc32c_multi_moteur = crc32c_multi_sse42;
+      crc32c_entrelace = 1;
+      crc32c_nom = "sse4.2";
+    }
+  }
+#else
+  (void) materiel;
+#endif
+}
+
+
+/*
+* crc32_choisir, crc32c_choisir : Moteurs en place avant crc_init : le
+* premier checksum choisit les vrais moteurs, puis leur passe la main
+*/
+static uint32_t crc32_choisir(uint32_t crc, const void *buf, size_t len){
+  crc_init(1);
+  return crc32_moteur(crc, buf, len);
+}
+
+
+static uint32_t crc32c_choisir(uint32_t crc, const void *buf, size_t len){
+  crc_init(1);
+  return crc32c_moteur(crc, buf, len);
+}
+
+
+/*
+* crc_moteur : Donne le nom du moteur d'un checksum
+*
+* @csum : CSUM_CRC32 ou CSUM_CRC32C
+*
+* @return : le nom du moteur choisi par crc_init
+*/
+const char* crc_moteur(uint8_t csum){
+  if(crc32_nom == NULL){
+    crc_init(1);
+  }
+  return csum == CSUM_CRC32C ? crc32c_nom : crc32_nom;
+}
+
+
+/*
+* crc32_ieee : Calcule le CRC32 IEEE 802.3, identique a crc32 de zlib
+*
+* @crc : le CRC des donnees precedentes (0 au depart)
+* @buf : les donnees
+* @len : leur taille
+*
+* @return : le CRC des donnees precedentes suivies de buf
+*/
+uint32_t crc32_ieee(uint32_t crc, const void *buf, size_t len){
+  return crc32_moteur(crc, buf, len);
+}
+
+
+/*
+* crc32c : Calcule le CRC32C (Castagnoli, celui d'iSCSI et de SCTP)
+*
+* @crc : le CRC des donnees precedentes (0 au depart)
+* @buf : les donnees
+* @len : leur taille
+*
+* @return : le CRC des donnees precedentes suivies de buf
+*/
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len){
+  return crc32c_moteur(crc, buf, len);
+}
+
+
+/*
+* crc_pour : Donne la fonction d'un checksum
+*
+* @csum : CSUM_CRC32 ou CSUM_CRC32C
+*
+* @return : crc32c pour CSUM_CRC32C, crc32_ieee sinon
+*/
+crc_fn_t crc_pour(uint8_t csum){
+  return csum == CSUM_CRC32C ? crc32c : crc32_ieee;
+}
+
+
+/*
+* crc_copier : Copie des donnees en calculant leur checksum, en une seule
+* lecture : chaque mot lu pour le CRC est ecrit tel quel dans dst
+*
+* @csum : CSUM_CRC32 ou CSUM_CRC32C
+* @crc : le CRC des donnees precedentes (0 au depart)
+* @dst : la destination, d'au moins len octets, qui ne chevauche pas src
+* @src : les donnees
+* @len : leur taille
+*
+* @return : le CRC des donnees precedentes suivies de src
+*/
+uint32_t crc_copier(uint8_t csum, uint32_t crc, void *dst, const void *src, size_t len){
+  if(crc32_nom == NULL){
+    crc_init(1);
+  }
+  if(csum == CSUM_CRC32C){
+    return crc32c_copie_moteur(crc, dst, src, len);
+  }
+  return crc32_copie_moteur(crc, dst, src, len);
+}
+
+
+/*
+* crc_multi_entrelace : Indique si crc32_multi calcule plusieurs buffers en
+* meme temps pour un checksum, plutot qu'un apres l'autre
+*
+* @csum : CSUM_CRC32 ou CSUM_CRC32C
+*
+* @return : 1 si le noyau multi-buffer entrelace les buffers, 0 sinon
+*/
+static int crc_multi_entrelace(uint8_t csum){
+  if(crc32_nom == NULL){
+    crc_init(1);
+  }
+  return csum == CSUM_CRC32C && crc32c_entrelace;
+}
+
+
+/*
+* crc32_multi : Calcule le checksum de plusieurs buffers independants en
+* une fois : pour CRC32C, le noyau choisi par crc_init fait avancer plusieurs
+* flux en parallele, ce qui cache la latence des instructions de chacun.
+* CRC32 est calcule un buffer apres l'autre : le repliement PCLMULQDQ d'un
+* buffer occupe deja toutes les multiplications du processeur.
+*
+* @csum : CSUM_CRC32 ou CSUM_CRC32C
+* @bufs : les buffers
+* @lens : leurs tailles
+* @crcs : les CRC des donnees precedentes (0 au depart), remplaces par ceux
+*         des donnees precedentes suivies de chaque buffer
+* @n : le nombre de buffers
+*
+* @return : /
+*/
+void crc32_multi(uint8_t csum, const uint8_t **bufs, const size_t *lens, uint32_t *crcs, int n){
+  crc_multi_copier(csum, bufs, NULL, lens, crcs, n);
+}
+
+
+/*
+* crc_multi_copier : Comme crc32_multi, en copiant en plus chaque buffer
+* dans sa destination si dsts n'est pas NULL
+*
+* @csum : CSUM_CRC32 ou CSUM_CRC32C
+* @bufs : les buffers
+* @dsts : leurs destinations, ou NULL
+* @lens : leurs tailles
+* @crcs : les CRC courants, remplaces par les resultats
+* @n : le nombre de buffers
+*
+* @return : /
+*/
+static void crc_multi_copier(uint8_t csum, const uint8_t **bufs, uint8_t **dsts, const size_t *lens, uint32_t *crcs, int n){
+  if(crc32_nom == NULL){
+    crc_init(1);
+  }
+  if(csum == CSUM_CRC32C){
+    crc32c_multi_moteur(bufs, dsts, lens, crcs, n);
+    return;
+  }
+  int i;
+  for(i = 0; i < n; i++){
+    crcs[i] = crc32_copie_moteur(crcs[i], dsts != NULL ? dsts[i] : NULL, bufs[i], lens[i]);
+  }
+}
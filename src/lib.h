@@ -13,6 +13,7 @@
 #include <netinet/in.h>
 #include <sys/select.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <getopt.h>
 #include <ctype.h>
@@ -23,6 +24,123 @@ typedef struct pkt pkt_t;
 
 typedef struct ack ack_t;
 
+/* Slab de paquets alloues d'un bloc, header et payload dans le meme slot */
+typedef struct pkt_slab pkt_slab_t;
+
+/* Buffer d'envoi ou de reception, indexe par numero de sequence */
+typedef struct pkt_buffer pkt_buffer_t;
+
+/* Lot de datagrammes envoyes ensemble par sendmmsg sur un socket connecte,
+ * en trains UDP_SEGMENT quand le noyau le permet, payload copie ou non */
+typedef struct tx_batch tx_batch_t;
+
+/* Nombre maximal de datagrammes envoyes par un meme appel systeme */
+#define TX_BATCH_MAX 32
+
+/* Anneau de buffers remplis ensemble par recvmmsg, trains UDP_GRO compris */
+typedef struct rx_batch rx_batch_t;
+
+/* Nombre maximal de datagrammes recus par un meme appel systeme */
+#define RX_BATCH_MAX 32
+
+/* Boucle d'evenements : epoll sur les descripteurs, timerfd pour les
+ * echeances, signalfd pour SIGINT et SIGTERM */
+typedef struct event_loop event_loop_t;
+
+/* Callback de la boucle d'evenements, appele avec le contexte de la boucle.
+ * Renvoie 0 pour continuer, 1 pour arreter la boucle, -1 en cas d'erreur. */
+typedef int (*event_cb_t)(void *ctx);
+
+/* Nombre maximal de descripteurs surveilles par une boucle d'evenements */
+#define EVENT_LOOP_MAX_FD 8
+
+/* Lectures et ecritures de fichier soumises ensemble au noyau par io_uring,
+ * si liburing etait present a la compilation (HAVE_LIBURING) */
+typedef struct io_ring io_ring_t;
+
+/* Checksum (CRC32 ou CRC32C) : CRC des donnees precedentes (0 au depart),
+ * donnees et leur taille. Renvoie le CRC des donnees precedentes suivies de
+ * celles-ci. */
+typedef uint32_t (*crc_fn_t)(uint32_t crc, const void *buf, size_t len);
+
+/* Callback de fin d'une operation d'un io_ring : tag donne a la soumission,
+ * octets transferes ou -errno. Renvoie 0, ou -1 pour arreter la recolte. */
+typedef int (*io_cb_t)(void *ctx, void *tag, int res);
+
+/* Options transportees dans le payload d'un ACK, sous forme de TLV :
+ * type (1 octet), longueur de la valeur (1 octet), valeur */
+#define ACK_OPT_SACK 1
+/* La valeur de l'option SACK est une suite de blocs de paquets recus a la
+ * suite, apres le numero de sequence acquitte : ecart entre le premier paquet
+ * du bloc et ce numero (16 bits), puis nombre de paquets (16 bits). Les
+ * premiers blocs contiennent les derniers paquets recus, les suivants sont
+ * dans l'ordre a partir du trou (RFC 2018). */
+#define ACK_OPT_SACK_BLOC_LEN 4
+/* Nombre maximal de blocs de l'option SACK */
+#define ACK_SACK_MAX_BLOCS 8
+/* Option d'offre de l'extension : facteur d'echelle de la fenetre (shift) */
+#define ACK_OPT_WSCALE 2
+#define ACK_OPT_WSCALE_LEN 1
+/* Option de l'extension : numero de sequence acquitte sur 32 bits */
+#define ACK_OPT_SEQ32 3
+#define ACK_OPT_SEQ32_LEN 4
+/* Option de negociation de la taille des paquets : payload maximal accepte
+ * par le receiver (16 bits) puis plus grand payload recu (16 bits) */
+#define ACK_OPT_MSS 4
+#define ACK_OPT_MSS_LEN 4
+/* Options du paquet de connexion (HELLO) : le sender l'envoie avant ses
+ * premieres donnees, au format d'un ACK, pour annoncer ce qu'il accepte.
+ * Il y reprend WSCALE (facteur maximal) et MSS (payload maximal). */
+/* Le sender comprend les ACK selectifs (pas de valeur) */
+#define ACK_OPT_SACK_OK 5
+#define ACK_OPT_SACK_OK_LEN 0
+/* Delai maximal avant d'acquitter que tolere le sender, en microsecondes */
+#define ACK_OPT_ACK_DELAY 6
+#define ACK_OPT_ACK_DELAY_LEN 4
+/* Checksums : ceux que le sender connait dans le HELLO, celui retenu dans les
+ * ACK du receiver, qui confirment ainsi la reception du HELLO */
+#define ACK_OPT_CSUM 7
+#define ACK_OPT_CSUM_LEN 1
+/* Algorithmes de checksum (masque de bits). Les ACK sont toujours proteges
+ * par CRC32, les paquets de donnees par le checksum retenu. */
+#define CSUM_CRC32 0x01
+#define CSUM_CRC32C 0x02
+/* Taille maximale du payload (options) d'un ACK */
+#define MAX_ACK_PAYLOAD_SIZE 64
+
+/* Bloc de l'option SACK */
+typedef struct {
+	uint16_t debut; // Ecart entre le premier paquet du bloc et le numero de sequence acquitte
+	uint16_t nb; // Nombre de paquets du bloc
+} sack_bloc_t;
+
+/* Acquittement : header TRTP suivi eventuellement d'options et de leur CRC2 */
+struct __attribute__((__packed__)) ack {
+	uint8_t window:5; // Encode sur 5 bits
+	uint8_t tr:1; // Encode sur 1 bit
+	uint8_t type:2; // Encode sur 2 bits
+	uint32_t seqnum; // Encode sur 8 bits, sur 32 bits avec l'option SEQ32
+	uint16_t length; // Encode sur 16 bits : taille des options
+	uint32_t timestamp; // Encode sur 32 bits (4 octets)
+	uint32_t crc1; // Encode sur 32 bits (4 octets)
+	uint8_t has_sack; // 1 si l'option SACK est presente
+	uint8_t nb_sack; // Nombre de blocs de l'option SACK
+	sack_bloc_t sack[ACK_SACK_MAX_BLOCS]; // Paquets deja recus apres seqnum
+	uint8_t has_wscale; // 1 si l'option WSCALE (offre de l'extension) est presente
+	uint8_t wscale; // Facteur d'echelle de la fenetre offert par le receiver
+	uint8_t has_seq32; // 1 si l'option SEQ32 est presente : seqnum est sur
+	                   // 32 bits et la fenetre est exprimee a l'echelle wscale
+	uint8_t has_mss; // 1 si l'option MSS est presente
+	uint16_t mss; // Payload maximal accepte par le receiver
+	uint16_t mss_recu; // Plus grand payload recu par le receiver
+	uint8_t sack_ok; // 1 si l'option SACK_OK est presente
+	uint32_t ack_delay; // Delai maximal avant d'acquitter, 0 si absent
+	uint8_t csum; // Masque des checksums (CSUM_*), 0 si absent
+};
+
+/* Roue de timers (hashed timing wheel) des retransmissions */
+typedef struct timer_wheel timer_wheel_t;
+
 /* Types de paquets */
 typedef enum {
 	PTYPE_DATA = 1,
@@ -30,19 +148,138 @@ typedef enum {
 	PTYPE_NACK = 3,
 } ptypes_t;
 
+/* Paquet decode sur place (pkt_view_decode) : le payload n'est pas copie,
+ * il pointe dans le buffer recu et n'est valide qu'aussi longtemps que lui */
+typedef struct {
+	ptypes_t type;
+	uint8_t tr;
+	uint8_t window;
+	uint8_t ext; // 1 si le numero de sequence est encode sur 32 bits
+	uint32_t seqnum; // 8 bits du header, 32 bits avec l'extension
+	uint16_t length; // Taille des donnees, sans le numero de sequence etendu
+	uint32_t timestamp;
+	uint32_t crc1;
+	uint8_t csum; // Checksum des CRC (CSUM_CRC32 ou CSUM_CRC32C)
+	uint32_t crc2; // 0 sans payload
+	uint8_t a_verifier; // 1 si le CRC2 recu sera verifie par pkt_from_view
+	const uint8_t *payload; // Donnees dans le buffer recu, NULL sans payload
+} pkt_view_t;
 
 
-/* Taille maximale permise pour le payload */
+
+/* Taille maximale permise pour le payload, tant qu'une taille plus grande
+ * n'a pas ete negociee */
 #define MAX_PAYLOAD_SIZE 512
+/* Plus grand payload negociable : le datagramme (header, payload et CRC2)
+ * doit tenir dans un datagramme UDP */
+#define MSS_MAX 65504
 /* Taille maximale de Window */
 #define MAX_WINDOW_SIZE 31
 
-#define LENGTH_BUF_REC 31
+/* Alignement d'un paquet (taille d'une ligne de cache) */
+#define PKT_SLOT_ALIGN 64
+
+/* Extension de sequence (negociee) : un paquet de donnees porte le type
+ * WIRE_TYPE_DATA_EXT et son numero de sequence sur 32 bits en tete du
+ * payload, qui ne laisse que MAX_PAYLOAD_SIZE - SEQ_EXT_SIZE octets de
+ * donnees. Le champ seqnum du header en garde les 8 bits de poids faible. */
+#define WIRE_TYPE_DATA_EXT 0
+#define SEQ_EXT_SIZE 4
+/* Facteur d'echelle maximal de la fenetre : MAX_WINDOW_SIZE << WSCALE_MAX paquets */
+#define WSCALE_MAX 8
+
+/* Nombre de cases de chaque niveau de la roue de timers (puissance de 2) */
+#define TIMER_WHEEL_SLOTS 256
+/* Granularite d'une case de la roue de timers, en microsecondes */
+#define TIMER_WHEEL_TICK_US 1000
+
+/* Bornes du timeout de retransmission (RTO), en microsecondes */
+#define RTO_INIT_US 1000000
+#define RTO_MIN_US 3000
+#define RTO_MAX_US 8000000
 
 #define STDIN 0
 #define STDOUT 1
 #define STDERR 2
 
+/* Estimateur du RTT (SRTT/RTTVAR) et du RTO qui en decoule, en microsecondes */
+typedef struct {
+	uint64_t srtt;
+	uint64_t rttvar;
+	uint64_t rto;
+	int has_sample; /* 0 tant qu'aucune mesure n'a ete faite */
+} rtt_t;
+
+/* Pacing : gain applique a cwnd/SRTT en slow start et en congestion avoidance */
+#define PACING_GAIN_SS 2.0
+#define PACING_GAIN_CA 1.25
+/* Nombre de paquets qui peuvent partir d'affilee pour rattraper un reveil tardif */
+#define PACING_BURST 2
+
+/* Pacer : espace les envois au debit cwnd/SRTT */
+typedef struct {
+	uint64_t rate; /* Debit en octets par seconde, 0 si pas (encore) de pacing */
+	uint64_t next_send; /* Heure (us) a partir de laquelle le prochain paquet peut partir */
+	uint32_t mss; /* Taille d'un paquet, en octets */
+} pacer_t;
+
+/* Politique d'acquittement par defaut : un ACK tous les ACK_EVERY paquets
+ * recus dans l'ordre, au plus tard ACK_DELAY_US apres le premier. Le delai
+ * doit rester sous RTO_MIN_US pour ne pas declencher de renvoi inutile. */
+#define ACK_EVERY 2
+#define ACK_DELAY_US 2000
+/* Delai d'acquittement maximal : un ACK retarde ne doit pas faire expirer un
+ * timer de retransmission */
+#define ACK_DELAY_MAX_US (RTO_MIN_US - TIMER_WHEEL_TICK_US)
+
+/* Politique d'acquittement du receiver : ACK retardes et regroupes */
+typedef struct {
+	uint32_t every; /* Nombre de paquets dans l'ordre acquittes par un ACK */
+	uint64_t delay; /* Delai maximal avant d'acquitter, en microsecondes */
+	uint32_t pending; /* Nombre de paquets recus et pas encore acquittes */
+	uint64_t deadline; /* Heure limite d'envoi de l'ACK en attente */
+} ack_policy_t;
+
+/* Fenetre de congestion initiale et maximale, en paquets */
+#define CC_INIT_CWND 10
+#define CC_MAX_CWND 65535
+
+/* Raison de la derniere reduction de la fenetre de congestion */
+#define CC_RECOVERY_NONE 0
+#define CC_RECOVERY_LOSS 1
+#define CC_RECOVERY_TIMEOUT 2
+
+typedef struct cc cc_t;
+
+/* Algorithme de controle de congestion : ensemble de callbacks */
+typedef struct {
+	const char *name;
+	/* Initialise l'etat de l'algorithme */
+	void (*init)(cc_t *cc, uint64_t now);
+	/* acked paquets viennent d'etre acquittes */
+	void (*on_ack)(cc_t *cc, uint32_t acked, uint64_t now, const rtt_t *rtt);
+	/* Une perte a ete detectee sans timeout (NACK, ACKs dupliques, ...) */
+	void (*on_loss)(cc_t *cc, uint64_t now);
+	/* Un timer de retransmission a expire */
+	void (*on_timeout)(cc_t *cc, uint64_t now);
+	/* Fenetre de congestion courante, en paquets */
+	uint32_t (*cwnd)(const cc_t *cc);
+} cc_ops_t;
+
+/* Etat du controle de congestion (commun a tous les algorithmes) */
+struct cc {
+	const cc_ops_t *ops;
+	double cwnd; /* Fenetre de congestion, en paquets */
+	double ssthresh; /* Seuil de slow start, en paquets */
+	int in_recovery; /* CC_RECOVERY_* si la fenetre a deja ete reduite pour ces donnees */
+	uint32_t recover; /* Paquets envoyes au moment de la perte */
+	/* CUBIC */
+	double w_max; /* Fenetre au moment de la derniere perte */
+	double k; /* Temps pour revenir a w_max, en secondes */
+	double w_est; /* Estimation de la fenetre de Reno (mode TCP-friendly) */
+	uint64_t epoch_start; /* Debut de l'epoque courante, 0 si aucune */
+};
+
 /* Valeur de retours des fonctions */
 typedef enum {
 	PKT_OK = 0,     /* Le paquet a ete traite avec succes */
@@ -67,6 +304,15 @@ typedef enum {
 */
 pkt_t* pkt_new();
 
+/*
+* pkt_new_taille : Fonction qui crée un nouveau paquet de type PTYPE_DATA
+* pouvant contenir un payload de taille donnee
+*
+* @capacite : la taille maximale du payload (au plus MSS_MAX)
+* @return : un nouveau paquet de type PTYPE_DATA ou NULL en cas d'erreur
+*/
+pkt_t* pkt_new_taille(uint16_t capacite);
+
 /*
 * pkt_ack_new : Fonction qui crée un nouveau paquet de type PTYPE_ACK
 *
@@ -74,6 +320,15 @@ pkt_t* pkt_new();
 */
 ack_t* ack_new();
 
+/*
+* pkt_reset : Remet a zero le header d'un paquet, qui redevient un paquet
+* de type PTYPE_DATA vide
+*
+* @pkt : pointeur vers un paquet
+* @return : /
+*/
+void pkt_reset(pkt_t *pkt);
+
 /*
 * pkt_del : Libere le pointeur vers la struct pkt, ainsi que toutes les
 * ressources associees
@@ -114,9 +369,35 @@ uint8_t  pkt_get_window   (const pkt_t* pkt);
 * du paquet place en argument
 *
 * @pkt : pointeur vers un paquet
-* @return : le numero de sequence du paquet
+* @return : le numero de sequence du paquet (8 bits, ou 32 bits avec
+* l'extension de sequence)
+*/
+uint32_t pkt_get_seqnum   (const pkt_t* pkt);
+
+/*
+* pkt_get_ext : Indique si le paquet utilise l'extension de sequence
+*
+* @pkt : pointeur vers un paquet
+* @return : 1 si le numero de sequence est encode sur 32 bits, 0 sinon
+*/
+uint8_t  pkt_get_ext      (const pkt_t* pkt);
+
+/*
+* pkt_get_csum : Indique le checksum des CRC du paquet
+*
+* @pkt : pointeur vers un paquet
+* @return : CSUM_CRC32 ou CSUM_CRC32C
+*/
+uint8_t  pkt_get_csum     (const pkt_t* pkt);
+
+/*
+* pkt_get_capacite : Fonction qui va chercher la taille maximale du payload
+* du paquet place en argument
+*
+* @pkt : pointeur vers un paquet
+* @return : la taille maximale du payload, numero de sequence etendu compris
 */
-uint8_t  pkt_get_seqnum   (const pkt_t* pkt);
+uint16_t pkt_get_capacite (const pkt_t* pkt);
 
 /*
 * pkt_get_length: Fonction qui va chercher la longueur du payload
@@ -163,6 +444,24 @@ uint32_t pkt_get_crc2(const pkt_t* pkt);
 */
 const char* pkt_get_payload(const pkt_t* pkt);
 
+/*
+* pkt_has_payload_ref : Indique si le payload d'un paquet est reference
+* hors du paquet (pkt_set_payload_ref)
+*
+* @pkt : pointeur vers un paquet
+* @return : 1 si le payload est hors du paquet, 0 sinon
+*/
+int pkt_has_payload_ref(const pkt_t* pkt);
+
+/*
+* pkt_payload_buffer : Donne la zone du payload d'un paquet, pour y lire
+* directement des donnees avant de fixer sa longueur
+*
+* @pkt : pointeur vers un paquet
+* @return : le debut du payload, de la capacite du paquet
+*/
+char* pkt_payload_buffer(pkt_t* pkt);
+
 /*
 * pkt_set_type : Fonction qui va initialiser le type du paquet en arguments
 * a une certaine valeur
@@ -205,7 +504,28 @@ pkt_status_code pkt_set_window   (pkt_t* pkt, const uint8_t window);
 * @return : Un code indiquant si l'operation a reussi ou representant
 * l'erreur rencontree
 */
-pkt_status_code pkt_set_seqnum   (pkt_t* pkt, const uint8_t seqnum);
+pkt_status_code pkt_set_seqnum   (pkt_t* pkt, const uint32_t seqnum);
+
+/*
+* pkt_set_ext : Active ou desactive l'extension de sequence d'un paquet de
+* donnees
+*
+* @ext : 1 pour encoder le numero de sequence sur 32 bits
+* @pkt : pointeur vers un paquet
+* @return : Un code indiquant si l'operation a reussi ou representant
+* l'erreur rencontree
+*/
+pkt_status_code pkt_set_ext      (pkt_t* pkt, const uint8_t ext);
+
+/*
+* pkt_set_csum : Choisit le checksum des CRC du paquet, negocie par le HELLO
+*
+* @csum : CSUM_CRC32 ou CSUM_CRC32C
+* @pkt : pointeur vers un paquet
+* @return : Un code indiquant si l'operation a reussi ou representant
+* l'erreur rencontree
+*/
+pkt_status_code pkt_set_csum     (pkt_t* pkt, const uint8_t csum);
 
 /*
 * pkt_set_length : Fonction qui va initialiser la longueur du payload du
@@ -223,11 +543,12 @@ pkt_status_code pkt_set_length   (pkt_t* pkt, const uint16_t length);
 * paquet en arguments a une certaine valeur
 *
 * @timestamp : valeur a laquelle le timestamp du paquet doit etre initialise
+* (le sender y met les 32 bits de poids faible de time_now_us())
 * @pkt : pointeur vers un paquet
 * @return : Un code indiquant si l'operation a reussi ou representant
 * l'erreur rencontree
 */
-pkt_status_code pkt_set_timestamp(pkt_t* pkt);
+pkt_status_code pkt_set_timestamp(pkt_t* pkt, const uint32_t timestamp);
 
 /*
 * pkt_set_crc1 : Fonction qui va initialiser la valeur du CRC1 du
@@ -263,6 +584,19 @@ pkt_status_code pkt_set_crc2(pkt_t* pkt, const uint32_t crc2);
 */
 pkt_status_code pkt_set_payload(pkt_t* pkt, const char *data, const uint16_t length);
 
+/*
+* pkt_set_payload_ref : Fait du payload du paquet une reference vers des
+* donnees, sans les copier. Elles doivent rester en place tant que le paquet
+* peut etre encode.
+*
+* @pkt : pointeur vers un paquet
+* @data : les donnees du payload
+* @length : la longueur du payload
+* @return : Un code indiquant si l'operation a reussi ou representant
+* l'erreur rencontree
+*/
+pkt_status_code pkt_set_payload_ref(pkt_t *pkt, const char *data, const uint16_t length);
+
 
 /*
 * pkt_encode : Encode une struct pkt dans un buffer, pret a etre envoye sur le reseau
@@ -272,35 +606,137 @@ pkt_status_code pkt_set_payload(pkt_t* pkt, const char *data, const uint16_t len
 * @pkt: La structure a encoder
 * @buf: Le buffer dans lequel la structure sera encodee
 * @len: La taille disponible dans le buffer
+* @len-POST: Le nombre de d'octets ecrit dans le buffer (12, plus le payload
+* et son CRC32 s'il y en a un)
+* @return: Un code indiquant si l'operation a reussi ou E_NOMEM si
+* le buffer est trop petit.
+*/
+pkt_status_code pkt_encode(const pkt_t* pkt, uint8_t *buf, size_t *len);
+
+
+/*
+* pkt_encode_batch : Encode un lot de paquets comme pkt_encode, leurs
+* checksums etant calcules ensemble
+*
+* @pkts: Les structures a encoder
+* @n: Le nombre de paquets
+* @bufs: Les buffers dans lesquels les paquets seront encodes
+* @lens: La taille disponible dans chaque buffer
+* @len-POST: Le nombre de d'octets ecrit dans chaque buffer
+* @return: PKT_OK, ou le code du premier paquet qui n'a pu etre encode :
+* aucun buffer n'est alors utilisable
+*/
+pkt_status_code pkt_encode_batch(const pkt_t **pkts, int n, uint8_t **bufs, size_t *lens);
+
+
+/*
+* pkt_encode_sg : Encode un paquet sans copier son payload. Le header (avec
+* le numero de sequence etendu) est encode dans buf, suivi directement du
+* CRC2 : le datagramme est header, payload (pkt_get_payload) puis CRC2.
+*
+* @pkt: La structure a encoder
+* @buf: Le buffer dans lequel le header et le CRC2 seront encodes
+* @len: La taille disponible dans le buffer
+* @len-POST: Le nombre de d'octets ecrit dans le buffer
+* @header: Mis a la taille du header, avant laquelle s'insere le payload
 * @return: Un code indiquant si l'operation a reussi ou E_NOMEM si
 * le buffer est trop petit.
 */
-pkt_status_code pkt_encode(const pkt_t* pkt, uint8_t *buf, size_t len);
+pkt_status_code pkt_encode_sg(const pkt_t* pkt, uint8_t *buf, size_t *len, size_t *header);
+
+
+/*
+* pkt_encode_sg_batch : Encode un lot de paquets comme pkt_encode_sg, leurs
+* checksums etant calcules ensemble
+*
+* @pkts: Les structures a encoder
+* @n: Le nombre de paquets
+* @bufs: Les buffers dans lesquels les headers et les CRC2 seront encodes
+* @lens: La taille disponible dans chaque buffer
+* @len-POST: Le nombre de d'octets ecrit dans chaque buffer
+* @headers: Mis a la taille de chaque header
+* @return: PKT_OK, ou le code du premier paquet qui n'a pu etre encode :
+* aucun buffer n'est alors utilisable
+*/
+pkt_status_code pkt_encode_sg_batch(const pkt_t **pkts, int n, uint8_t **bufs, size_t *lens, size_t *headers);
 
 
 /*
-* pkt_encode : Encode une struct ack dans un buffer, pret a etre envoye sur le reseau
+* ack_encode : Encode une struct ack dans un buffer, pret a etre envoye sur le reseau
 * (c-a-d en network byte-order), incluant le CRC32 du header et
+* eventuellement les options et leur CRC32.
 *
 * @ack: La structure a encoder
 * @buf: Le buffer dans lequel la structure sera encodee
 * @len: La taille disponible dans le buffer
+* @len-POST: Le nombre de d'octets ecrit dans le buffer
 * @return: Un code indiquant si l'operation a reussi ou E_NOMEM si
 * le buffer est trop petit.
 */
-pkt_status_code ack_encode(const ack_t* ack, uint8_t *buf, size_t len);
+pkt_status_code ack_encode(const ack_t* ack, uint8_t *buf, size_t *len);
 
 /*
-* pkt_decode : Decode des donnees recues et cree une nouvelle structure pkt.
-* Le paquet recu est en network byte-order.
+* pkt_view_decode : Decode un paquet de donnees sur place, sans rien copier :
+* la vue pointe dans le buffer recu, qui n'est pas modifie. Le paquet recu
+* est en network byte-order.
 * La fonction verifie que:
 * - Le CRC32 du header recu est le même que celui decode a la fin
 *   du header (en considerant le champ TR a 0)
 * - S'il est present, le CRC32 du payload recu est le meme que celui
 *   decode a la fin du payload
-* - Le type du paquet est valide
+* - Le type du paquet est valide (un paquet de type WIRE_TYPE_DATA_EXT
+*   est un paquet de donnees avec un numero de sequence sur 32 bits)
 * - La longueur du paquet et le champ TR sont valides et coherents
-*   avec le nombre d'octets recus.
+*   avec le nombre d'octets recus : 12 octets pour un paquet tronque ou
+*   vide, 12 + length + 4 sinon. Le payload tient dans capacite.
+* Le checksum est celui, parmi csums, avec lequel le CRC1 concorde.
+*
+* @data: L'ensemble d'octets constituant le paquet recu
+* @len: Le nombre de bytes recus
+* @capacite: La taille maximale du payload accepte
+* @csums: Les checksums acceptes (masque de CSUM_*)
+* @vue: La vue a remplir
+* @post: vue represente le paquet recu, son payload pointe dans data
+* @return: Un code indiquant si l'operation a reussi ou representant
+* l'erreur rencontree
+*/
+pkt_status_code pkt_view_decode(const uint8_t *data, const size_t len, uint16_t capacite, uint8_t csums, pkt_view_t *vue);
+
+/*
+* pkt_view_decode_batch : Decode sur place un lot de paquets recus, comme
+* pkt_view_decode pour chacun, mais en calculant leurs CRC1 puis leurs CRC2
+* ensemble avec crc32_multi
+*
+* @datas: Les paquets recus
+* @lens: Le nombre de bytes recus pour chacun
+* @n: Le nombre de paquets
+* @capacite: La taille maximale du payload accepte
+* @csums: Les checksums acceptes (masque de CSUM_*)
+* @copie: 1 si les payloads seront tous copies par pkt_from_view : leur
+* CRC2 est alors verifie pendant la copie (a_verifier), pas ici
+* @vues: Les vues a remplir, une par paquet
+* @codes: Rempli avec le code de pkt_view_decode de chaque paquet
+* @return: /
+*/
+void pkt_view_decode_batch(const uint8_t **datas, const size_t *lens, int n, uint16_t capacite, uint8_t csums, int copie, pkt_view_t *vues, pkt_status_code *codes);
+
+/*
+* pkt_from_view : Copie un paquet decode sur place dans une struct pkt, qui
+* ne depend plus du buffer recu. C'est la seule copie du payload. Si le CRC2
+* de la vue reste a verifier, il est calcule pendant la copie.
+*
+* @pkt: Une struct pkt valide, assez grande pour le payload
+* @vue: Le paquet decode par pkt_view_decode
+* @post: pkt est la representation du paquet recu
+* @return: Un code indiquant si l'operation a reussi ou representant
+* l'erreur rencontree (E_CRC si le CRC2 verifie ici est faux)
+*/
+pkt_status_code pkt_from_view(pkt_t *pkt, const pkt_view_t *vue);
+
+/*
+* pkt_decode : Decode des donnees recues et cree une nouvelle structure pkt.
+* Le paquet recu est en network byte-order. Les verifications sont celles de
+* pkt_view_decode, le payload est copie dans pkt.
 *
 * @data: L'ensemble d'octets constituant le paquet recu
 * @len: Le nombre de bytes recus
@@ -331,6 +767,65 @@ pkt_status_code pkt_decode(uint8_t *data, const size_t len, pkt_t *pkt);
 */
 pkt_status_code ack_decode(uint8_t *data, const size_t len, ack_t *ack);
 
+/*
+* ack_set_sack : Ajoute l'option SACK a un acquittement, ou la retire
+*
+* @ack : l'acquittement
+* @has_sack : 1 pour ajouter l'option, 0 pour la retirer
+* @blocs : les blocs de paquets recus apres le numero de sequence acquitte
+* @nb_blocs : le nombre de blocs, au plus ACK_SACK_MAX_BLOCS
+*
+* @return : /
+*/
+void ack_set_sack(ack_t *ack, uint8_t has_sack, const sack_bloc_t *blocs, int nb_blocs);
+
+/*
+* ack_set_ext : Ajoute a un acquittement les options de l'extension de
+* sequence, ou les retire
+*
+* @ack : l'acquittement
+* @has_wscale : 1 pour offrir l'extension (option WSCALE)
+* @wscale : le facteur d'echelle de la fenetre
+* @has_seq32 : 1 pour transmettre seqnum sur 32 bits (option SEQ32)
+*
+* @return : /
+*/
+void ack_set_ext(ack_t *ack, uint8_t has_wscale, uint8_t wscale, uint8_t has_seq32);
+
+/*
+* ack_set_mss : Ajoute l'option MSS a un acquittement, ou la retire
+*
+* @ack : l'acquittement
+* @has_mss : 1 pour ajouter l'option, 0 pour la retirer
+* @mss : le payload maximal accepte
+* @mss_recu : le plus grand payload recu jusqu'ici
+*
+* @return : /
+*/
+void ack_set_mss(ack_t *ack, uint8_t has_mss, uint16_t mss, uint16_t mss_recu);
+
+/*
+* ack_set_hello : Ajoute a un acquittement les options propres a la
+* connexion, ou les retire
+*
+* @ack : l'acquittement (ou le paquet de connexion)
+* @sack_ok : 1 pour ajouter l'option SACK_OK
+* @ack_delay : le delai maximal avant d'acquitter, 0 pour retirer l'option
+* @csum : le masque des checksums, 0 pour retirer l'option
+*
+* @return : /
+*/
+void ack_set_hello(ack_t *ack, uint8_t sack_ok, uint32_t ack_delay, uint8_t csum);
+
+/*
+* ack_get_size : Donne la taille d'un acquittement encode
+*
+* @ack : l'acquittement
+*
+* @return : 12 octets de header, plus les options et leur CRC2 s'il y en a
+*/
+size_t ack_get_size(const ack_t *ack);
+
 /*
 * real_address : Trouve le nom de la ressource correspondant à une adresse IPv6
 *
@@ -373,66 +868,125 @@ int create_socket(struct sockaddr_in6 *source_addr,
 
 
 	/*
-	* seqnum_inc : Incremente le numéro de sequence de 1.
-	* Si le numero de sequence etait 255, le remet à 0.
+	* seq_lt : Compare deux numeros de sequence sur 32 bits (arithmetique des
+	* numeros de serie, RFC 1982)
 	*
-	* @seqnum : numero de sequence à incrementer
+	* @a : un numero de sequence
+	* @b : un numero de sequence
 	*
-	* @return : 0 si le numéro de séquence a été incrémenté
-	*           1 si le numéro de séquence a été remis à 0
-	*           -1 si le numéro de séquence n'était pas valide
+	* @return : 1 si a precede b, 0 sinon
 	*/
-	int seqnum_inc(uint8_t* seqnum);
+	int seq_lt(uint32_t a, uint32_t b);
 
 
 	/*
-	* in_window : Vérifie si le numéro de séquence est dans la fenetre
+	* seq_in_window : Vérifie si le numéro de séquence est dans la fenetre
 	*
 	* @seqnum : numero de sequence à verifier
-	* @min_window : le plus petit numero de sequence present dans la fenetre
-	* @max_window : le plus grand numero de sequence present dans la fenetre
+	* @debut : le premier numero de sequence de la fenetre
+	* @taille : le nombre de numeros de sequence de la fenetre
 	*
-	* @return : 0 si il est dans la fenetre
-	*					 -1 si il est hors de la fenetre
-	*					 1 si une erreur d'argument
+	* @return : 1 si il est dans la fenetre, 0 sinon
+	*/
+	int seq_in_window(uint32_t seqnum, uint32_t debut, uint32_t taille);
+
+
+	/*
+	* seq_unwrap8 : Retrouve le numero de sequence sur 32 bits dont on ne
+	* connait que les 8 bits de poids faible, le plus proche d'une reference
+	*
+	* @ref : le numero de sequence de reference (32 bits)
+	* @seqnum : les 8 bits de poids faible
+	*
+	* @return : le numero de sequence dans [ref - 128, ref + 127]
+	*/
+	uint32_t seq_unwrap8(uint32_t ref, uint8_t seqnum);
+
+
+	/*
+	* pkt_buffer_new : Cree un buffer de paquets vide
 	*
+	* @capacite : nombre minimal de slots, arrondi a une puissance de 2 (au
+	* moins 64). Elle doit depasser la taille de la fenetre.
+	*
+	* @return : un nouveau buffer ou NULL en cas d'erreur
 	*/
-	int in_window (uint8_t seqnum, uint8_t min_window, uint8_t max_window);
+	pkt_buffer_t* pkt_buffer_new(uint32_t capacite);
 
 
 	/*
-	* decale_window : Decale la fenetre de reception ou d'envoi
+	* pkt_buffer_del : Libere un buffer de paquets (mais pas les paquets)
 	*
-	* @min_window : un pointeur vers le plus petit numero de sequence present dans la fenetre
-	* @max_window : un pointeur vers le plus grand numero de sequence present dans la fenetre
+	* @buffer : le buffer de paquets
 	*
 	* @return : /
 	*/
-	void decale_window(uint8_t *min_window, uint8_t *max_window);
+	void pkt_buffer_del(pkt_buffer_t *buffer);
 
 
 	/*
-	* ajout_buffer : Ajoute un buffer dans le buffer d'envoi ou de reception
+	* ajout_buffer : Ajoute un paquet dans le buffer d'envoi ou de reception, a
+	* la place correspondant a son numero de sequence
 	*
 	* @pkt : un pointeur vers un paquet
-	* @buffer_recept : buffer de reception qui contient lui-meme des buffer
-	* @min_window : le plus petit numero de sequence present dans la fenetre
+	* @buffer : buffer d'envoi ou de reception
 	*
 	* @return : 0 si le paquet a bien été ajouté au buffer
-	*           1 si le paquet n'a pas été ajouté au buffer
+	*           1 si le paquet n'a pas été ajouté au buffer (place deja prise)
+	*/
+	int ajout_buffer (pkt_t* pkt, pkt_buffer_t* buffer);
+
+
+	/*
+	* buffer_taille : Donne le nombre de paquets presents dans le buffer
+	*
+	* @buffer : buffer de paquets
+	*
+	* @return : le nombre de paquets
+	*/
+	int buffer_taille(const pkt_buffer_t * buffer);
+
+
+	/*
+	* buffer_premier_trou : Cherche le premier numero de sequence absent du
+	* buffer a partir d'un numero donne
+	*
+	* @buffer : buffer de paquets
+	* @seqnum : le numero de sequence de depart
+	*
+	* @return : le plus petit numero de sequence >= seqnum absent du buffer
+	*/
+	uint32_t buffer_premier_trou(const pkt_buffer_t * buffer, uint32_t seqnum);
+
+
+	/*
+	* buffer_vider : Retire tous les paquets du buffer
+	*
+	* @buffer : buffer de paquets
+	* @slab : le slab auquel rendre les paquets (NULL : ils sont liberes)
+	*
+	* @return : /
 	*/
-	void ajout_buffer (pkt_t* pkt, pkt_t** buffer_recept, uint8_t min_window);
+	void buffer_vider(pkt_buffer_t * buffer, pkt_slab_t *slab);
 
 
 	/*
-	* buffer_plein : Verifie si le buffer est plein ou pas
+	* sack_blocs : Construit les blocs SACK des paquets hors-sequence presents
+	* dans le buffer de reception. Les premiers contiennent les derniers paquets
+	* recus : chacun est ainsi annonce au moins une fois au sender, meme quand
+	* les trous sont plus nombreux que les blocs. Les autres suivent dans l'ordre
+	* a partir du trou.
 	*
-	* @buffer : buffer de paquets a parcourir
+	* @buffer : le buffer de reception
+	* @min_window : le prochain numero de sequence attendu (le trou), acquitte
+	* @recents : les derniers paquets hors-sequence recus, du plus recent au plus ancien
+	* @nb_recents : le nombre de paquets de recents
+	* @blocs : ou stocker les blocs, au moins ACK_SACK_MAX_BLOCS
 	*
-	* @return : - 1 si le buffer est plein
-	*  					- 0 si il reste au moins une place dans le buffer
+	* @return : le nombre de blocs
 	*/
-	int buffer_plein(pkt_t ** buffer);
+	int sack_blocs(pkt_buffer_t * buffer, uint32_t min_window, const uint32_t *recents, int nb_recents,
+	               sack_bloc_t *blocs);
 
 
 	/*
@@ -445,7 +999,7 @@ int create_socket(struct sockaddr_in6 *source_addr,
 	* @return : - le paquet qui a pour numero de sequence seqnum
 	*           - NULL en cas d'erreur
 	*/
-	pkt_t* get_from_buffer(pkt_t ** buffer, uint8_t seqnum);
+	pkt_t* get_from_buffer(pkt_buffer_t * buffer, uint32_t seqnum);
 
 	/*
 	* retire_buffer : Retire un paquet dans le buffer d'envoi ou de reception
@@ -456,20 +1010,62 @@ int create_socket(struct sockaddr_in6 *source_addr,
 	* @return : - 0 si l'element a ete correctement retire du buffer
 	* 					 - 1 si l'element n'a pas ete retire correctement
 	*/
-	int retire_buffer(pkt_t ** buffer, uint8_t seqnum);
+	int retire_buffer(pkt_buffer_t * buffer, uint32_t seqnum);
+
+	/*
+	* pkt_slab_new : Alloue d'un bloc un slab de paquets, tous disponibles
+	*
+	* @nb_slots : le nombre de paquets du slab (au plus 65535)
+	* @capacite : la taille maximale du payload de chaque paquet
+	*
+	* @return : un nouveau slab ou NULL en cas d'erreur
+	*/
+	pkt_slab_t* pkt_slab_new(int nb_slots, uint16_t capacite);
+
+
+	/*
+	* pkt_slab_del : Libere un slab et tous ses paquets
+	*
+	* @slab : le slab de paquets
+	*
+	* @return : /
+	*/
+	void pkt_slab_del(pkt_slab_t *slab);
+
+
+	/*
+	* pkt_slot_acquire : Prend un paquet libre dans le slab, remis a zero. Un
+	* paquet est alloue a part seulement si le slab est epuise.
+	*
+	* @slab : le slab de paquets
+	*
+	* @return : un paquet de type PTYPE_DATA ou NULL en cas d'erreur
+	*/
+	pkt_t* pkt_slot_acquire(pkt_slab_t *slab);
+
 
 	/*
-	* write_buffer : Ecrit tous les éléments du buffer qui sont disponible et dans l'ordre
+	* pkt_slot_release : Rend un paquet au slab. Un paquet alloue hors du slab
+	* est libere.
 	*
-	* @fd : un numero de file descriptor representant le socket
-	* @buffer : un buffer de paquets
-	* @min_window : un pointeur vers le plus petit numero de sequence present dans la fenetre
-	* @max_window : un pointeur vers le plus grand numero de sequence present dans la fenetre
+	* @slab : le slab de paquets
+	* @pkt : le paquet dont on n'a plus besoin
+	*
+	* @return : /
+	*/
+	void pkt_slot_release(pkt_slab_t *slab, pkt_t *pkt);
+
+
+	/*
+	* pkt_slab_region : Donne la zone memoire contigue de tous les paquets du
+	* slab, pour l'enregistrer aupres du noyau
 	*
-	* @return : le nombre d'elements ecrits
+	* @slab : le slab de paquets
+	* @taille : la taille de la zone
 	*
+	* @return : le debut de la zone
 	*/
-	int write_buffer(int fd, pkt_t **buffer, uint8_t *min_window, uint8_t *max_window);
+	void* pkt_slab_region(const pkt_slab_t *slab, size_t *taille);
 
 
 	/*
@@ -485,5 +1081,806 @@ int create_socket(struct sockaddr_in6 *source_addr,
 	int arg_check(int argc, int n_min, int n_max);
 
 
+	/*
+	* arg_entier : Lit un entier passe en ligne de commande
+	*
+	* @arg : l'argument
+	* @min : la plus petite valeur acceptee
+	* @max : la plus grande valeur acceptee
+	* @val : ou stocker la valeur lue
+	*
+	* @return : - 0 si l'argument est un entier decimal entre min et max
+	*           - -1 sinon
+	*/
+	int arg_entier(const char *arg, long min, long max, long *val);
+
+
+	/*
+	* time_now_us : Donne l'heure d'une horloge monotone, en microsecondes
+	*
+	* @return : le temps ecoule depuis un instant de reference arbitraire
+	*/
+	uint64_t time_now_us(void);
+
+
+	/*
+	* timer_wheel_new : Cree une roue de timers vide
+	*
+	* @nb_keys : nombre de cles differentes (les cles sont prises modulo nb_keys)
+	* @now : le temps actuel, en microsecondes
+	*
+	* @return : une nouvelle roue de timers ou NULL en cas d'erreur
+	*/
+	timer_wheel_t* timer_wheel_new(uint32_t nb_keys, uint64_t now);
+
+
+	/*
+	* timer_wheel_del : Libere une roue de timers
+	*
+	* @tw : la roue de timers
+	*
+	* @return : /
+	*/
+	void timer_wheel_del(timer_wheel_t *tw);
+
+
+	/*
+	* timer_arm : Arme (ou rearme) le timer associe a une cle
+	*
+	* @tw : la roue de timers
+	* @key : la cle du timer (par exemple un numero de sequence)
+	* @deadline : l'echeance du timer, en microsecondes
+	*
+	* @return : /
+	*/
+	void timer_arm(timer_wheel_t *tw, uint32_t key, uint64_t deadline);
+
+
+	/*
+	* timer_cancel : Desarme le timer associe a une cle (sans effet s'il ne l'est pas)
+	*
+	* @tw : la roue de timers
+	* @key : la cle du timer
+	*
+	* @return : /
+	*/
+	void timer_cancel(timer_wheel_t *tw, uint32_t key);
+
+
+	/*
+	* timer_is_armed : Verifie si le timer associe a une cle est arme
+	*
+	* @tw : la roue de timers
+	* @key : la cle du timer
+	*
+	* @return : 1 si le timer est arme, 0 sinon
+	*/
+	int timer_is_armed(const timer_wheel_t *tw, uint32_t key);
+
+
+	/*
+	* timer_next_deadline : Donne la plus proche echeance parmi les timers armes.
+	* Si tous sont dans la roue de debordement, c'est le debut du tour ou le plus
+	* proche descend dans la roue fine : timer_expire l'y fait descendre, et
+	* l'echeance exacte est connue au prochain appel.
+	*
+	* @tw : la roue de timers
+	* @deadline : ou stocker l'echeance la plus proche
+	*
+	* @return : 1 si au moins un timer est arme (et *deadline est rempli)
+	*           0 si aucun timer n'est arme
+	*/
+	int timer_next_deadline(timer_wheel_t *tw, uint64_t *deadline);
+
+
+	/*
+	* timer_expire : Desarme et renvoie les cles des timers dont l'echeance est depassee
+	*
+	* @tw : la roue de timers
+	* @now : le temps actuel, en microsecondes
+	* @keys : tableau ou stocker les cles des timers expires
+	* @max_keys : taille du tableau keys
+	*
+	* @return : le nombre de cles stockees dans keys
+	*/
+	int timer_expire(timer_wheel_t *tw, uint64_t now, uint32_t *keys, int max_keys);
+
+
+	/*
+	* rtt_init : Initialise l'estimateur de RTT, avant toute mesure
+	*
+	* @rtt : l'estimateur a initialiser
+	*
+	* @return : /
+	*/
+	void rtt_init(rtt_t *rtt);
+
+
+	/*
+	* rtt_update : Met a jour SRTT, RTTVAR et le RTO avec une nouvelle mesure de RTT
+	* (algorithme de Jacobson/Karels, RFC 6298)
+	*
+	* @rtt : l'estimateur
+	* @sample : le RTT mesure, en microsecondes
+	*
+	* @return : /
+	*/
+	void rtt_update(rtt_t *rtt, uint64_t sample);
+
+
+	/*
+	* rtt_backoff : Double le RTO apres l'expiration d'un timer de retransmission
+	*
+	* @rtt : l'estimateur
+	*
+	* @return : /
+	*/
+	void rtt_backoff(rtt_t *rtt);
+
+
+	/*
+	* cc_find : Cherche un algorithme de controle de congestion par son nom
+	*
+	* @name : le nom de l'algorithme ("newreno" ou "cubic")
+	*
+	* @return : l'algorithme ou NULL s'il n'existe pas
+	*/
+	const cc_ops_t* cc_find(const char *name);
+
+
+	/*
+	* cc_init : Initialise le controle de congestion avec un algorithme donne
+	*
+	* @cc : l'etat a initialiser
+	* @ops : l'algorithme a utiliser
+	* @now : le temps actuel, en microsecondes
+	*
+	* @return : /
+	*/
+	void cc_init(cc_t *cc, const cc_ops_t *ops, uint64_t now);
+
+
+	/*
+	* cc_on_ack : Signale que des paquets ont ete acquittes
+	*
+	* @cc : l'etat du controle de congestion
+	* @acked : le nombre de paquets nouvellement acquittes
+	* @nb_acquittes : le nombre total de paquets acquittes depuis le debut
+	* @en_vol : le nombre de paquets en vol avant cet acquittement
+	* @now : le temps actuel, en microsecondes
+	* @rtt : l'estimation courante du RTT
+	*
+	* @return : /
+	*/
+	void cc_on_ack(cc_t *cc, uint32_t acked, uint32_t nb_acquittes, uint32_t en_vol,
+		uint64_t now, const rtt_t *rtt);
+
+
+	/*
+	* cc_on_loss : Signale une perte detectee sans timeout. La fenetre n'est
+	* reduite qu'une fois par fenetre de donnees envoyees.
+	*
+	* @cc : l'etat du controle de congestion
+	* @nb_envoyes : le nombre total de paquets envoyes depuis le debut
+	* @now : le temps actuel, en microsecondes
+	*
+	* @return : /
+	*/
+	void cc_on_loss(cc_t *cc, uint32_t nb_envoyes, uint64_t now);
+
+
+	/*
+	* cc_on_timeout : Signale l'expiration d'un timer de retransmission
+	*
+	* @cc : l'etat du controle de congestion
+	* @nb_envoyes : le nombre total de paquets envoyes depuis le debut
+	* @now : le temps actuel, en microsecondes
+	*
+	* @return : /
+	*/
+	void cc_on_timeout(cc_t *cc, uint32_t nb_envoyes, uint64_t now);
+
+
+	/*
+	* cc_cwnd : Donne la fenetre de congestion courante
+	*
+	* @cc : l'etat du controle de congestion
+	*
+	* @return : la fenetre de congestion, en paquets (au moins 1)
+	*/
+	uint32_t cc_cwnd(const cc_t *cc);
+
+
+	/*
+	* cc_in_slow_start : Verifie si le controle de congestion est en slow start
+	*
+	* @cc : l'etat du controle de congestion
+	*
+	* @return : 1 si cwnd < ssthresh, 0 sinon
+	*/
+	int cc_in_slow_start(const cc_t *cc);
+
+
+	/*
+	* pacer_init : Initialise un pacer, sans limite de debit
+	*
+	* @p : le pacer
+	* @mss : la taille d'un paquet sur le reseau, en octets
+	*
+	* @return : /
+	*/
+	void pacer_init(pacer_t *p, uint32_t mss);
+
+
+	/*
+	* pacer_set_rate : Recalcule le debit du pacer : gain * cwnd * mss / SRTT
+	*
+	* @p : le pacer
+	* @cc : l'etat du controle de congestion
+	* @rtt : l'estimation courante du RTT (pas de pacing sans mesure)
+	*
+	* @return : le nouveau debit, en octets par seconde (0 si pas de pacing)
+	*/
+	uint64_t pacer_set_rate(pacer_t *p, const cc_t *cc, const rtt_t *rtt);
+
+
+	/*
+	* pacer_delay : Donne le temps a attendre avant de pouvoir envoyer un paquet
+	*
+	* @p : le pacer
+	* @now : le temps actuel, en microsecondes
+	*
+	* @return : 0 si un paquet peut partir maintenant, le temps d'attente en
+	* microsecondes sinon
+	*/
+	uint64_t pacer_delay(const pacer_t *p, uint64_t now);
+
+
+	/*
+	* pacer_on_send : Comptabilise l'envoi d'un paquet
+	*
+	* @p : le pacer
+	* @bytes : la taille du paquet envoye
+	* @now : le temps actuel, en microsecondes
+	*
+	* @return : l'heure de depart prevue du paquet (au plus tot now)
+	*/
+	uint64_t pacer_on_send(pacer_t *p, size_t bytes, uint64_t now);
+
+
+	/*
+	* ack_policy_init : Initialise la politique d'acquittement
+	*
+	* @p : la politique d'acquittement
+	* @every : le nombre de paquets dans l'ordre acquittes par un meme ACK
+	* @delay : le delai maximal avant d'acquitter un paquet, en microsecondes
+	*
+	* @return : /
+	*/
+	void ack_policy_init(ack_policy_t *p, uint32_t every, uint64_t delay);
+
+
+	/*
+	* ack_policy_on_data : Signale la reception d'un paquet de donnees et decide
+	* s'il faut l'acquitter tout de suite
+	*
+	* @p : la politique d'acquittement
+	* @immediate : 1 si le paquet doit etre acquitte sans attendre (hors
+	* sequence, trou dans la fenetre, trou comble, doublon)
+	* @now : le temps actuel, en microsecondes
+	*
+	* @return : 1 s'il faut envoyer un ACK maintenant, 0 sinon
+	*/
+	int ack_policy_on_data(ack_policy_t *p, int immediate, uint64_t now);
+
+
+	/*
+	* ack_policy_timeout : Donne le temps restant avant l'envoi de l'ACK en attente
+	*
+	* @p : la politique d'acquittement
+	* @now : le temps actuel, en microsecondes
+	*
+	* @return : le temps d'attente en microsecondes, ou -1 si aucun ACK n'est en attente
+	*/
+	int64_t ack_policy_timeout(const ack_policy_t *p, uint64_t now);
+
+
+	/*
+	* ack_policy_on_sent : Signale qu'un ACK a ete envoye
+	*
+	* @p : la politique d'acquittement
+	*
+	* @return : /
+	*/
+	void ack_policy_on_sent(ack_policy_t *p);
+
+
+	/*
+	* tx_batch_new : Cree un lot d'envoi vide pour un socket connecte
+	*
+	* @sockfd : le socket, connecte a son destinataire
+	* @nb_max : le nombre de datagrammes au-dela duquel le lot est envoye
+	* @taille : la taille maximale d'un datagramme
+	* @txtime : 1 si chaque datagramme porte son heure de depart (SO_TXTIME)
+	*
+	* @return : un nouveau lot ou NULL en cas d'erreur
+	*/
+	tx_batch_t* tx_batch_new(int sockfd, int nb_max, size_t taille, int txtime);
+
+
+	/*
+	* tx_batch_del : Libere un lot d'envoi, sans envoyer son contenu
+	*
+	* @b : le lot d'envoi
+	*
+	* @return : /
+	*/
+	void tx_batch_del(tx_batch_t *b);
+
+
+	/*
+	* tx_batch_buffer : Donne le buffer dans lequel encoder le prochain datagramme
+	*
+	* @b : le lot d'envoi
+	* @len : la taille du buffer
+	*
+	* @return : le buffer du prochain datagramme
+	*/
+	uint8_t* tx_batch_buffer(tx_batch_t *b, size_t *len);
+
+
+	/*
+	* tx_batch_buffer_at : Donne le buffer d'un des prochains datagrammes, pour
+	* en encoder plusieurs avant de les ajouter au lot dans l'ordre
+	*
+	* @b : le lot d'envoi
+	* @i : le rang du datagramme apres le prochain, moins que tx_batch_place
+	* @len : la taille du buffer
+	*
+	* @return : le buffer du datagramme
+	*/
+	uint8_t* tx_batch_buffer_at(tx_batch_t *b, int i, size_t *len);
+
+
+	/*
+	* tx_batch_push : Ajoute au lot le datagramme encode dans tx_batch_buffer.
+	* Le lot est envoye des qu'il est plein.
+	*
+	* @b : le lot d'envoi
+	* @len : la taille du datagramme
+	* @depart : l'heure de depart du datagramme, en microsecondes
+	* (CLOCK_MONOTONIC), utilisee seulement avec SO_TXTIME
+	*
+	* @return : 0 si tout s'est bien deroule
+	*           -1 en cas d'erreur d'envoi
+	*/
+	int tx_batch_push(tx_batch_t *b, size_t len, uint64_t depart);
+
+
+	/*
+	* tx_batch_push_sg : Ajoute au lot un datagramme dont le payload n'est pas
+	* copie : son header et son CRC2 sont encodes a la suite dans
+	* tx_batch_buffer (pkt_encode_sg), le payload est envoye depuis sa place. Il
+	* doit y rester jusqu'a la fin de l'envoi. Le lot est envoye des qu'il est
+	* plein.
+	*
+	* @b : le lot d'envoi
+	* @len : le nombre d'octets encodes dans tx_batch_buffer
+	* @header : la taille du header, avant laquelle s'insere le payload
+	* @payload : le payload
+	* @len_payload : la taille du payload
+	* @depart : l'heure de depart du datagramme, en microsecondes
+	* (CLOCK_MONOTONIC), utilisee seulement avec SO_TXTIME
+	*
+	* @return : 0 si tout s'est bien deroule
+	*           -1 en cas d'erreur d'envoi
+	*/
+	int tx_batch_push_sg(tx_batch_t *b, size_t len, size_t header, const void *payload, size_t len_payload, uint64_t depart);
+
+
+	/*
+	* tx_batch_zerocopy : Envoie desormais les datagrammes sans copie
+	* (MSG_ZEROCOPY) : le noyau garde leurs pages jusqu'a la fin de l'envoi. Les
+	* buffers du lot sont doubles, on remplit l'un pendant que l'autre part. A
+	* appeler avant le premier datagramme.
+	*
+	* @b : le lot d'envoi
+	*
+	* @return : 0 si le noyau le permet
+	*           -1 sinon
+	*/
+	int tx_batch_zerocopy(tx_batch_t *b);
+
+
+	/*
+	* tx_batch_completions : Recolte les notifications de fin d'envoi sans copie
+	* deja arrivees. Le socket est signale en erreur (EPOLLERR) tant qu'il en
+	* reste.
+	*
+	* @b : le lot d'envoi
+	*
+	* @return : 0 si tout s'est bien deroule
+	*           -1 en cas d'erreur
+	*/
+	int tx_batch_completions(tx_batch_t *b);
+
+
+	/*
+	* tx_batch_flush : Envoie tous les datagrammes du lot. Un datagramme refuse
+	* (destinataire injoignable, trop grand) est perdu, comme sur le reseau.
+	*
+	* @b : le lot d'envoi
+	*
+	* @return : 0 si tout s'est bien deroule
+	*           -1 en cas d'erreur d'envoi
+	*/
+	int tx_batch_flush(tx_batch_t *b);
+
+
+	/*
+	* tx_batch_pending : Donne le nombre de datagrammes en attente dans le lot
+	*
+	* @b : le lot d'envoi
+	*
+	* @return : le nombre de datagrammes pas encore envoyes
+	*/
+	int tx_batch_pending(const tx_batch_t *b);
+
+
+	/*
+	* tx_batch_place : Donne le nombre de datagrammes que le lot peut encore
+	* recevoir avant d'etre envoye
+	*
+	* @b : le lot d'envoi
+	*
+	* @return : le nombre de buffers libres, au moins 1
+	*/
+	int tx_batch_place(const tx_batch_t *b);
+
+	/*
+	* rx_batch_new : Cree un anneau de buffers de reception pour un socket
+	*
+	* @sockfd : le socket sur lequel recevoir
+	* @nb_max : le nombre maximal de messages recus par appel systeme
+	* @taille : la taille d'un buffer ; un datagramme plus long est coupe
+	* @gro : 1 pour demander au noyau des trains de datagrammes (UDP_GRO), s'il
+	* le permet ; les buffers font alors GRO_TAILLE octets
+	*
+	* @return : un nouvel anneau ou NULL en cas d'erreur
+	*/
+	rx_batch_t* rx_batch_new(int sockfd, int nb_max, size_t taille, int gro);
+
+
+	/*
+	* rx_batch_del : Libere un anneau de buffers de reception
+	*
+	* @b : l'anneau de reception
+	*
+	* @return : /
+	*/
+	void rx_batch_del(rx_batch_t *b);
+
+
+	/*
+	* rx_batch_recv : Recoit d'un coup tous les messages deja arrives, dans la
+	* limite de la taille de l'anneau. Sans MSG_DONTWAIT, attend le premier.
+	* Leurs datagrammes sont ensuite donnes un par un par rx_batch_next.
+	*
+	* @b : l'anneau de reception
+	* @flags : options de reception supplementaires (MSG_DONTWAIT)
+	*
+	* @return : le nombre de messages recus
+	*           -1 en cas d'erreur (errno est conserve)
+	*/
+	int rx_batch_recv(rx_batch_t *b, int flags);
+
+
+	/*
+	* rx_batch_next : Donne le prochain datagramme du dernier rx_batch_recv, en
+	* decoupant les trains
+	*
+	* @b : l'anneau de reception
+	* @len : la vraie taille du datagramme, qui depasse celle du buffer s'il a
+	* ete coupe
+	*
+	* @return : le buffer du datagramme, ou NULL s'il n'en reste plus
+	*/
+	uint8_t* rx_batch_next(rx_batch_t *b, size_t *len);
+
+
+	/*
+	* rx_batch_addr : Donne l'adresse de l'emetteur du dernier datagramme donne
+	* par rx_batch_next
+	*
+	* @b : l'anneau de reception
+	* @len : la taille de l'adresse
+	*
+	* @return : l'adresse de l'emetteur
+	*/
+	struct sockaddr* rx_batch_addr(rx_batch_t *b, socklen_t *len);
+
+
+	/*
+	* event_loop_new : Cree une boucle d'evenements. SIGINT et SIGTERM sont
+	* bloques et recus par la boucle, qui s'arrete alors en erreur.
+	*
+	* @ctx : le contexte passe a tous les callbacks
+	* @avant_attente : appele avant chaque attente, pour faire le travail pret
+	* et armer l'echeance suivante avec event_loop_timer
+	* @echeance : appele quand l'echeance armee expire
+	*
+	* @return : une nouvelle boucle ou NULL en cas d'erreur
+	*/
+	event_loop_t* event_loop_new(void *ctx, event_cb_t avant_attente, event_cb_t echeance);
+
+
+	/*
+	* event_loop_del : Libere une boucle d'evenements et debloque les signaux
+	*
+	* @l : la boucle d'evenements
+	*
+	* @return : /
+	*/
+	void event_loop_del(event_loop_t *l);
+
+
+	/*
+	* event_loop_add : Surveille un descripteur en lecture
+	*
+	* @l : la boucle d'evenements
+	* @fd : le descripteur
+	* @front : 1 pour n'etre prevenu que quand le descripteur redevient lisible
+	* (EPOLLET), 0 tant qu'il reste lisible
+	* @lisible : appele quand le descripteur est lisible
+	*
+	* @return : 0 si le descripteur est surveille
+	*           -1 en cas d'erreur (EPERM : fichier regulier, toujours lisible)
+	*/
+	int event_loop_add(event_loop_t *l, int fd, int front, event_cb_t lisible);
+
+
+	/*
+	* event_loop_timer : Arme l'echeance de la boucle. Une echeance deja armee
+	* plus tot est gardee : le callback d'echeance doit accepter un reveil
+	* anticipe.
+	*
+	* @l : la boucle d'evenements
+	* @timeout_us : le temps avant l'echeance en microsecondes, ou -1 s'il n'y
+	* en a aucune
+	*
+	* @return : 0 si tout s'est bien deroule
+	*           -1 en cas d'erreur
+	*/
+	int event_loop_timer(event_loop_t *l, int64_t timeout_us);
+
+
+	/*
+	* event_loop_run : Fait tourner la boucle jusqu'a ce qu'un callback
+	* l'arrete, qu'une erreur survienne ou qu'un signal soit recu
+	*
+	* @l : la boucle d'evenements
+	*
+	* @return : 0 si un callback a arrete la boucle
+	*           -1 en cas d'erreur ou de signal
+	*/
+	int event_loop_run(event_loop_t *l);
+
+
+	/*
+	* io_ring_new : Cree un anneau io_uring. Une operation dont le buffer est
+	* dans la region enregistree evite au noyau de re-mapper ses pages.
+	*
+	* @profondeur : le nombre d'operations preparees avant une soumission
+	* @region : la zone a enregistrer (le slab de paquets), ou NULL
+	* @taille : la taille de la zone
+	*
+	* @return : un nouvel anneau, ou NULL si io_uring n'est pas disponible
+	*/
+	io_ring_t* io_ring_new(unsigned profondeur, void *region, size_t taille);
+
+
+	/*
+	* io_ring_del : Libere un anneau. Les operations doivent etre terminees.
+	*
+	* @r : l'anneau
+	*
+	* @return : /
+	*/
+	void io_ring_del(io_ring_t *r);
+
+
+	/*
+	* io_ring_fd : Donne le descripteur de l'anneau, lisible (epoll) quand des
+	* operations sont terminees
+	*
+	* @r : l'anneau
+	*
+	* @return : le descripteur
+	*/
+	int io_ring_fd(const io_ring_t *r);
+
+
+	/*
+	* io_ring_en_vol : Donne le nombre d'operations preparees pas encore
+	* recoltees
+	*
+	* @r : l'anneau
+	*
+	* @return : le nombre d'operations
+	*/
+	unsigned io_ring_en_vol(const io_ring_t *r);
+
+
+	/*
+	* io_ring_read : Prepare la lecture d'un fichier a une position donnee.
+	* Elle part a la prochaine soumission.
+	*
+	* @r : l'anneau
+	* @fd : le fichier
+	* @buf : la destination
+	* @len : le nombre d'octets a lire
+	* @offset : la position dans le fichier
+	* @tag : rendu au callback a la fin de la lecture
+	*
+	* @return : 0 si la lecture est preparee
+	*           -1 en cas d'erreur
+	*/
+	int io_ring_read(io_ring_t *r, int fd, void *buf, unsigned len, uint64_t offset, void *tag);
+
+
+	/*
+	* io_ring_write : Prepare l'ecriture d'un fichier a une position donnee.
+	* Elle part a la prochaine soumission.
+	*
+	* @r : l'anneau
+	* @fd : le fichier
+	* @buf : les donnees, a garder intactes jusqu'a la fin de l'ecriture
+	* @len : le nombre d'octets a ecrire
+	* @offset : la position dans le fichier
+	* @tag : rendu au callback a la fin de l'ecriture
+	*
+	* @return : 0 si l'ecriture est preparee
+	*           -1 en cas d'erreur
+	*/
+	int io_ring_write(io_ring_t *r, int fd, const void *buf, unsigned len, uint64_t offset, void *tag);
+
+
+	/*
+	* io_ring_writev : Prepare l'ecriture de plusieurs buffers a la suite
+	* dans un fichier, a partir d'une position donnee. Elle part a la
+	* prochaine soumission.
+	*
+	* @r : l'anneau
+	* @fd : le fichier
+	* @iov : les buffers, a garder intacts (comme le tableau) jusqu'a la fin
+	* de l'ecriture
+	* @nb : le nombre de buffers
+	* @offset : la position dans le fichier
+	* @tag : rendu au callback a la fin de l'ecriture
+	*
+	* @return : 0 si l'ecriture est preparee
+	*           -1 en cas d'erreur
+	*/
+	int io_ring_writev(io_ring_t *r, int fd, const struct iovec *iov, int nb, uint64_t offset, void *tag);
+
+
+	/*
+	* io_ring_submit : Soumet au noyau, en un appel systeme, toutes les
+	* operations preparees
+	*
+	* @r : l'anneau
+	*
+	* @return : 0 si tout s'est bien deroule
+	*           -1 en cas d'erreur
+	*/
+	int io_ring_submit(io_ring_t *r);
+
+
+	/*
+	* io_ring_reap : Recolte les operations terminees et appelle le callback
+	* pour chacune
+	*
+	* @r : l'anneau
+	* @cb : le callback de fin d'operation
+	* @ctx : le contexte passe au callback
+	* @attendre : 1 pour soumettre et attendre qu'au moins une operation se
+	* termine s'il en reste en vol
+	*
+	* @return : le nombre d'operations recoltees
+	*           -1 en cas d'erreur ou si un callback a renvoye -1
+	*/
+	int io_ring_reap(io_ring_t *r, io_cb_t cb, void *ctx, int attendre);
+
+
+
+	/*
+	* crc_init : Choisit les moteurs de checksum. Avec materiel, le processeur
+	* est interroge (cpuid) : PCLMULQDQ pour CRC32, SSE4.2 pour CRC32C. Sinon,
+	* ou s'il ne les a pas, le slicing-by-8 est utilise. Sans appel, le choix
+	* materiel est fait au premier checksum.
+	*
+	* @materiel : 1 pour utiliser les instructions du processeur s'il les a
+	*
+	* @return : /
+	*/
+	void crc_init(int materiel);
+
+
+	/*
+	* crc_moteur : Donne le nom du moteur d'un checksum
+	*
+	* @csum : CSUM_CRC32 ou CSUM_CRC32C
+	*
+	* @return : le nom du moteur choisi par crc_init
+	*/
+	const char* crc_moteur(uint8_t csum);
+
+
+	/*
+	* crc32_ieee : Calcule le CRC32 IEEE 802.3, identique a crc32 de zlib
+	*
+	* @crc : le CRC des donnees precedentes (0 au depart)
+	* @buf : les donnees
+	* @len : leur taille
+	*
+	* @return : le CRC des donnees precedentes suivies de buf
+	*/
+	uint32_t crc32_ieee(uint32_t crc, const void *buf, size_t len);
+
+
+	/*
+	* crc32c : Calcule le CRC32C (Castagnoli, celui d'iSCSI et de SCTP)
+	*
+	* @crc : le CRC des donnees precedentes (0 au depart)
+	* @buf : les donnees
+	* @len : leur taille
+	*
+	* @return : le CRC des donnees precedentes suivies de buf
+	*/
+	uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+
+	/*
+	* crc_pour : Donne la fonction d'un checksum
+	*
+	* @csum : CSUM_CRC32 ou CSUM_CRC32C
+	*
+	* @return : crc32c pour CSUM_CRC32C, crc32_ieee sinon
+	*/
+	crc_fn_t crc_pour(uint8_t csum);
+
+
+	/*
+	* crc_copier : Copie des donnees en calculant leur checksum, en une seule
+	* lecture : chaque mot lu pour le CRC est ecrit tel quel dans dst
+	*
+	* @csum : CSUM_CRC32 ou CSUM_CRC32C
+	* @crc : le CRC des donnees precedentes (0 au depart)
+	* @dst : la destination, d'au moins len octets, qui ne chevauche pas src
+	* @src : les donnees
+	* @len : leur taille
+	*
+	* @return : le CRC des donnees precedentes suivies de src
+	*/
+	uint32_t crc_copier(uint8_t csum, uint32_t crc, void *dst, const void *src, size_t len);
+
+
+	/*
+	* crc32_multi : Calcule le checksum de plusieurs buffers independants en
+	* une fois : pour CRC32C, le noyau choisi par crc_init fait avancer plusieurs
+	* flux en parallele, ce qui cache la latence des instructions de chacun.
+	* CRC32 est calcule un buffer apres l'autre : le repliement PCLMULQDQ d'un
+	* buffer occupe deja toutes les multiplications du processeur.
+	*
+	* @csum : CSUM_CRC32 ou CSUM_CRC32C
+	* @bufs : les buffers
+	* @lens : leurs tailles
+	* @crcs : les CRC des donnees precedentes (0 au depart), remplaces par ceux
+	*         des donnees precedentes suivies de chaque buffer
+	* @n : le nombre de buffers
+	*
+	* @return : /
+	*/
+	void crc32_multi(uint8_t csum, const uint8_t **bufs, const size_t *lens, uint32_t *crcs, int n);
 
-	#endif
+#endif
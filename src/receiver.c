@@ -16,7 +16,6 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
-#include <sys/select.h>
 #include <sys/time.h>
 #include <sys/stat.h>
 #include <netdb.h>
@@ -28,338 +27,967 @@
 #include <zlib.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 
 #define STDIN 0
 #define STDOUT 1
 #define STDERR 2
 
+/* Nombre d'ecritures io_uring en vol, et nombre maximal de paquets
+ * consecutifs ecrits par chacune */
+#define ECRITURES_EN_VOL 8
+#define ECRITURE_PAQUETS_MAX 64
 
-struct __attribute__((__packed__)) pkt {
-  char * payload;
-  // Ne pas oublier d'inverser le sens des bits
-  uint8_t window:5; // Encode sur 5 bits
-  uint8_t tr:1; // Encode sur 1 bit
-  uint8_t type:2; // Encode sur 2 bits
-  uint8_t seqnum; // Encode sur 8 bits
-  uint16_t length; // Encode sur 16 bits
-  uint32_t timestamp; // Encode sur 32 bits (4 octets)
-  uint32_t crc1; // Encode sur 32 bits (4 octets)
-  uint32_t crc2; // Encode sur 32 bits (4 octets)
-};
-
-struct __attribute__((__packed__)) ack {
-  uint8_t window:5; // Encode sur 5 bits
-  uint8_t tr:1; // Encode sur 1 bit
-  uint8_t type:2; // Encode sur 2 bits
-  uint8_t seqnum; // Encode sur 8 bits
-  uint16_t length; // Encode sur 16 bits
-  uint32_t timestamp; // Encode sur 32 bits (4 octets)
-  uint32_t crc1; // Encode sur 32 bits (4 octets)
-};
+/* Nombre maximal de paquets dans l'ordre ecrits d'un seul writev */
+#define SORTIE_MAX 64
+
+/* Nombre maximal de datagrammes decodes ensemble, dont les checksums sont
+ * calcules en un seul appel (pkt_view_decode_batch) */
+#define DECODAGE_MAX 64
 
 
 /*
-* main : Fonction principale
-*
+* Ecriture io_uring en vol : des paquets consecutifs ecrits d'un seul writev
 */
-int main(int argc, char *argv[]) {
+typedef struct {
+  struct iovec iov[ECRITURE_PAQUETS_MAX];
+  pkt_t *paquets[ECRITURE_PAQUETS_MAX]; // Rendus au slab a la fin de l'ecriture
+  int nb; // Nombre de paquets
+  ssize_t taille; // Nombre total d'octets a ecrire
+} ecriture_t;
 
 
-  uint8_t window = MAX_WINDOW_SIZE;
-  uint8_t min_window = 0;
-  uint8_t max_window = min_window + MAX_WINDOW_SIZE;
-  int err; // Variable pour error check
+/*
+* Etat du receiver : fenetre de reception et acquittements en attente
+*/
+typedef struct {
+  int sockfd; // Socket sur lequel on recoit les donnees
+  int fd; // File descriptor sur lequel on ecrit les donnees
+  pkt_buffer_t *buffer_recept; // Paquets hors-sequence en attente d'ecriture
+  uint32_t min_window; // Prochain numero de sequence attendu
+  uint32_t fenetre; // Nombre de numeros de sequence acceptes a partir de min_window
+  int offre_ext; // 1 si l'extension de sequence est offerte au sender
+  uint8_t wscale; // Facteur d'echelle de la fenetre offert
+  int ext; // 1 des que le sender utilise l'extension
+  uint32_t premier_ext; // Premier numero de sequence recu avec l'extension
+  int offre_mss; // 1 si un payload plus grand que MAX_PAYLOAD_SIZE est offert
+  uint16_t mss; // Payload maximal accepte
+  uint16_t mss_recu; // Plus grand payload recu, renvoye au sender qui sonde le chemin
+  int sack; // 1 si les ACK portent l'option SACK
+  uint32_t recents[ACK_SACK_MAX_BLOCS]; // Derniers paquets hors sequence recus, du plus recent
+  int nb_recents;
+  int connecte; // 1 des que le HELLO du sender est recu
+  uint8_t csum; // Checksum retenu, annonce dans les ACK une fois connecte
+  ack_t *packet_ack; // Acquittement reutilise pour chaque envoi
+  ack_policy_t politique; // Quand envoyer les acquittements
+  pkt_slab_t *slab; // Paquets alloues d'un bloc une fois pour toutes et recycles
+  uint32_t timestamp; // Timestamp du dernier paquet recu, renvoye dans l'ACK
+  int socket_connecte; // 1 des que le socket est connecte au sender
+  tx_batch_t *lot; // Acquittements prets, envoyes ensemble par sendmmsg
+  rx_batch_t *rx; // Datagrammes recus ensemble par recvmmsg
+  pkt_t *packet_recv; // Slot dans lequel copier le prochain paquet qui doit attendre
+  event_loop_t *boucle; // Boucle d'evenements : socket et ACK retardes
+  io_ring_t *io; // Ecritures du fichier de sortie par io_uring, NULL sinon
+  uint64_t offset_ecriture; // Position dans le fichier de la prochaine ecriture
+  ecriture_t ecritures[ECRITURES_EN_VOL];
+  ecriture_t *ecritures_libres[ECRITURES_EN_VOL]; // Ecritures disponibles
+  int nb_ecritures_libres;
+  struct iovec sortie[SORTIE_MAX]; // Donnees dans l'ordre pas encore ecrites
+  pkt_t *sortie_paquets[SORTIE_MAX]; // Slot de chaque morceau, NULL s'il est dans un buffer de reception
+  int nb_sortie;
+  ssize_t taille_sortie; // Nombre total d'octets a ecrire
+} receiver_t;
 
-  // Vérification du nombre d'arguments
-  err = arg_check(argc, 3, 5);
-  if(err == -1){
+
+/*
+* envoyer_ack : Encode un paquet d'acquittement (ACK ou NACK) dans le lot
+* d'envoi. Il part avec le lot, au plus tard quand plus aucun paquet n'attend
+* d'etre lu.
+*
+* @lot : le lot d'envoi, sur le socket connecte au sender
+* @packet_ack : le paquet d'acquittement a envoyer
+*
+* @return : 0 si l'acquittement a ete mis dans le lot
+*           -1 en cas d'erreur
+*/
+static int envoyer_ack(tx_batch_t *lot, ack_t *packet_ack){
+
+  // Encodage du paquet directement dans le lot
+  size_t len;
+  uint8_t *buffer_encode = tx_batch_buffer(lot, &len);
+  pkt_status_code err_code = ack_encode(packet_ack, buffer_encode, &len);
+  if(err_code != PKT_OK){
+    fprintf(stderr, "Erreur encode ack\n");
     return -1;
   }
-
-  pkt_status_code err_code; // Variable pour error check avec les paquets
-  int fd = STDOUT; // File descriptor avec lequel on va écrire les données
-  int bytes_received = 1; // Nombre de bytes reçus du sender
-  //int bytes_written; // Nombre de bytes écrits à chaque itération
-  int bytes_sent; // Nombre de bytes renvoyes au sender (ack)
+  return tx_batch_push(lot, len, 0);
+}
 
 
-  pkt_t **buffer_recept = (pkt_t**) calloc(window, sizeof(pkt_t*));
-  if(buffer_recept == NULL){
-    fprintf(stderr, "Erreur malloc\n");
+/*
+* connecter : Connecte le socket au sender des son premier paquet valide : les
+* acquittements partent ensuite sans adresse, et seul le sender est ecoute
+*
+* @r : l'etat du receiver
+* @addr : l'adresse du sender
+* @addr_len : la taille de l'adresse du sender
+*
+* @return : 0 si le socket est connecte
+*           -1 en cas d'erreur
+*/
+static int connecter(receiver_t *r, struct sockaddr *addr, socklen_t addr_len){
+  if(r->socket_connecte){
+    return 0;
+  }
+  if(connect(r->sockfd, addr, addr_len) == -1){
+    perror("Erreur connect");
     return -1;
   }
+  r->socket_connecte = 1;
+  return 0;
+}
 
 
-  pkt_t * packet_recv = pkt_new();
-  ack_t * packet_ack = ack_new();
+/*
+* preparer_ack : Remplit le header et les options d'extension d'un
+* acquittement. La fenetre n'est a l'echelle wscale que si l'ACK porte son
+* numero de sequence sur 32 bits.
+*
+* @r : l'etat du receiver
+* @type : PTYPE_ACK ou PTYPE_NACK
+* @seqnum : le numero de sequence a acquitter
+* @seq32 : 1 si le numero de sequence est connu sur 32 bits
+*
+* @return : /
+*/
+static void preparer_ack(receiver_t *r, ptypes_t type, uint32_t seqnum, int seq32){
+  uint32_t libre = r->fenetre - buffer_taille(r->buffer_recept);
+  if(seq32 && r->ext){
+    libre >>= r->wscale;
+  }
+  r->packet_ack->type = type;
+  r->packet_ack->seqnum = seqnum;
+  r->packet_ack->window = libre > MAX_WINDOW_SIZE ? MAX_WINDOW_SIZE : libre;
+  r->packet_ack->timestamp = r->timestamp;
+  ack_set_ext(r->packet_ack, r->offre_ext, r->wscale, seq32 && r->ext);
+  ack_set_mss(r->packet_ack, r->offre_mss, r->mss, r->mss_recu);
+  ack_set_hello(r->packet_ack, 0, 0, r->connecte ? r->csum : 0);
+}
 
-  // Prise en compte des arguments en ligne de commande
-  int a = 1;
-  char* hostname;
-  int host_set = 0;
-  char* port;
-  for(; a < argc; a++){
-    if(strcmp(argv[a], "-f") == 0){
-      a++;
-      printf("Ecriture dans le fichier %s\n", argv[a]);
-      fd = open(argv[a], O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
-      if(fd == -1){
-        perror("Erreur open fichier destination");
-        return -1;
-      }
+
+/*
+* noter_recent : Retient un paquet hors sequence recu, pour l'annoncer dans
+* les premiers blocs SACK des prochains ACK. Un paquet qui prolonge le bloc
+* du precedent le remplace.
+*
+* @r : l'etat du receiver
+* @seqnum : le numero de sequence du paquet
+*
+* @return : /
+*/
+static void noter_recent(receiver_t *r, uint32_t seqnum){
+  if(r->nb_recents > 0 && r->recents[0] + 1 == seqnum){
+    r->recents[0] = seqnum;
+    return;
+  }
+  if(r->nb_recents < ACK_SACK_MAX_BLOCS){
+    r->nb_recents++;
+  }
+  memmove(r->recents + 1, r->recents, (r->nb_recents - 1) * sizeof(uint32_t));
+  r->recents[0] = seqnum;
+}
+
+
+/*
+* acquitter : Envoie l'acquittement cumulatif du prochain numero de sequence
+* attendu, suivi des paquets deja recus au-dela du trou
+*
+* @r : l'etat du receiver
+* @seqnum : le numero de sequence a acquitter
+* @sack : 1 si l'ACK peut porter l'option SACK
+*
+* @return : 0 si l'acquittement a ete envoye
+*           -1 en cas d'erreur
+*/
+static int acquitter(receiver_t *r, uint32_t seqnum, int sack){
+  preparer_ack(r, PTYPE_ACK, seqnum, 1);
+  sack_bloc_t blocs[ACK_SACK_MAX_BLOCS];
+  int nb_blocs = 0;
+  if(sack && r->sack){
+    nb_blocs = sack_blocs(r->buffer_recept, r->min_window, r->recents, r->nb_recents, blocs);
+  }
+  ack_set_sack(r->packet_ack, sack && r->sack, blocs, nb_blocs);
+  ack_policy_on_sent(&r->politique);
+  return envoyer_ack(r->lot, r->packet_ack);
+}
+
+
+/*
+* accepter_hello : Retient, parmi les options du receiver, celles que le
+* sender accepte d'apres son paquet de connexion. Les ACK suivants portent le
+* resultat et le checksum retenu, qui confirme au sender la reception du HELLO.
+*
+* @r : l'etat du receiver
+* @hello : le paquet de connexion decode
+*
+* @return : /
+*/
+static void accepter_hello(receiver_t *r, const ack_t *hello){
+  if(!(hello->csum & CSUM_CRC32)){
+    fprintf(stderr, "Aucun checksum commun avec le sender, HELLO ignoré\n");
+    return;
+  }
+  r->csum = hello->csum & CSUM_CRC32C ? CSUM_CRC32C : CSUM_CRC32;
+  r->connecte = 1;
+  r->sack = r->sack || hello->sack_ok;
+  // La fenetre ne change plus une fois l'extension en place. Elle n'est
+  // agrandie que si les ACK sont selectifs : sans SACK, les pertes ne se
+  // reparent pas sur toute la fenetre.
+  if(r->offre_ext && !r->ext){
+    if(!hello->has_wscale || !r->sack){
+      r->offre_ext = 0;
     }
-    else if(host_set == 0){
-      hostname = argv[a];
-      printf("Hostname : %s\n", hostname);
-      host_set = 1;
+    else if(hello->wscale < r->wscale){
+      r->wscale = hello->wscale;
     }
-    else{
-      port = argv[a];
-      printf("Port : %s\n", port);
+  }
+  if(r->offre_mss){
+    if(!hello->has_mss || hello->mss <= MAX_PAYLOAD_SIZE){
+      r->offre_mss = 0;
+    }
+    else if(hello->mss < r->mss){
+      r->mss = hello->mss;
     }
   }
-  if(fd == STDOUT){
-    printf("Ecriture sur la sortie standard.\n");
+  if(hello->ack_delay > 0 && hello->ack_delay < r->politique.delay){
+    r->politique.delay = hello->ack_delay;
   }
+  fprintf(stderr, "Connexion : SACK %s, extension %s, payload jusqu'à %u octets, ACK après %u us au plus, checksum %s (%s)\n",
+          r->sack ? "oui" : "non", r->offre_ext ? "oui" : "non",
+          r->offre_mss ? r->mss : MAX_PAYLOAD_SIZE, (unsigned int) r->politique.delay,
+          r->csum == CSUM_CRC32C ? "CRC32C" : "CRC32", crc_moteur(r->csum));
+}
 
-  // Création du socket
-  int sockfd; // Variable qui va contenir le file descriptor du socket
-  struct addrinfo hints, *servinfo;
-  memset(&hints, 0, sizeof(hints));
-  hints.ai_family = AF_INET6;
-  hints.ai_socktype = SOCK_DGRAM;
-  hints.ai_protocol = IPPROTO_UDP;
 
-  err = getaddrinfo(hostname, port, &hints, &servinfo);
-  if(err != 0){
-    perror("Erreur getaddrinfo");
-    close(fd);
+/*
+* ecriture_terminee : Rend au slab les paquets d'une ecriture io_uring
+* terminee
+*
+* @ctx : l'etat du receiver
+* @tag : l'ecriture
+* @res : le nombre d'octets ecrits ou -errno
+*
+* @return : 0 si tous les paquets ont ete ecrits
+*           -1 en cas d'erreur
+*/
+static int ecriture_terminee(void *ctx, void *tag, int res){
+  receiver_t *r = (receiver_t *) ctx;
+  ecriture_t *e = (ecriture_t *) tag;
+  int i;
+  for(i = 0; i < e->nb; i++){
+    pkt_slot_release(r->slab, e->paquets[i]);
+  }
+  r->ecritures_libres[r->nb_ecritures_libres++] = e;
+  if(res < 0){
+    errno = -res;
+    perror("Erreur write");
     return -1;
   }
-
-  sockfd = socket(servinfo->ai_family, servinfo->ai_socktype, servinfo->ai_protocol);
-  if(sockfd == -1){
-    perror("Erreur socket");
-    freeaddrinfo(servinfo);
-    close(fd);
+  if(res != e->taille){
+    fprintf(stderr, "Erreur write : écriture incomplète\n");
     return -1;
   }
+  return 0;
+}
 
-  err = bind(sockfd, servinfo->ai_addr, servinfo->ai_addrlen);
-  if(err == -1){
-    perror("Erreur bind");
-    freeaddrinfo(servinfo);
-    close(sockfd);
-    close(fd);
-    return -1;
+
+/*
+* ecrire_en_avance : Prepare l'ecriture de tous les paquets presents a la
+* suite de min_window, par groupes d'au plus ECRITURE_PAQUETS_MAX, chacun a
+* sa position dans le fichier. Les paquets ne retournent au slab qu'a la fin
+* de leur ecriture. Un paquet seul est ecrit depuis son slot du slab
+* enregistre.
+*
+* @r : l'etat du receiver
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur
+*/
+static int ecrire_en_avance(receiver_t *r){
+  while(get_from_buffer(r->buffer_recept, r->min_window) != NULL){
+    // Toutes les ecritures sont en vol : on attend la fin de l'une d'elles
+    while(r->nb_ecritures_libres == 0){
+      if(io_ring_reap(r->io, ecriture_terminee, r, 1) == -1){
+        return -1;
+      }
+    }
+    ecriture_t *e = r->ecritures_libres[--r->nb_ecritures_libres];
+    e->nb = 0;
+    e->taille = 0;
+    pkt_t *pkt;
+    while(e->nb < ECRITURE_PAQUETS_MAX && (pkt = get_from_buffer(r->buffer_recept, r->min_window)) != NULL){
+      retire_buffer(r->buffer_recept, r->min_window);
+      e->iov[e->nb].iov_base = (void *) pkt_get_payload(pkt);
+      e->iov[e->nb].iov_len = pkt_get_length(pkt);
+      e->paquets[e->nb++] = pkt;
+      e->taille += pkt_get_length(pkt);
+      r->min_window++;
+    }
+    int err = e->nb == 1 ? io_ring_write(r->io, r->fd, e->iov[0].iov_base, e->taille, r->offset_ecriture, e)
+                         : io_ring_writev(r->io, r->fd, e->iov, e->nb, r->offset_ecriture, e);
+    if(err == -1){
+      perror("Erreur écriture io_uring");
+      ecriture_terminee(r, e, e->taille);
+      return -1;
+    }
+    r->offset_ecriture += e->taille;
   }
+  return 0;
+}
 
-  freeaddrinfo(servinfo);
 
-  while(bytes_received > 0){
+/*
+* ecrire_sortie : Ecrit d'un seul writev les donnees dans l'ordre en attente,
+* puis rend leurs slots au slab. A appeler avant que recvmmsg ne reutilise
+* les buffers de reception.
+*
+* @r : l'etat du receiver
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur d'ecriture
+*/
+static int ecrire_sortie(receiver_t *r){
+  if(r->nb_sortie == 0){
+    return 0;
+  }
+  int err = writev(r->fd, r->sortie, r->nb_sortie) == r->taille_sortie ? 0 : -1;
+  if(err == -1){
+    perror("Erreur write");
+  }
+  int i;
+  for(i = 0; i < r->nb_sortie; i++){
+    if(r->sortie_paquets[i] != NULL){
+      pkt_slot_release(r->slab, r->sortie_paquets[i]);
+    }
+  }
+  r->nb_sortie = 0;
+  r->taille_sortie = 0;
+  return err;
+}
+
 
-    struct sockaddr_in6 sender_addr, receiver_addr;
-    socklen_t addr_len = sizeof(struct sockaddr_in6);
-    memset(&sender_addr, 0, sizeof(sender_addr));
-    memset(&receiver_addr, 0, sizeof(receiver_addr));
+/*
+* ajouter_sortie : Ajoute des donnees dans l'ordre a celles a ecrire
+*
+* @r : l'etat du receiver
+* @data : les donnees
+* @len : leur taille
+* @pkt : le slot qui les contient, rendu au slab apres l'ecriture, ou NULL
+* si elles sont dans un buffer de reception
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur d'ecriture
+*/
+static int ajouter_sortie(receiver_t *r, const void *data, size_t len, pkt_t *pkt){
+  if(r->nb_sortie == SORTIE_MAX && ecrire_sortie(r) == -1){
+    return -1;
+  }
+  r->sortie[r->nb_sortie].iov_base = (void *) data;
+  r->sortie[r->nb_sortie].iov_len = len;
+  r->sortie_paquets[r->nb_sortie++] = pkt;
+  r->taille_sortie += len;
+  return 0;
+}
 
-    // Réception des données
-    uint8_t* data_received = (uint8_t*) malloc(528);
-    bytes_received = recvfrom(sockfd, data_received, 528, 0, (struct sockaddr *) &sender_addr, &addr_len);
 
-    /*
-    if(strcmp((const char*) data_received, "") == 0){
-    break;
+/*
+* traiter_datagramme : Traite un datagramme recu : HELLO, paquet de donnees,
+* paquet tronque ou paquet de fin
+*
+* @r : l'etat du receiver
+* @data : le datagramme
+* @len : la vraie taille du datagramme
+* @vue : le paquet decode sur place, NULL pour un HELLO
+* @err_code : le resultat de son decodage
+* @addr : l'adresse de l'emetteur
+* @addr_len : la taille de l'adresse de l'emetteur
+* @a_acquitter : mis a 1 si un ACK cumulatif doit partir a la fin du lot
+*
+* @return : 0 si tout s'est bien deroule
+*           1 si le transfert est termine
+*           -1 en cas d'erreur
+*/
+static int traiter_datagramme(receiver_t *r, uint8_t *data, size_t len, const pkt_view_t *vue,
+                              pkt_status_code err_code, struct sockaddr *addr, socklen_t addr_len,
+                              int *a_acquitter){
+
+  // Paquet de connexion du sender, au format d'un ACK
+  if(len > 0 && data[0] >> 6 == PTYPE_ACK){
+    ack_t hello;
+    if(!r->connecte && ack_decode(data, len, &hello) == PKT_OK && !hello.tr){
+      if(connecter(r, addr, addr_len) == -1){
+        return -1;
+      }
+      accepter_hello(r, &hello);
+    }
+    return 0;
   }
-  */
 
+  // Le paquet a ete decode sur place par socket_lisible : le payload n'est
+  // copie que si le paquet doit attendre
+  if (err_code != PKT_OK || vue->type != PTYPE_DATA){
+    fprintf(stderr, "Paquet ignoré\n");
+    return 0;
+  }
+  // CRC2 laisse a la copie : le paquet est copie et verifie avant d'etre
+  // pris en compte
+  if(vue->a_verifier && pkt_from_view(r->packet_recv, vue) != PKT_OK){
+    fprintf(stderr, "Paquet ignoré\n");
+    return 0;
+  }
 
+  if(connecter(r, addr, addr_len) == -1){
+    return -1;
+  }
+  // Les acquittements renvoient le timestamp du dernier paquet recu
+  r->timestamp = vue->timestamp;
+  // Un paquet complet est arrive : le chemin laisse passer sa taille
+  if(vue->tr == 0 && len > 16 && len - 16 > r->mss_recu){
+    r->mss_recu = len - 16;
+  }
 
-  // Decodage du buffer recu sur le reseau
-  const size_t len = 528;
+  // Numero de sequence sur 32 bits : transmis tel quel avec l'extension,
+  // sinon deduit de ses 8 bits de poids faible
+  uint32_t seqnum_recv;
+  if(vue->ext){
+    if(!r->offre_ext){
+      fprintf(stderr, "Paquet ignoré\n");
+      return 0;
+    }
+    seqnum_recv = vue->seqnum;
+    // Une sonde du sender porte un numero deja acquitte : elle ne marque
+    // pas le passage a l'extension
+    if(!r->ext && vue->tr == 0 && !seq_lt(seqnum_recv, r->min_window)){
+      r->ext = 1;
+      r->premier_ext = seqnum_recv;
+      r->fenetre = MAX_WINDOW_SIZE << r->wscale;
+      fprintf(stderr, "Le sender utilise l'extension de séquence\n");
+    }
+  }
+  else{
+    // Les paquets en vol quand le sender a adopte l'extension restent sur
+    // 8 bits, mais tous precedent premier_ext : une fois ce numero atteint,
+    // un paquet sur 8 bits n'est plus qu'un doublon
+    if(r->ext && !seq_lt(r->min_window, r->premier_ext)){
+      return 0;
+    }
+    seqnum_recv = seq_unwrap8(r->min_window, vue->seqnum);
+    if(r->ext && !seq_lt(seqnum_recv, r->premier_ext)){
+      return 0;
+    }
+  }
 
-  err_code = pkt_decode(data_received, len, packet_recv);
+  // Si le paquet recu est tronque, on renvoie un paquet de type NACK au sender
+  if (vue->tr == 1){
 
-  free(data_received);
+    // Un paquet etendu tronque a perdu ses 32 bits : le NACK ne porte que
+    // les 8 bits du header, le sender le retrouve s'il n'y a pas d'ambiguite
+    if(vue->ext || seq_in_window(seqnum_recv, r->min_window, r->fenetre)){
+      fprintf(stderr, "Paquet tronqué !\n");
+      preparer_ack(r, PTYPE_NACK, seqnum_recv, 0);
+      ack_set_sack(r->packet_ack, 0, NULL, 0);
+      return envoyer_ack(r->lot, r->packet_ack);
+    }
+    return 0;
+  }
 
-  if (err_code != PKT_OK){
-    printf("Paquet ignoré\n");
+  // Fin du transfert : paquet vide portant le dernier numero acquitte. Il
+  // est toujours acquitte immediatement.
+  if(vue->length == 0){
+    if(seqnum_recv != r->min_window){
+      // Il manque encore des donnees : on rappelle ce qu'on attend
+      return acquitter(r, r->min_window, 1);
+    }
+    fprintf(stderr, "Déconnexion...\n");
+    if(acquitter(r, seqnum_recv + 1, 0) == -1){
+      return -1;
+    }
+    return 1;
   }
-  else{
 
-    if(pkt_get_length(packet_recv) == 0){
-      printf("Déconnexion...\n");
-      uint8_t seqnum_recv = pkt_get_seqnum(packet_recv);
+  // Un paquet hors sequence, un doublon ou un paquet qui comble un trou est
+  // acquitte tout de suite : le sender en a besoin pour reparer les pertes
+  int immediat = seqnum_recv != r->min_window || buffer_taille(r->buffer_recept) > 0;
+  // Fenetre pleine : le sender ne peut plus rien envoyer avant cet ACK
+  if(r->politique.pending + 1 >= r->fenetre){
+    immediat = 1;
+  }
 
-      window = window - err;
-      packet_ack->seqnum = seqnum_recv+1;
-      packet_ack->window = window;
+  // Les paquets hors de la fenetre de reception (doublons deja ecrits) sont
+  // ignores, mais on les acquitte a nouveau au cas ou l'ACK s'est perdu.
+  if(seq_in_window(seqnum_recv, r->min_window, r->fenetre) &&
+     get_from_buffer(r->buffer_recept, seqnum_recv) == NULL){
 
-      uint8_t * buffer_encode = (uint8_t *)malloc(16*sizeof(uint8_t));
-      if (buffer_encode == NULL){
-        fprintf(stderr, "Erreur malloc : buffer_encode\n");
+    // Paquet attendu : ses donnees sont ecrites depuis le buffer de
+    // reception, sans copie, suivies des paquets hors sequence qu'il
+    // debloque. Avec io_uring, l'ecriture survit au buffer : on copie.
+    if(seqnum_recv == r->min_window && r->io == NULL){
+      if(ajouter_sortie(r, vue->payload, vue->length, NULL) == -1){
         return -1;
       }
-
-      size_t len_buffer_encode = 16;
-
-      // Encodage du paquet a envoyer sur le reseau
-      err_code =  ack_encode(packet_ack, buffer_encode, len_buffer_encode);
-      if(err_code != PKT_OK){
-        free(packet_ack);
-        close(sockfd);
-        close(fd);
+      r->min_window++;
+      pkt_t *pkt;
+      while((pkt = get_from_buffer(r->buffer_recept, r->min_window)) != NULL){
+        retire_buffer(r->buffer_recept, r->min_window);
+        if(ajouter_sortie(r, pkt_get_payload(pkt), pkt_get_length(pkt), pkt) == -1){
+          return -1;
+        }
+        r->min_window++;
+      }
+    }
+    else{
+      // Ajout du paquet au buffer de reception : le buffer devient
+      // proprietaire de sa copie, on copiera le suivant dans un nouveau slot
+      pkt_t *packet_recv = r->packet_recv;
+      if(!vue->a_verifier && pkt_from_view(packet_recv, vue) != PKT_OK){
+        fprintf(stderr, "Paquet ignoré\n");
+        return 0;
+      }
+      pkt_set_seqnum(packet_recv, seqnum_recv);
+      if(ajout_buffer(packet_recv, r->buffer_recept) != 0){
+        fprintf(stderr, "Le buffer est plein :/\n");
+        return 0;
+      }
+      r->packet_recv = pkt_slot_acquire(r->slab);
+      if(r->packet_recv == NULL){
         return -1;
       }
+      if(seqnum_recv != r->min_window){
+        noter_recent(r, seqnum_recv);
+      }
 
-      // Envoi du ack sur le reseau
-      bytes_sent = sendto(sockfd, (void *)buffer_encode, len_buffer_encode, 0, (struct sockaddr *) &sender_addr, addr_len);
-      if(bytes_sent < 0){
-        perror("Erreur send ack");
-        close(sockfd);
-        close(fd);
+      // Ecriture de tous les paquets disponibles dans l'ordre
+      if(r->io != NULL && ecrire_en_avance(r) == -1){
         return -1;
       }
+    }
+  }
+  else{
+    immediat = 1;
+  }
+
+  // Acquittement cumulatif, eventuellement retarde pour en regrouper plusieurs.
+  // Avec SACK, un seul ACK en fin de lot decrit tous les trous. Sans SACK,
+  // le sender compte les doublons : chaque paquet hors sequence a le sien.
+  if(ack_policy_on_data(&r->politique, immediat, time_now_us())){
+    if(immediat && !r->sack){
+      return acquitter(r, r->min_window, 1);
+    }
+    *a_acquitter = 1;
+  }
+  return 0;
+}
 
-      free(buffer_encode);
 
-      break;
+/*
+* socket_lisible : Traite d'un coup tous les datagrammes deja arrives, puis
+* decide de l'acquittement cumulatif pour tout le lot
+*
+* @ctx : l'etat du receiver
+*
+* @return : 0 pour continuer
+*           1 quand le transfert est termine
+*           -1 en cas d'erreur
+*/
+static int socket_lisible(void *ctx){
+  receiver_t *r = (receiver_t *) ctx;
 
+  if(rx_batch_recv(r->rx, MSG_DONTWAIT) < 0){
+    if(errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK){
+      return 0;
     }
+    perror("Erreur recvmmsg");
+    return -1;
+  }
 
-    uint8_t seqnum_recv = pkt_get_seqnum(packet_recv);
+  int a_acquitter = 0;
+  uint8_t *datas[DECODAGE_MAX];
+  size_t lens[DECODAGE_MAX];
+  struct sockaddr *addrs[DECODAGE_MAX];
+  socklen_t addr_lens[DECODAGE_MAX];
+  int vues_index[DECODAGE_MAX];
+  const uint8_t *a_decoder[DECODAGE_MAX];
+  size_t lens_decoder[DECODAGE_MAX];
+  pkt_view_t vues[DECODAGE_MAX];
+  pkt_status_code codes[DECODAGE_MAX];
+  int n;
+  do{
+    // Les paquets de donnees du lot sont decodes ensemble, les HELLO a part.
+    // Un HELLO accepte au milieu du lot ne change pas le checksum des paquets
+    // qui le suivent : le sender ne l'apprend que par notre ACK.
+    int nb_vues = 0;
+    uint8_t *data;
+    n = 0;
+    while(n < DECODAGE_MAX && (data = rx_batch_next(r->rx, &lens[n])) != NULL){
+      datas[n] = data;
+      addrs[n] = rx_batch_addr(r->rx, &addr_lens[n]);
+      vues_index[n] = -1;
+      if(lens[n] == 0 || data[0] >> 6 != PTYPE_ACK){
+        vues_index[n] = nb_vues;
+        a_decoder[nb_vues] = data;
+        lens_decoder[nb_vues++] = lens[n];
+      }
+      n++;
+    }
+    // Avec io_uring, toutes les donnees sont copiees avant d'etre ecrites :
+    // leur CRC2 est verifie pendant la copie
+    pkt_view_decode_batch(a_decoder, lens_decoder, nb_vues, pkt_get_capacite(r->packet_recv),
+                          CSUM_CRC32 | r->csum, r->io != NULL, vues, codes);
+
+    int i;
+    for(i = 0; i < n; i++){
+      int v = vues_index[i];
+      int fin = traiter_datagramme(r, datas[i], lens[i], v >= 0 ? &vues[v] : NULL,
+                                   v >= 0 ? codes[v] : E_TYPE, addrs[i], addr_lens[i], &a_acquitter);
+      if(fin != 0){
+        if(fin == 1 && ecrire_sortie(r) == -1){
+          return -1;
+        }
+        return fin;
+      }
+    }
+  } while(n == DECODAGE_MAX);
+  // Les donnees dans l'ordre pointent dans les buffers de reception : elles
+  // sont ecrites avant le prochain recvmmsg
+  if(ecrire_sortie(r) == -1){
+    return -1;
+  }
+  if(a_acquitter){
+    return acquitter(r, r->min_window, 1);
+  }
+  return 0;
+}
 
-    // Teste si le numero de sequence est dans la fenetre
-    int val = in_window(seqnum_recv, min_window, max_window);
 
-    // Si le paquet reçu n'est pas dans la fenêtre de réception, on l'ignore
-    if (val == -1){
-      return -1;
-    }
-    else{
+/*
+* echeance : Envoie l'ACK retarde si son echeance est atteinte (le reveil
+* peut etre anticipe)
+*
+* @ctx : l'etat du receiver
+*
+* @return : 0 pour continuer, -1 en cas d'erreur
+*/
+static int echeance(void *ctx){
+  receiver_t *r = (receiver_t *) ctx;
+  if(ack_policy_timeout(&r->politique, time_now_us()) == 0){
+    return acquitter(r, r->min_window, 1);
+  }
+  return 0;
+}
 
-      // Si le paquet recu est tronque
-      // On renvoie un paquet de type NACK au sender
-      if (pkt_get_tr(packet_recv) == 1){
 
-        printf("Paquet tronqué !\n");
+/*
+* avant_attente : Envoie les acquittements du lot avant que la boucle ne
+* dorme, et arme l'echeance de l'ACK retarde
+*
+* @ctx : l'etat du receiver
+*
+* @return : 0 pour continuer, -1 en cas d'erreur
+*/
+static int avant_attente(void *ctx){
+  receiver_t *r = (receiver_t *) ctx;
+  // La socket est lisible tant qu'il reste des datagrammes : on ne dort
+  // qu'une fois tout traite, et les ACK du lot partent ensemble. Les
+  // ecritures du lot partent de meme.
+  if(r->io != NULL && io_ring_submit(r->io) == -1){
+    return -1;
+  }
+  if(tx_batch_flush(r->lot) == -1){
+    return -1;
+  }
+  return event_loop_timer(r->boucle, ack_policy_timeout(&r->politique, time_now_us()));
+}
 
-        ack_t * packet_nack = ack_new();
-        packet_nack->type = PTYPE_NACK;
-        packet_nack->tr = 0;
-        packet_nack->window = window;
-        packet_nack->seqnum = seqnum_recv;
-        packet_nack->length = 0;
 
-        uint8_t * buffer_encode = (uint8_t *)malloc(12*sizeof(uint8_t));
-        if (buffer_encode == NULL){
-          fprintf(stderr, "Erreur malloc : buffer_encode\n");
-          return -1;
-        }
+/*
+* ecritures_terminees : Des ecritures io_uring du fichier de sortie sont
+* terminees
+*
+* @ctx : l'etat du receiver
+*
+* @return : 0 pour continuer, -1 en cas d'erreur
+*/
+static int ecritures_terminees(void *ctx){
+  receiver_t *r = (receiver_t *) ctx;
+  return io_ring_reap(r->io, ecriture_terminee, r, 0) == -1 ? -1 : 0;
+}
 
-        size_t len_buffer_encode = 12;
 
-        // Encodage du paquet a envoyer sur le reseau
-        int return_code =  ack_encode(packet_nack, buffer_encode, len_buffer_encode);
-        if(return_code != PKT_OK){
-          free(packet_nack);
-          close(sockfd);
-          close(fd);
-          return -1;
-        }
+/*
+* main : Fonction principale
+*
+*/
+int main(int argc, char *argv[]) {
 
-        bytes_sent = sendto(sockfd, (void *)buffer_encode, len_buffer_encode, 0, (struct sockaddr *) &sender_addr, addr_len);
-        if (bytes_sent == -1){
-          free(packet_nack);
-          free(buffer_encode);
-          close(sockfd);
-          close(fd);
-          return -1;
-        }
+  int err; // Variable pour error check
+
+  // Vérification du nombre d'arguments
+  err = arg_check(argc, 3, 14);
+  if(err == -1){
+    return -1;
+  }
+
+  receiver_t r;
+  memset(&r, 0, sizeof(r));
+  r.fd = STDOUT; // File descriptor avec lequel on va écrire les données
+  r.min_window = 0;
+  r.fenetre = MAX_WINDOW_SIZE;
+  r.mss = MAX_PAYLOAD_SIZE;
+  crc_init(1);
+
+
+
+  // Prise en compte des arguments en ligne de commande
+  int a = 1;
+  char* hostname = NULL;
+  int host_set = 0;
+  char* port = NULL;
+  uint32_t ack_every = ACK_EVERY;
+  uint64_t ack_delay = ACK_DELAY_US;
+  for(; a < argc; a++){
+    if(strcmp(argv[a], "-f") == 0 && a + 1 < argc){
+      a++;
+      fprintf(stderr, "Ecriture dans le fichier %s\n", argv[a]);
+      r.fd = open(argv[a], O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+      if(r.fd == -1){
+        perror("Erreur open fichier destination");
+        return -1;
+      }
+    }
+    else if(strcmp(argv[a], "-s") == 0){
+      // SACK meme sans HELLO : le sender doit comprendre les ACK avec options
+      r.sack = 1;
+      fprintf(stderr, "Acquittements selectifs (SACK) actives\n");
+    }
+    else if(strcmp(argv[a], "-W") == 0 && a + 1 < argc){
+      // Offre de l'extension : numeros de sequence sur 32 bits et fenetre
+      // jusqu'a MAX_WINDOW_SIZE << wscale paquets
+      a++;
+      int wscale = atoi(argv[a]);
+      if(wscale < 0 || wscale > WSCALE_MAX){
+        fprintf(stderr, "Facteur d'echelle invalide : %s (0 a %d)\n", argv[a], WSCALE_MAX);
+        return -1;
+      }
+      r.offre_ext = 1;
+      r.wscale = wscale;
+    }
+    else if(strcmp(argv[a], "-M") == 0 && a + 1 < argc){
+      // Offre d'un payload jusqu'a n octets : le sender sonde le chemin pour
+      // trouver la plus grande taille qui passe
+      a++;
+      int mss = atoi(argv[a]);
+      if(mss < MAX_PAYLOAD_SIZE || mss > MSS_MAX){
+        fprintf(stderr, "Taille de payload invalide : %s (%d a %d)\n", argv[a], MAX_PAYLOAD_SIZE, MSS_MAX);
+        return -1;
+      }
+      r.offre_mss = 1;
+      r.mss = mss;
+    }
+    else if(strcmp(argv[a], "-a") == 0 && a + 1 < argc){
+      // Un ACK tous les n paquets recus dans l'ordre
+      a++;
+      long every;
+      if(arg_entier(argv[a], 1, UINT32_MAX, &every) == -1){
+        fprintf(stderr, "Nombre de paquets par ACK invalide : %s\n", argv[a]);
+        return -1;
+      }
+      ack_every = every;
+    }
+    else if(strcmp(argv[a], "-d") == 0 && a + 1 < argc){
+      // Delai maximal avant d'acquitter, en microsecondes (0 : ACK immediat)
+      a++;
+      long delay;
+      if(arg_entier(argv[a], 0, LONG_MAX, &delay) == -1){
+        fprintf(stderr, "Delai d'acquittement invalide : %s\n", argv[a]);
+        return -1;
       }
+      ack_delay = delay;
+    }
+    else if(host_set == 0){
+      hostname = argv[a];
+      fprintf(stderr, "Hostname : %s\n", hostname);
+      host_set = 1;
+    }
+    else{
+      port = argv[a];
+      fprintf(stderr, "Port : %s\n", port);
+    }
+  }
+  if(r.fd == STDOUT){
+    fprintf(stderr, "Ecriture sur la sortie standard.\n");
+  }
+  uint32_t fenetre_max = MAX_WINDOW_SIZE;
+  if(r.offre_ext){
+    fenetre_max = MAX_WINDOW_SIZE << r.wscale;
+    fprintf(stderr, "Extension de séquence offerte, fenêtre jusqu'à %u paquets\n", fenetre_max);
+  }
+  // Au-dela de la fenetre, le sender attendrait l'ACK sans rien pouvoir
+  // envoyer, et un delai plus long ferait expirer ses timers
+  if(ack_every > fenetre_max){
+    fprintf(stderr, "Un ACK par fenêtre au plus : %u paquets\n", fenetre_max);
+    ack_every = fenetre_max;
+  }
+  if(ack_delay > ACK_DELAY_MAX_US){
+    fprintf(stderr, "Délai d'acquittement ramené à %u us\n", (unsigned int) ACK_DELAY_MAX_US);
+    ack_delay = ACK_DELAY_MAX_US;
+  }
+  ack_policy_init(&r.politique, ack_every, ack_delay);
+  fprintf(stderr, "Un ACK tous les %u paquets, au plus tard après %u us\n", r.politique.every, (unsigned int) r.politique.delay);
+  if(r.offre_mss){
+    fprintf(stderr, "Payload jusqu'à %u octets offert\n", r.mss);
+  }
 
-      else { // Si le paquet recu n'est pas tronque
-
-      // Ajout du buffer au buffer de reception
-      if(buffer_plein(buffer_recept) == 0){
-        ajout_buffer(packet_recv, buffer_recept, min_window);
-        window--;
-        err = write_buffer(fd, buffer_recept, &min_window, &max_window);
-        if (err == -1){
-          free(packet_ack);
-          close(sockfd);
-          close(fd);
-          return -1;
-        }
-        window = window - err;
+  r.buffer_recept = pkt_buffer_new(fenetre_max + 1);
+  if(r.buffer_recept == NULL){
+    fprintf(stderr, "Erreur malloc\n");
+    return -1;
+  }
 
-        packet_ack->seqnum = seqnum_recv+1;
 
+  // Tous les paquets de la fenetre sont alloues des le depart, ainsi que
+  // ceux des ecritures en vol : en regime etabli, la reception ne fait plus
+  // aucune allocation
+  r.slab = pkt_slab_new(fenetre_max + 1 + ECRITURES_EN_VOL * ECRITURE_PAQUETS_MAX, r.mss);
+  if(r.slab == NULL){
+    fprintf(stderr, "Erreur de création des paquets\n");
+    return -1;
+  }
+  r.packet_recv = pkt_slot_acquire(r.slab);
+  r.packet_ack = ack_new();
+  if(r.packet_recv == NULL || r.packet_ack == NULL){
+    fprintf(stderr, "Erreur de création des paquets\n");
+    return -1;
+  }
 
-        packet_ack->window = window;
 
+  // Création du socket
+  struct addrinfo hints, *servinfo;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET6;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_protocol = IPPROTO_UDP;
 
-        uint8_t * buffer_encode = (uint8_t *)malloc(16*sizeof(uint8_t));
-        if (buffer_encode == NULL){
-          fprintf(stderr, "Erreur malloc : buffer_encode\n");
-          return -1;
-        }
+  err = getaddrinfo(hostname, port, &hints, &servinfo);
+  if(err != 0){
+    fprintf(stderr, "Erreur getaddrinfo : %s\n", gai_strerror(err));
+    close(r.fd);
+    return -1;
+  }
 
-        size_t len_buffer_encode = 16;
+  r.sockfd = socket(servinfo->ai_family, servinfo->ai_socktype, servinfo->ai_protocol);
+  if(r.sockfd == -1){
+    perror("Erreur socket");
+    freeaddrinfo(servinfo);
+    close(r.fd);
+    return -1;
+  }
 
-        // Encodage du paquet a envoyer sur le reseau
-        err_code =  ack_encode(packet_ack, buffer_encode, len_buffer_encode);
-        if(err_code != PKT_OK){
-          free(packet_ack);
-          close(sockfd);
-          close(fd);
-          return -1;
-        }
+  err = bind(r.sockfd, servinfo->ai_addr, servinfo->ai_addrlen);
+  if(err == -1){
+    perror("Erreur bind");
+    freeaddrinfo(servinfo);
+    close(r.sockfd);
+    close(r.fd);
+    return -1;
+  }
 
-        // Envoi du ack sur le reseau
-        bytes_sent = sendto(sockfd, (void *)buffer_encode, len_buffer_encode, 0, (struct sockaddr *) &sender_addr, addr_len);
-        if(bytes_sent < 0){
-          perror("Erreur send ack");
-          close(sockfd);
-          close(fd);
-          return -1;
-        }
+  freeaddrinfo(servinfo);
 
-        // Retrait du buffer encode du buffer de reception
-        int err_retire_buffer = retire_buffer(buffer_recept, packet_ack->seqnum);
-        if (err_retire_buffer == -1){
-          fprintf(stderr, "Erreur retire buffer\n");
-          close(sockfd);
-          close(fd);
-          return -1;
-        }
+  // Avec de grands paquets, le buffer par defaut du socket ne contient plus
+  // toute une fenetre : on en demande un a sa taille (le noyau peut le borner)
+  if(r.offre_mss){
+    int rcvbuf = (int) (fenetre_max * (r.mss + 16));
+    setsockopt(r.sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  }
+
+  int ret = 0;
+  // Les trains de datagrammes (UDP_GRO) sont decoupes avant le decodage
+  r.rx = rx_batch_new(r.sockfd, RX_BATCH_MAX, (size_t) r.mss + 16, 1);
+  r.lot = tx_batch_new(r.sockfd, TX_BATCH_MAX, 12 + MAX_ACK_PAYLOAD_SIZE + 4, 0);
+  if(r.rx == NULL || r.lot == NULL){
+    fprintf(stderr, "Erreur malloc\n");
+    close(r.sockfd);
+    return -1;
+  }
 
-        free(buffer_encode);
-        strcpy(packet_recv->payload, "");
-        memset(packet_ack, 0, 12);
-        packet_ack->type = PTYPE_ACK;
+  // Un fichier regulier est ecrit par io_uring, s'il est disponible. En mode
+  // ajout, la position de chaque ecriture serait ignoree.
+  struct stat st;
+  if(fstat(r.fd, &st) == 0 && S_ISREG(st.st_mode) && !(fcntl(r.fd, F_GETFL) & O_APPEND)){
+    size_t taille_region;
+    void *region = pkt_slab_region(r.slab, &taille_region);
+    r.io = io_ring_new(ECRITURES_EN_VOL, region, taille_region);
+    if(r.io != NULL){
+      for(; r.nb_ecritures_libres < ECRITURES_EN_VOL; r.nb_ecritures_libres++){
+        r.ecritures_libres[r.nb_ecritures_libres] = &r.ecritures[r.nb_ecritures_libres];
       }
+      off_t debut = lseek(r.fd, 0, SEEK_CUR);
+      r.offset_ecriture = debut > 0 ? (uint64_t) debut : 0;
+      fprintf(stderr, "Ecriture du fichier par io_uring\n");
+    }
+  }
 
-      else{ // Le buffer est plein
-        printf("Le buffer est plein :/\n");
-        break;
+  // Boucle de reception : chaque reveil traite les datagrammes arrives ou
+  // l'echeance d'un ACK retarde
+  r.boucle = event_loop_new(&r, avant_attente, echeance);
+  if(r.boucle == NULL || event_loop_add(r.boucle, r.sockfd, 0, socket_lisible) == -1 ||
+     (r.io != NULL && event_loop_add(r.boucle, io_ring_fd(r.io), 0, ecritures_terminees) == -1)){
+    fprintf(stderr, "Erreur de création de la boucle d'événements\n");
+    close(r.sockfd);
+    return -1;
+  }
+  ret = event_loop_run(r.boucle);
+  event_loop_del(r.boucle);
+
+  if(r.io != NULL){
+    // Le transfert n'est termine qu'une fois toutes les ecritures faites
+    while(io_ring_en_vol(r.io) > 0){
+      unsigned en_vol = io_ring_en_vol(r.io);
+      if(io_ring_reap(r.io, ecriture_terminee, &r, 1) == -1){
+        ret = -1;
+        if(io_ring_en_vol(r.io) == en_vol){
+          break;
+        }
       }
     }
+    lseek(r.fd, (off_t) r.offset_ecriture, SEEK_SET);
+    io_ring_del(r.io);
   }
-}
-}
 
-pkt_del(packet_recv);
-free(packet_ack);
+  // Le dernier lot contient l'acquittement de fin
+  if(tx_batch_flush(r.lot) == -1){
+    ret = -1;
+  }
+  tx_batch_del(r.lot);
 
-free(buffer_recept);
+  buffer_vider(r.buffer_recept, r.slab);
+  if(r.packet_recv != NULL){
+    pkt_slot_release(r.slab, r.packet_recv);
+  }
+  pkt_slab_del(r.slab);
+  free(r.packet_ack);
+  rx_batch_del(r.rx);
 
-close(sockfd);
-if(fd != 1){
-  close(fd);
-}
+  pkt_buffer_del(r.buffer_recept);
+
+  close(r.sockfd);
+  if(r.fd != STDOUT){
+    close(r.fd);
+  }
 
-printf("Fin de la transmission.\n");
-return 0;
+  if(ret == 0){
+    fprintf(stderr, "Fin de la transmission.\n");
+  }
+  return ret;
 
 }
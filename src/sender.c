@@ -15,7 +15,6 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
-#include <sys/select.h>
 #include <sys/time.h>
 #include <sys/stat.h>
 #include <netdb.h>
@@ -28,515 +27,1647 @@
 #include <errno.h>
 #include <time.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#ifdef SO_TXTIME
+#include <linux/net_tstamp.h>
+#endif
 
 #define STDIN 0
 #define STDOUT 1
 #define STDERR 2
 
+/* Nombre maximal de timers traites a chaque reveil */
+#define MAX_TIMERS_EXPIRES 256
 
-struct __attribute__((__packed__)) pkt {
-  char * payload;
-  // Ne pas oublier d'inverser le sens des bits
-  uint8_t window:5; // Encode sur 5 bits
-  uint8_t tr:1; // Encode sur 1 bit
-  uint8_t type:2; // Encode sur 2 bits
-  uint8_t seqnum; // Encode sur 8 bits
-  uint16_t length; // Encode sur 16 bits
-  uint32_t timestamp; // Encode sur 32 bits (4 octets)
-  uint32_t crc1; // Encode sur 32 bits (4 octets)
-  uint32_t crc2; // Encode sur 32 bits (4 octets)
-};
+/* Nombre de renvois du paquet de deconnexion avant d'abandonner */
+#define MAX_RENVOIS_DECONNEXION 10
 
+/* Nombre d'envois du HELLO sans reponse avant de considerer que le receiver
+ * ne le comprend pas */
+#define MAX_HELLO 4
 
-struct __attribute__((__packed__)) ack {
-  uint8_t window:5; // Encode sur 5 bits
-  uint8_t tr:1; // Encode sur 1 bit
-  uint8_t type:2; // Encode sur 2 bits
-  uint8_t seqnum; // Encode sur 8 bits
-  uint16_t length; // Encode sur 16 bits
-  uint32_t timestamp; // Encode sur 32 bits (4 octets)
-  uint32_t crc1; // Encode sur 32 bits (4 octets)
-};
+/* Nombre d'ACK dupliques qui declenchent un renvoi rapide */
+#define SEUIL_DUPACKS 3
+
+/* Taille d'un paquet de donnees sur le reseau, avant negociation */
+#define TAILLE_PAQUET (MAX_PAYLOAD_SIZE + 16)
+
+/* Nombre de sondes d'une meme taille sans reponse avant d'y renoncer */
+#define MAX_SONDES 3
+/* La recherche de la taille des paquets s'arrete a cette precision, en octets */
+#define SONDE_PRECISION 64
+
+/* Nombre de lectures du fichier d'entree en vol avec io_uring */
+#define LECTURES_EN_AVANCE 32
+/* Resultat d'une lecture io_uring pas encore terminee */
+#define LECTURE_EN_COURS INT_MIN
 
 
 /*
-* main : Fonction principale
-*
+* Etat de l'emetteur : fenetre d'envoi et paquets en vol
 */
-int main(int argc, char *argv[]) {
+typedef struct {
+  int sockfd; // Socket vers le receiver
+  int fd; // File descriptor sur lequel on lit les donnees
+  struct addrinfo *servinfo; // Adresse du receiver
+  pkt_buffer_t *buffer_envoi; // Paquets envoyes et pas encore acquittes
+  uint32_t min_window; // Plus petit numero de sequence non acquitte
+  uint32_t seqnum; // Prochain numero de sequence a utiliser
+  uint32_t window; // Taille de la fenetre annoncee par le receiver
+  uint32_t fenetre_max; // Nombre maximal de paquets en vol
+  uint32_t capacite; // Puissance de 2 > fenetre_max : taille des tables par seqnum
+  int offre_ext; // 1 si on accepte l'extension de sequence
+  uint8_t wscale_max; // Facteur d'echelle maximal accepte
+  int ext; // 1 si l'extension de sequence est en place
+  uint8_t wscale; // Facteur d'echelle de la fenetre du receiver
+  uint16_t mss_max; // Plus grand payload que l'on accepte d'envoyer
+  uint16_t mss; // Payload des nouveaux paquets, deja passe sur le chemin
+  uint16_t sonde_plafond; // Plus grand payload encore possible, 0 avant negociation
+  uint16_t sonde_taille; // Payload de la sonde en vol, 0 si aucune
+  int sonde_essais; // Nombre de sondes de cette taille parties sans reponse
+  int sonde_echecs; // Nombre de tailles abandonnees
+  uint32_t sonde_ts; // Timestamp de la derniere sonde envoyee
+  uint64_t sonde_echeance; // Heure a laquelle la sonde est consideree perdue
+  int connecte; // 1 des que le receiver a repondu au HELLO
+  int offre_crc32c; // 1 si le HELLO propose CRC32C
+  uint8_t csum; // Checksum des paquets de donnees, retenu par le receiver
+  int nb_hello; // Nombre de HELLO envoyes
+  int en_vol; // Nombre de paquets envoyes et non acquittes
+  int nb_dupacks; // Nombre d'ACK consecutifs n'acquittant rien de nouveau
+  uint32_t ts_renvoi_rapide; // Timestamp du dernier renvoi rapide
+  int sack_actif; // 1 des que le receiver envoie l'option SACK
+  uint8_t *sacke; // 1 si le paquet a ete acquitte selectivement, par seqnum % capacite
+  uint32_t *saut; // Pour un paquet acquitte selectivement : un numero de sequence
+                  // plus loin, tous ceux d'entre eux l'etant aussi
+  int nb_sackes; // Nombre de paquets en vol acquittes selectivement
+  uint32_t plus_hauts[SEUIL_DUPACKS]; // Plus grands numeros acquittes selectivement, decroissants
+  int nb_plus_hauts;
+  uint32_t prochain_perte; // Les paquets avant lui ont deja ete renvoyes sur indication SACK
+  int fin_lecture; // 1 si on a lu toute l'entree
+  int entree_vide; // 1 si l'entree (pipe, terminal) n'a plus de donnees pretes
+  int fin_envoyee; // 1 des que le paquet de fin est parti
+  uint32_t seq_fin; // Numero de sequence du paquet de fin
+  int renvois_fin; // Nombre de renvois du paquet de fin
+  timer_wheel_t *timers; // Timer de retransmission de chaque paquet en vol, par seqnum
+  uint64_t report; // Aucun timer n'expire avant : dernier ACK qui progresse + RTO
+  uint64_t report_trou; // Idem pour les paquets apres le trou : dernier ACK duplique + RTO
+  rtt_t rtt; // Estimation du RTT et timeout de retransmission
+  cc_t cc; // Controle de congestion
+  pacer_t pacer; // Espacement des envois au debit cwnd/SRTT
+  uint64_t rate_socket; // Dernier debit maximal annonce au noyau (SO_MAX_PACING_RATE)
+  int txtime; // 1 si les heures de depart sont confiees au noyau (SO_TXTIME)
+  uint32_t nb_envoyes; // Nombre total de nouveaux paquets envoyes
+  uint32_t nb_acquittes; // Nombre total de paquets acquittes
+  tx_batch_t *lot; // Datagrammes prets, envoyes ensemble par sendmmsg
+  uint8_t *buffer_encode; // Buffer d'encodage des sondes, pour un paquet de mss_max
+  size_t taille_encode; // Taille maximale d'un datagramme encode
+  char *buffer_lecture; // Payload des sondes de MTU, de mss_max octets
+  rx_batch_t *rx; // Acquittements recus ensemble par recvmmsg
+  ack_t *ack_recu; // Acquittement decode, reutilise pour chaque ACK recu
+  event_loop_t *boucle; // Boucle d'evenements : socket, entree et echeances
+  pkt_slab_t *slab; // Paquets alloues d'un bloc une fois pour toutes et recycles
+  io_ring_t *io; // Lectures du fichier d'entree en avance par io_uring, NULL sinon
+  pkt_t *lectures[LECTURES_EN_AVANCE]; // Paquets dans lesquels le fichier est lu, dans l'ordre
+  int lu[LECTURES_EN_AVANCE]; // Octets lus dans chaque paquet, -errno ou LECTURE_EN_COURS
+  int premiere_lecture; // Indice de la plus ancienne lecture
+  int nb_lectures; // Nombre de lectures soumises et pas encore envoyees
+  uint64_t offset_lecture; // Position dans le fichier de la prochaine lecture
+  int fin_fichier; // 1 des qu'une lecture a atteint la fin du fichier
+  const char *projection; // Fichier d'entree projete en memoire, NULL sinon
+  size_t taille_projection; // Taille du fichier projete
+  size_t position; // Prochain octet du fichier projete a envoyer
+} sender_t;
 
-  int err; // Variable pour error check
 
-  // Vérification du nombre d'arguments
-  err = arg_check(argc, 3, 5);
-  if(err == -1){
-    return -1;
+/*
+* maj_pacing : Recalcule le debit de pacing et, s'il a assez change, le
+* transmet au noyau comme debit maximal du socket
+*
+* @s : l'etat de l'emetteur
+*
+* @return : /
+*/
+static void maj_pacing(sender_t *s){
+  uint64_t rate = pacer_set_rate(&s->pacer, &s->cc, &s->rtt);
+#ifdef SO_MAX_PACING_RATE
+  // Un appel systeme par ACK serait trop cher : on ne met a jour le noyau que
+  // si le debit a varie de plus de 1/8
+  uint64_t ecart = rate > s->rate_socket ? rate - s->rate_socket : s->rate_socket - rate;
+  if(rate != 0 && ecart > s->rate_socket / 8){
+    setsockopt(s->sockfd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate));
+    s->rate_socket = rate;
   }
+#endif
+}
 
-  int fd = STDIN; // File descriptor avec lequel on va lire les données
-  int bytes_read; // Nombre de bytes lus sur l'entrée standard / le fichier source
-  int bytes_sent; // Nombre de bytes envoyés au receiver
-  int bytes_received; // Nombre de bytes reçus du receiver
-  pkt_status_code err_code; // Variable pour error check avec les paquets
-
-  uint8_t window = MAX_WINDOW_SIZE;
-  uint8_t min_window = 0;
-  uint8_t max_window = min_window + MAX_WINDOW_SIZE;
 
-  uint8_t seqnum = 0;
+/*
+* envoyer_paquets : Horodate, encode et envoie des paquets sur le reseau, puis
+* arme leurs timers de retransmission. Leurs checksums sont calcules
+* ensemble (pkt_encode_batch).
+*
+* @s : l'etat de l'emetteur
+* @pkts : les paquets a envoyer
+* @departs : l'heure de depart de chaque paquet, fixee par le pacer
+* @n : le nombre de paquets, au plus tx_batch_place
+*
+* @return : 0 si les paquets ont ete envoyes
+*           -1 en cas d'erreur
+*/
+static int envoyer_paquets(sender_t *s, pkt_t **pkts, const uint64_t *departs, int n){
+  uint8_t *bufs[TX_BATCH_MAX];
+  size_t lens[TX_BATCH_MAX];
+  size_t headers[TX_BATCH_MAX];
+  int sg = 1;
+  int i;
+
+  for(i = 0; i < n; i++){
+    // Le timestamp est l'heure d'envoi, renvoyee telle quelle dans l'ACK.
+    // Un renvoi prend le checksum retenu depuis le premier envoi.
+    if(pkt_set_timestamp(pkts[i], (uint32_t) departs[i]) != PKT_OK ||
+       pkt_set_csum(pkts[i], s->csum) != PKT_OK){
+      fprintf(stderr, "Erreur set_timestamp\n");
+      return -1;
+    }
+    // Les paquets sont encodes directement dans le lot d'envoi. On n'envoie
+    // que les octets encodes : header, payload et CRC2 eventuel
+    bufs[i] = tx_batch_buffer_at(s->lot, i, &lens[i]);
+    sg = sg && pkt_has_payload_ref(pkts[i]);
+  }
 
+  // Des payloads restes dans le fichier projete : seuls les headers et les
+  // CRC2 sont encodes, le noyau lit les donnees a leur place
+  pkt_status_code err_code;
+  if(sg){
+    err_code = pkt_encode_sg_batch((const pkt_t **) pkts, n, bufs, lens, headers);
+  }
+  else{
+    err_code = pkt_encode_batch((const pkt_t **) pkts, n, bufs, lens);
+  }
+  if(err_code != PKT_OK){
+    fprintf(stderr, "Erreur encode\n");
+    return -1;
+  }
 
-  // Prise en compte des arguments en ligne de commande
-  int a = 1;
-  char* hostname;
-  int host_set = 0;
-  char* port;
-  for(; a < argc; a++){
-    if(strcmp(argv[a], "-f") == 0){
-      a++;
-      printf("Lecture dans le fichier %s\n", argv[a]);
-      fd = open(argv[a], O_RDONLY);
-      if(fd == -1){
-        perror("Erreur open fichier source");
+  // Avec SO_TXTIME, le datagramme porte son heure de depart et c'est le
+  // noyau qui le retient
+  for(i = 0; i < n; i++){
+    if(sg){
+      if(tx_batch_push_sg(s->lot, lens[i], headers[i], pkt_get_payload(pkts[i]), pkt_get_length(pkts[i]), departs[i]) == -1){
         return -1;
       }
     }
-    else if(host_set == 0){
-      hostname = argv[a];
-      printf("Hostname : %s\n", hostname);
-      host_set = 1;
-    }
-    else{
-      port = argv[a];
-      printf("Port : %s\n", port);
+    else if(tx_batch_push(s->lot, lens[i], departs[i]) == -1){
+      return -1;
     }
+    timer_arm(s->timers, pkt_get_seqnum(pkts[i]), departs[i] + s->rtt.rto);
   }
-  if(fd == STDIN){
-    printf("Lecture sur l'entrée standard.\n");
-  }
+  return 0;
+}
 
-  // Création du socket
-  int sockfd; // Variable qui va contenir le file descriptor du socket
-  struct addrinfo hints, *servinfo;
-  memset(&hints, 0, sizeof(hints));
-  hints.ai_family = AF_INET6;
-  hints.ai_socktype = SOCK_DGRAM;
-  hints.ai_protocol = IPPROTO_UDP;
 
-  err = getaddrinfo(hostname, port, &hints, &servinfo);
-  if(err != 0){
-    perror("Erreur getaddrinfo");
+/*
+* envoyer_paquet : Horodate, encode et envoie un paquet sur le reseau, puis
+* arme son timer de retransmission
+*
+* @s : l'etat de l'emetteur
+* @pkt : le paquet a envoyer
+* @depart : l'heure de depart du paquet, fixee par le pacer (au plus tot maintenant)
+*
+* @return : 0 si le paquet a ete envoye
+*           -1 en cas d'erreur
+*/
+static int envoyer_paquet(sender_t *s, pkt_t *pkt, uint64_t depart){
+  return envoyer_paquets(s, &pkt, &depart, 1);
+}
+
+
+/*
+* envoyer_hello : Envoie le paquet de connexion, qui annonce au receiver ce
+* que le sender accepte. Les donnees partent aussitot apres, sans attendre de
+* reponse : le receiver repond dans ses acquittements.
+*
+* @s : l'etat de l'emetteur
+*
+* @return : 0 si le paquet a ete envoye
+*           -1 en cas d'erreur
+*/
+static int envoyer_hello(sender_t *s){
+  ack_t hello;
+  memset(&hello, 0, sizeof(hello));
+  uint64_t now = time_now_us();
+  hello.type = PTYPE_ACK;
+  hello.seqnum = s->seqnum;
+  hello.timestamp = (uint32_t) now;
+  ack_set_ext(&hello, s->offre_ext, s->wscale_max, 0);
+  ack_set_mss(&hello, s->mss_max > MAX_PAYLOAD_SIZE, s->mss_max, 0);
+  ack_set_hello(&hello, 1, ACK_DELAY_MAX_US, CSUM_CRC32 | (s->offre_crc32c ? CSUM_CRC32C : 0));
+
+  size_t len;
+  uint8_t *buf = tx_batch_buffer(s->lot, &len);
+  if(ack_encode(&hello, buf, &len) != PKT_OK){
+    fprintf(stderr, "Erreur encode\n");
     return -1;
   }
+  s->nb_hello++;
+  return tx_batch_push(s->lot, len, now);
+}
 
-  sockfd = socket(servinfo->ai_family, servinfo->ai_socktype, servinfo->ai_protocol);
-  if(sockfd == -1){
-    perror("Erreur socket");
-    freeaddrinfo(servinfo);
-    return -1;
+
+/*
+* fenetre_ouverte : Verifie si l'emetteur peut mettre un nouveau paquet en vol
+*
+* @s : l'etat de l'emetteur
+*
+* @return : 1 si un nouveau paquet peut etre envoye, 0 sinon
+*/
+static int fenetre_ouverte(sender_t *s){
+  // On ne peut avoir en vol plus que min(cwnd, fenetre du receiver). Chaque
+  // ACK duplique (ou paquet acquitte selectivement) signale un paquet sorti
+  // du reseau : il ne compte plus dans cwnd
+  int dans_reseau = s->en_vol - (s->sack_actif ? s->nb_sackes : s->nb_dupacks);
+  if((uint32_t) s->en_vol >= s->fenetre_max || dans_reseau >= (int) cc_cwnd(&s->cc)){
+    return 0;
   }
+  // Si le receiver annonce une fenetre nulle, on garde un seul paquet en vol
+  // pour sonder la fenetre et ne pas rester bloque.
+  if(s->window == 0){
+    return s->en_vol == 0;
+  }
+  return (uint32_t) s->en_vol < s->window;
+}
 
 
-  pkt_t* packet = pkt_new();
-  if(packet == NULL){
-    fprintf(stderr, "Erreur de création du paquet \n");
-    return -1;
+/*
+* lire_en_avance : Prepare des lectures du fichier d'entree jusqu'a en avoir
+* LECTURES_EN_AVANCE en vol, chacune directement dans le payload d'un paquet
+* du slab. Le paquet prend le format du moment : lu avant l'adoption de
+* l'extension de sequence, il part au format 8 bits, avant les paquets
+* etendus.
+*
+* @s : l'etat de l'emetteur
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur
+*/
+static int lire_en_avance(sender_t *s){
+  uint16_t taille = s->mss - (s->ext ? SEQ_EXT_SIZE : 0);
+  while(!s->fin_fichier && s->nb_lectures < LECTURES_EN_AVANCE){
+    pkt_t *packet = pkt_slot_acquire(s->slab);
+    if(packet == NULL){
+      fprintf(stderr, "Erreur de création du paquet \n");
+      return -1;
+    }
+    int i = (s->premiere_lecture + s->nb_lectures) % LECTURES_EN_AVANCE;
+    if(io_ring_read(s->io, s->fd, pkt_payload_buffer(packet), taille, s->offset_lecture, &s->lu[i]) == -1){
+      perror("Erreur lecture io_uring");
+      pkt_slot_release(s->slab, packet);
+      return -1;
+    }
+    // La longueur demandee permet de reconnaitre une lecture ecourtee
+    pkt_set_length(packet, taille);
+    pkt_set_ext(packet, s->ext);
+    s->lectures[i] = packet;
+    s->lu[i] = LECTURE_EN_COURS;
+    s->offset_lecture += taille;
+    s->nb_lectures++;
   }
+  return 0;
+}
 
-  ack_t* ack_received = ack_new();
-  if(ack_received == NULL){
-    fprintf(stderr, "Erreur de création du paquet d'acquittement \n");
+
+/*
+* lecture_prete : Prend la plus ancienne lecture du fichier d'entree si elle
+* est terminee : le paquet contient deja ses donnees
+*
+* @s : l'etat de l'emetteur
+* @packet : le paquet lu
+*
+* @return : le nombre d'octets lus
+*           0 si la lecture est en cours (entree_vide) ou si tout le fichier
+*           a ete lu (fin_lecture)
+*           -1 en cas d'erreur
+*/
+static int lecture_prete(sender_t *s, pkt_t **packet){
+  int i = s->premiere_lecture;
+  if(s->nb_lectures == 0){
+    s->fin_lecture = 1;
+    return 0;
+  }
+  int res = s->lu[i];
+  if(res == LECTURE_EN_COURS){
+    s->entree_vide = 1;
+    return 0;
+  }
+  *packet = s->lectures[i];
+  s->premiere_lecture = (i + 1) % LECTURES_EN_AVANCE;
+  s->nb_lectures--;
+  if(res < 0){
+    errno = -res;
+    perror("Erreur read");
+    pkt_slot_release(s->slab, *packet);
     return -1;
   }
-
-  pkt_t ** buffer_envoi = (pkt_t **) malloc(MAX_WINDOW_SIZE*sizeof(pkt_t*));
-  if (buffer_envoi == NULL){
-    fprintf(stderr, "Erreur malloc : buffer_envoi\n");
+  // Sur un fichier regulier, seule la fin du fichier ecourte une lecture :
+  // les lectures deja soumises apres elle ne liront rien
+  if(res < pkt_get_length(*packet)){
+    s->fin_fichier = 1;
+  }
+  if(res == 0){
+    pkt_slot_release(s->slab, *packet);
+    s->fin_lecture = 1;
+    return 0;
+  }
+  pkt_set_length(*packet, res);
+  if(lire_en_avance(s) == -1){
+    pkt_slot_release(s->slab, *packet);
     return -1;
   }
+  return res;
+}
 
-  int sret; // Variable de retour de la fonction select;
-  struct timeval tv;
-  fd_set readfds;
 
-  while(1){
+/*
+* projeter_entree : Projette en memoire le fichier d'entree, a partir de sa
+* position courante. Les paquets designent ensuite leur part de la
+* projection au lieu de la copier. Le fichier ne doit pas etre tronque
+* pendant l'envoi.
+*
+* @s : l'etat de l'emetteur
+*
+* @return : 0 si le fichier est projete
+*           -1 s'il est vide ou ne peut pas etre projete
+*/
+static int projeter_entree(sender_t *s){
+  struct stat st;
+  off_t debut = lseek(s->fd, 0, SEEK_CUR);
+  if(debut < 0 || fstat(s->fd, &st) == -1 || st.st_size <= debut){
+    return -1;
+  }
+  void *projection = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, s->fd, 0);
+  if(projection == MAP_FAILED){
+    return -1;
+  }
+  // Le fichier est lu une seule fois, du debut a la fin
+  madvise(projection, st.st_size, MADV_SEQUENTIAL);
+  s->projection = (const char *) projection;
+  s->taille_projection = st.st_size;
+  s->position = debut;
+  return 0;
+}
 
-    while(in_window(seqnum, min_window, max_window) == -1){
-      fprintf(stderr, "Numéro de séquence hors de la fenêtre d'envoi\n");
-      seqnum_inc(&seqnum);
-    }
 
-    char * payload_buf = (char*) malloc(MAX_PAYLOAD_SIZE*sizeof(char));
-    if (payload_buf == NULL){
-      fprintf(stderr, "Erreur malloc : payload_buf\n");
-      return -1;
-    }
-    uint8_t * ack_buffer = (uint8_t*) malloc(12);
-    if(ack_buffer == NULL){
-      fprintf(stderr, "Erreur malloc : ack_buffer\n");
-      return -1;
-    }
+/*
+* lecture_terminee : Note le resultat d'une lecture io_uring terminee
+*
+* @ctx : l'etat de l'emetteur
+* @tag : l'emplacement du resultat de la lecture
+* @res : le nombre d'octets lus ou -errno
+*
+* @return : 0
+*/
+static int lecture_terminee(void *ctx, void *tag, int res){
+  *(int *) tag = res;
+  ((sender_t *) ctx)->entree_vide = 0;
+  return 0;
+}
 
-    bytes_read = read(fd, payload_buf, MAX_PAYLOAD_SIZE);
-    if(bytes_read == -1){
-      perror("Erreur read");
-      free(payload_buf);
-      free(ack_buffer);
-      return -1;
-    }
 
-    // Déconnexion
-    else if(bytes_read == 0){
+/*
+* envoyer_donnees : Lit l'entree et envoie de nouveaux paquets tant que la
+* fenetre le permet
+*
+* @s : l'etat de l'emetteur
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur
+*/
+static int envoyer_donnees(sender_t *s){
 
-      printf("Déconnexion...\n");
+  // Les nouveaux paquets sont encodes par lots, autant que le lot d'envoi
+  // peut en prendre avant de partir
+  pkt_t *lot[TX_BATCH_MAX];
+  uint64_t departs[TX_BATCH_MAX];
+  int nb_lot = 0;
 
-      //bytes_sent = sendto(sockfd, "", 1, 0, servinfo->ai_addr, servinfo->ai_addrlen);
+  while(!s->fin_lecture && !s->entree_vide && fenetre_ouverte(s)){
 
-      uint8_t seqnum_end = seqnum + 1;
+    // Sans SO_TXTIME, c'est a nous d'attendre l'heure de depart du paquet
+    if(!s->txtime && pacer_delay(&s->pacer, time_now_us()) > 0){
+      break;
+    }
 
-      err_code = pkt_set_seqnum(packet, seqnum);
-      if(err_code != PKT_OK){
-        fprintf(stderr, "Erreur set_seqnum\n");
+    pkt_t* packet;
+    int bytes_read;
+    if(s->projection != NULL){
+      // Le paquet designe sa part du fichier projete, sans la copier
+      size_t reste = s->taille_projection - s->position;
+      if(reste == 0){
+        s->fin_lecture = 1;
+        break;
+      }
+      bytes_read = s->mss - (s->ext ? SEQ_EXT_SIZE : 0);
+      if(reste < (size_t) bytes_read){
+        bytes_read = (int) reste;
+      }
+      packet = pkt_slot_acquire(s->slab);
+      if(packet == NULL){
+        fprintf(stderr, "Erreur de création du paquet \n");
         return -1;
       }
-
-      err_code = pkt_set_length(packet, 0);
-      if(err_code != PKT_OK){
-        fprintf(stderr, "Erreur set_length\n");
+      if(pkt_set_payload_ref(packet, s->projection + s->position, bytes_read) != PKT_OK){
+        fprintf(stderr, "Erreur set payload \n");
+        pkt_slot_release(s->slab, packet);
         return -1;
       }
-
-      uint8_t * buffer_encode = (uint8_t *)malloc(528);
-      if (buffer_encode == NULL){
-        fprintf(stderr, "Erreur malloc : buffer_encode\n");
+      s->position += bytes_read;
+    }
+    else if(s->io != NULL){
+      // Le paquet a ete lu en avance : ses donnees sont deja en place
+      bytes_read = lecture_prete(s, &packet);
+      if(bytes_read == -1){
+        return -1;
+      }
+      if(bytes_read == 0){
+        break;
+      }
+    }
+    else{
+      // Lecture directement dans le payload du paquet : l'encodage le copie
+      // ensuite dans le datagramme en calculant le CRC2 au passage
+      packet = pkt_slot_acquire(s->slab);
+      if(packet == NULL){
+        fprintf(stderr, "Erreur de création du paquet \n");
+        return -1;
+      }
+      // Le numero de sequence etendu prend place dans le payload
+      bytes_read = read(s->fd, pkt_payload_buffer(packet), s->mss - (s->ext ? SEQ_EXT_SIZE : 0));
+      if(bytes_read <= 0){
+        pkt_slot_release(s->slab, packet);
+      }
+      if(bytes_read == -1){
+        // Rien a lire pour l'instant : la boucle previent quand l'entree
+        // redevient lisible
+        if(errno == EAGAIN || errno == EWOULDBLOCK){
+          s->entree_vide = 1;
+          break;
+        }
+        perror("Erreur read");
+        return -1;
+      }
+      if(bytes_read == 0){
+        s->fin_lecture = 1;
+        break;
+      }
+      if(pkt_set_length(packet, bytes_read) != PKT_OK){
+        fprintf(stderr, "Erreur set payload \n");
+        pkt_slot_release(s->slab, packet);
         return -1;
       }
+    }
 
-      size_t len_buffer_encode = 528;
+    // Un paquet lu en avance garde le format de sa lecture
+    if(pkt_set_seqnum(packet, s->seqnum) != PKT_OK ||
+       (s->io == NULL && pkt_set_ext(packet, s->ext) != PKT_OK)){
+      fprintf(stderr, "Erreur set payload \n");
+      pkt_slot_release(s->slab, packet);
+      return -1;
+    }
 
-      // Encodage du paquet a envoyer sur le reseau
-      err_code = pkt_encode(packet, buffer_encode, len_buffer_encode);
-      if(err_code != PKT_OK){
-        fprintf(stderr, "Erreur encode\n");
+    // Ajout du paquet au buffer d'envoi
+    if(ajout_buffer(packet, s->buffer_envoi) != 0){
+      fprintf(stderr, "Erreur ajout buffer\n");
+      pkt_slot_release(s->slab, packet);
+      return -1;
+    }
+    s->en_vol++;
+    s->nb_envoyes++;
+    s->seqnum++;
+
+    // Seules les nouvelles donnees sont espacees : les renvois partent tout de suite
+    uint64_t now = time_now_us();
+    uint64_t depart = pacer_on_send(&s->pacer, 12 + (pkt_get_ext(packet) ? SEQ_EXT_SIZE : 0) + bytes_read + 4, now);
+    lot[nb_lot] = packet;
+    departs[nb_lot++] = s->txtime ? depart : now;
+    if(nb_lot == tx_batch_place(s->lot)){
+      if(envoyer_paquets(s, lot, departs, nb_lot) == -1){
         return -1;
       }
+      nb_lot = 0;
+    }
+  }
+  return envoyer_paquets(s, lot, departs, nb_lot);
+}
 
 
-      bytes_sent = sendto(sockfd, (void*) buffer_encode, 528, 0, servinfo->ai_addr, servinfo->ai_addrlen);
+/*
+* renvoi_rapide : Renvoie le plus ancien paquet non acquitte sans attendre
+* l'expiration de son timer
+*
+* @s : l'etat de l'emetteur
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur
+*/
+static int renvoi_rapide(sender_t *s){
+  pkt_t* packet_renvoi = get_from_buffer(s->buffer_envoi, s->min_window);
+  if(packet_renvoi == NULL){
+    return 0;
+  }
+  fprintf(stderr, "Renvoi rapide du paquet avec numéro de séquence %u\n", s->min_window);
+  uint64_t now = time_now_us();
+  s->ts_renvoi_rapide = (uint32_t) now;
+  return envoyer_paquet(s, packet_renvoi, now);
+}
 
-      struct sockaddr_in6 receiver_addr;
-      memset(&receiver_addr, 0, sizeof(receiver_addr));
-      socklen_t addr_len = sizeof(struct sockaddr);
 
+/*
+* prochain_non_sacke : Cherche le premier paquet non acquitte selectivement a
+* partir d'un numero de sequence. Les sauts parcourus pointent ensuite
+* directement sur le resultat : chaque paquet n'est ainsi parcouru qu'un
+* petit nombre de fois, quelle que soit la longueur des blocs.
+*
+* @s : l'etat de l'emetteur
+* @seq : le numero de sequence de depart
+*
+* @return : le plus petit numero de sequence >= seq non acquitte selectivement
+*/
+static uint32_t prochain_non_sacke(sender_t *s, uint32_t seq){
+  uint32_t masque = s->capacite - 1;
+  uint32_t trouve = seq;
+  while(s->sacke[trouve & masque]){
+    trouve = s->saut[trouve & masque];
+  }
+  while(seq != trouve){
+    uint32_t suivant = s->saut[seq & masque];
+    s->saut[seq & masque] = trouve;
+    seq = suivant;
+  }
+  return trouve;
+}
 
-      FD_ZERO(&readfds);
-      FD_SET(sockfd, &readfds);
 
-      tv.tv_sec = 4;
-      tv.tv_usec = 500000;
+/*
+* marquer_sacke : Note qu'un paquet en vol a ete acquitte selectivement, et
+* le retient s'il est parmi les SEUIL_DUPACKS plus grands
+*
+* @s : l'etat de l'emetteur
+* @seq : le numero de sequence du paquet
+*
+* @return : /
+*/
+static void marquer_sacke(sender_t *s, uint32_t seq){
+  // Le receiver garde le paquet : inutile de le renvoyer a l'expiration
+  s->sacke[seq & (s->capacite - 1)] = 1;
+  s->saut[seq & (s->capacite - 1)] = seq + 1;
+  s->nb_sackes++;
+  timer_cancel(s->timers, seq);
+
+  int i = s->nb_plus_hauts;
+  if(i == SEUIL_DUPACKS){
+    if(!seq_lt(s->plus_hauts[i - 1], seq)){
+      return;
+    }
+    i--;
+  }
+  else{
+    s->nb_plus_hauts++;
+  }
+  for(; i > 0 && seq_lt(s->plus_hauts[i - 1], seq); i--){
+    s->plus_hauts[i] = s->plus_hauts[i - 1];
+  }
+  s->plus_hauts[i] = seq;
+}
 
-      sret = select(sockfd+1, &readfds, NULL, NULL, &tv);
-      while(1){
 
-        //struct timeval * rto = (struct timeval *)malloc(sizeof(struct timeval));
+/*
+* traiter_sack : Met a jour les paquets acquittes selectivement et renvoie
+* ceux qui sont consideres comme perdus : un paquet est perdu quand
+* SEUIL_DUPACKS paquets envoyes apres lui ont ete recus (RFC 6675). Plusieurs
+* trous peuvent ainsi etre repares pendant le meme RTT.
+*
+* @s : l'etat de l'emetteur
+* @ack : l'acquittement, dont les blocs sont relatifs au prochain numero de
+* sequence attendu (qui vaut s->min_window une fois l'ACK cumulatif traite)
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur
+*/
+static int traiter_sack(sender_t *s, const ack_t *ack){
+  int i;
+  for(i = 0; i < ack->nb_sack; i++){
+    // Un bloc hors des paquets en vol est ignore
+    uint32_t debut = ack->sack[i].debut;
+    uint32_t fin = debut + ack->sack[i].nb;
+    if(debut == 0 || fin > (uint32_t) s->en_vol){
+      continue;
+    }
+    uint32_t seq;
+    for(seq = prochain_non_sacke(s, s->min_window + debut); seq_lt(seq, s->min_window + fin);
+        seq = prochain_non_sacke(s, seq + 1)){
+      marquer_sacke(s, seq);
+    }
+  }
 
-        while(sret == 0){
-          //gettimeofday (rto, NULL);
-          //int temps_actuel = rto->tv_sec * 1000 + rto->tv_usec;
-          //if (pkt_get_timestamp(packet) + tv.tv_sec * 1000 + tv.tv_usec < temps_actuel) {
+  // Blocs en nombre maximal : le receiver a peut-etre recu d'autres paquets
+  // apres le trou sans pouvoir les annoncer, leurs timers sont repousses
+  if(ack->nb_sack == ACK_SACK_MAX_BLOCS){
+    s->report_trou = time_now_us() + s->rtt.rto;
+  }
 
-          printf("Renvoi du paquet de déconnexion\n");
-          bytes_sent = sendto(sockfd, (void *) buffer_encode, len_buffer_encode, 0, servinfo->ai_addr, servinfo->ai_addrlen);
-          if(bytes_sent == -1){
-            perror("Erreur sendto packet");
-            free(payload_buf);
-            pkt_del(packet);
-            close(sockfd);
-            close(fd);
-            return -1;
-          }
+  // Les paquets non acquittes selectivement avant le SEUIL_DUPACKS-ieme plus
+  // grand sont perdus. Ceux avant prochain_perte ont deja ete renvoyes.
+  if(s->nb_plus_hauts < SEUIL_DUPACKS){
+    return 0;
+  }
+  uint32_t seuil = s->plus_hauts[SEUIL_DUPACKS - 1];
+  if(seq_lt(s->prochain_perte, s->min_window)){
+    s->prochain_perte = s->min_window;
+  }
+  uint32_t seq = prochain_non_sacke(s, s->prochain_perte);
+  if(!seq_lt(seq, seuil)){
+    return 0;
+  }
 
+  cc_on_loss(&s->cc, s->nb_envoyes, time_now_us());
+  maj_pacing(s);
+  // Les trous sont repares du plus ancien au plus recent
+  for(; seq_lt(seq, seuil); seq = prochain_non_sacke(s, seq + 1)){
+    pkt_t* packet_renvoi = get_from_buffer(s->buffer_envoi, seq);
+    if(packet_renvoi == NULL){
+      continue;
+    }
+    fprintf(stderr, "Renvoi sélectif du paquet avec numéro de séquence %u\n", seq);
+    if(envoyer_paquet(s, packet_renvoi, time_now_us()) == -1){
+      return -1;
+    }
+  }
+  s->prochain_perte = seuil;
+  return 0;
+}
 
-          FD_ZERO(&readfds);
-          FD_SET(sockfd, &readfds);
 
-          tv.tv_sec = 2;
-          tv.tv_usec = 500000;
+/*
+* activer_ext : Adopte l'extension de sequence offerte par le receiver. Les
+* paquets deja en vol restent au format 8 bits.
+*
+* @s : l'etat de l'emetteur
+* @wscale : le facteur d'echelle de la fenetre du receiver
+*
+* @return : /
+*/
+static void activer_ext(sender_t *s, uint8_t wscale){
+  s->ext = 1;
+  s->wscale = wscale;
+  s->fenetre_max = MAX_WINDOW_SIZE << s->wscale_max;
+  fprintf(stderr, "Extension de séquence en place, jusqu'à %u paquets en vol\n", s->fenetre_max);
+}
 
-          sret = select(sockfd+1, &readfds, NULL, NULL, &tv);
-        }
-        //free(rto);
-
-        bytes_received = recvfrom(sockfd, ack_buffer, 528, 0, (struct sockaddr *) &receiver_addr, &addr_len);
-        if(bytes_received < 0){
-          perror("Erreur receive ACK");
-          close(sockfd);
-          close(fd);
-          return -1;
-        }
 
+/*
+* negocier_mss : Prend note du payload maximal offert par le receiver. Le
+* chemin n'en laisse peut-etre pas passer autant : les paquets gardent leur
+* taille jusqu'a ce qu'une sonde plus grande soit acquittee.
+*
+* @s : l'etat de l'emetteur
+* @mss : le payload maximal accepte par le receiver
+*
+* @return : /
+*/
+static void negocier_mss(sender_t *s, uint16_t mss){
+  s->sonde_plafond = mss < s->mss_max ? mss : s->mss_max;
+  fprintf(stderr, "Payload jusqu'à %u octets accepté, sondage du chemin\n", s->sonde_plafond);
+}
 
-        err_code = ack_decode(ack_buffer, 12, ack_received);
-        if(err_code != PKT_OK){
-          fprintf(stderr, "Erreur decode\n");
-          free(ack_received);
-          close(sockfd);
-          close(fd);
-          return -1;
-        }
 
-        printf("Seqnum de déconnexion : %u\n", seqnum_end);
-        printf("Seqnum du paquet de déconnexion : %u\n", ack_received->seqnum);
-        if(ack_received->seqnum == seqnum_end){
-          printf("Reçu ACK de déconnexion.\n");
-          break;
-        }
+/*
+* abandonner_sonde : Renonce a la taille de la sonde en cours : le chemin ne
+* laisse pas passer plus grand
+*
+* @s : l'etat de l'emetteur
+*
+* @return : /
+*/
+static void abandonner_sonde(sender_t *s){
+  s->sonde_plafond = s->sonde_taille - 1;
+  s->sonde_taille = 0;
+  s->sonde_essais = 0;
+  s->sonde_echecs++;
+}
 
-      }
 
+/*
+* confirmer_sonde : La sonde en cours est arrivee : les nouveaux paquets
+* prennent sa taille
+*
+* @s : l'etat de l'emetteur
+*
+* @return : /
+*/
+static void confirmer_sonde(sender_t *s){
+  s->mss = s->sonde_taille;
+  s->sonde_taille = 0;
+  s->sonde_essais = 0;
+  s->pacer.mss = s->mss + 16;
+  maj_pacing(s);
+  fprintf(stderr, "Le chemin laisse passer %u octets de payload\n", s->mss);
+}
 
-      free(ack_buffer);
-      free(payload_buf);
-      free(buffer_encode);
 
-      break;
+/*
+* envoyer_sonde : Envoie une sonde de la taille en cours. C'est un paquet de
+* donnees de remplissage portant un numero de sequence deja acquitte : le
+* receiver l'ignore mais renvoie dans ses ACK le plus grand payload recu.
+* Les paquets de donnees ne prennent ainsi jamais le risque d'etre trop
+* grands, et une sonde perdue n'a pas a etre renvoyee.
+*
+* @s : l'etat de l'emetteur
+* @now : l'heure d'envoi, en microsecondes
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur
+*/
+static int envoyer_sonde(sender_t *s, uint64_t now){
+  pkt_t* sonde = pkt_slot_acquire(s->slab);
+  if(sonde == NULL){
+    fprintf(stderr, "Erreur de création de la sonde \n");
+    return -1;
+  }
+  uint16_t length = s->sonde_taille - (s->ext ? SEQ_EXT_SIZE : 0);
+  memset(s->buffer_lecture, 0, length);
+  if(pkt_set_payload(sonde, s->buffer_lecture, length) != PKT_OK ||
+     pkt_set_seqnum(sonde, s->min_window - 1) != PKT_OK ||
+     pkt_set_ext(sonde, s->ext) != PKT_OK ||
+     pkt_set_csum(sonde, s->csum) != PKT_OK ||
+     pkt_set_timestamp(sonde, (uint32_t) now) != PKT_OK){
+    fprintf(stderr, "Erreur set sonde \n");
+    pkt_slot_release(s->slab, sonde);
+    return -1;
+  }
+  size_t len = s->taille_encode;
+  pkt_status_code err_code = pkt_encode(sonde, s->buffer_encode, &len);
+  pkt_slot_release(s->slab, sonde);
+  if(err_code != PKT_OK){
+    fprintf(stderr, "Erreur encode\n");
+    return -1;
+  }
 
+  // La sonde part seule, hors du lot : un refus du noyau doit lui etre attribue
+  s->sonde_ts = (uint32_t) now;
+  s->sonde_echeance = now + s->rtt.rto;
+  if(send(s->sockfd, s->buffer_encode, len, 0) == -1){
+    if(errno != EMSGSIZE){
+      perror("Erreur sendto sonde");
+      return -1;
     }
+    // Plus grand que le MTU connu du noyau : inutile d'attendre une reponse
+    fprintf(stderr, "Sonde de %u octets refusée par le noyau\n", s->sonde_taille);
+    abandonner_sonde(s);
+  }
+  return 0;
+}
 
-    // Lecture de données
-    else{
-
-      if(fd == STDIN){ // Remplacement du caractère de linefeed par le caractère de fin de string
-        int i;
-        for(i=0; i<strlen(payload_buf); i++){
-          if(*(payload_buf+i) == '\n'){
-            *(payload_buf+i) = '\0';
-            break;
-          }
-        }
-      }
-      if(*payload_buf != '\0'){ // Si on a effectivement écrit quelque chose
-        err_code = pkt_set_payload(packet, payload_buf, strlen(payload_buf));
-        if (err_code != PKT_OK){
-          fprintf(stderr, "Erreur set payload dans la boucle \n");
-          return -1;
-        }
-
-        strcpy(payload_buf, "");
 
-        err_code = pkt_set_seqnum(packet, seqnum);
-        if(err_code != PKT_OK){
-          pkt_del(packet);
-          close(sockfd);
-          close(fd);
-          return -1;
-        }
+/*
+* sonder_chemin : Cherche la plus grande taille de paquet que le chemin laisse
+* passer, a la maniere de DPLPMTUD (RFC 8899) : une sonde sans reponse apres
+* MAX_SONDES essais abaisse le plafond, une sonde acquittee releve le payload
+* des paquets. On essaie d'abord le plafond negocie, puis on procede par
+* dichotomie.
+*
+* @s : l'etat de l'emetteur
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur
+*/
+static int sonder_chemin(sender_t *s){
+  uint64_t now = time_now_us();
+  if(s->sonde_taille != 0){
+    if(now < s->sonde_echeance){
+      return 0;
+    }
+    if(++s->sonde_essais >= MAX_SONDES){
+      fprintf(stderr, "Pas de réponse aux sondes de %u octets\n", s->sonde_taille);
+      abandonner_sonde(s);
+    }
+  }
+  if(s->sonde_taille == 0){
+    // Pas de negociation, ou recherche terminee
+    if(s->sonde_plafond < s->mss + SONDE_PRECISION){
+      return 0;
+    }
+    s->sonde_taille = s->sonde_echecs == 0 ? s->sonde_plafond :
+                      s->mss + (s->sonde_plafond - s->mss + 1) / 2;
+  }
+  return envoyer_sonde(s, now);
+}
 
-        err_code = pkt_set_timestamp(packet);
-        if(err_code != PKT_OK){
-          fprintf(stderr, "Erreur set_timestamp\n");
-          return -1;
-        }
 
+/*
+* numero_ack : Retrouve le numero de sequence sur 32 bits porte par un
+* acquittement
+*
+* @s : l'etat de l'emetteur
+* @ack : l'acquittement decode
+* @seqnum : le numero de sequence retrouve
+*
+* @return : 1 si le numero de sequence a ete retrouve, 0 s'il est ambigu
+*/
+static int numero_ack(sender_t *s, const ack_t *ack, uint32_t *seqnum){
+  if(s->ext && ack->has_seq32){
+    *seqnum = ack->seqnum;
+    return 1;
+  }
+  if(s->ext && ack->type == PTYPE_NACK){
+    // NACK d'un paquet etendu tronque : seuls 8 bits sont connus, le paquet
+    // n'est identifie de facon sure que si moins de 256 paquets sont en vol
+    *seqnum = s->min_window + (uint8_t) (ack->seqnum - s->min_window);
+    return s->en_vol <= 256;
+  }
+  *seqnum = seq_unwrap8(s->min_window, (uint8_t) ack->seqnum);
+  return 1;
+}
 
-        err = seqnum_inc(&seqnum);
-        if(err == -1){
-          pkt_del(packet);
-          close(sockfd);
-          close(fd);
-          return -1;
-        }
 
-        window--;
-        err_code = pkt_set_window(packet, window);
-        if(err == -1){
-          pkt_del(packet);
-          close(sockfd);
-          close(fd);
-          return -1;
-        }
+/*
+* traiter_ack : Traite un acquittement (ou un NACK) recu du receiver
+*
+* @s : l'etat de l'emetteur
+* @ack : l'acquittement decode
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur
+*/
+static int traiter_ack(sender_t *s, ack_t *ack){
 
-        // Ajout du paquet au buffer d'envoi
-        ajout_buffer(packet, buffer_envoi, min_window);
-        uint8_t * buffer_encode = (uint8_t *)malloc(528);
-        if (buffer_encode == NULL){
-          fprintf(stderr, "Erreur malloc : buffer_encode\n");
-          return -1;
-        }
+  // Le receiver renvoie le timestamp du paquet de donnees qui a declenche
+  // l'acquittement : c'est notre heure d'envoi de ce paquet
+  uint32_t sample = (uint32_t) time_now_us() - ack->timestamp;
+  if(sample < RTO_MAX_US){
+    rtt_update(&s->rtt, sample);
+  }
+
+  // Le receiver a recu notre HELLO : il repond avec le checksum retenu
+  if(ack->csum != 0 && !s->connecte){
+    s->connecte = 1;
+    if(ack->csum == CSUM_CRC32C && s->offre_crc32c){
+      s->csum = CSUM_CRC32C;
+    }
+    fprintf(stderr, "Connexion établie, checksum %s (%s)\n", s->csum == CSUM_CRC32C ? "CRC32C" : "CRC32",
+            crc_moteur(s->csum));
+  }
 
-        size_t len_buffer_encode = 528;
+  // Le receiver offre l'extension de sequence : on l'adopte si on l'accepte.
+  // Sans SACK, les pertes ne se reparent pas sur toute la fenetre agrandie :
+  // il faut que le receiver acquitte selectivement. Sa fenetre est a
+  // l'echelle que porte chaque ACK, qui peut baisser quand il recoit notre HELLO.
+  if(ack->has_wscale && s->offre_ext && (s->ext || ack->has_sack)){
+    if(!s->ext){
+      activer_ext(s, ack->wscale);
+    }
+    s->wscale = ack->wscale;
+  }
 
-        // Encodage du paquet a envoyer sur le reseau
-        err_code = pkt_encode(packet, buffer_encode, 528);
-        if(err_code != PKT_OK){
-          fprintf(stderr, "Erreur encode\n");
-          return -1;
-        }
+  // Le receiver accepte des paquets plus grands : on sonde le chemin, et le
+  // plus grand payload qu'il a recu confirme la sonde en cours
+  if(ack->has_mss){
+    if(s->sonde_plafond == 0 && s->mss_max > MAX_PAYLOAD_SIZE && ack->mss > MAX_PAYLOAD_SIZE){
+      negocier_mss(s, ack->mss);
+    }
+    if(s->sonde_taille != 0 && ack->mss_recu >= s->sonde_taille){
+      confirmer_sonde(s);
+    }
+  }
+  // L'ACK declenche par une sonde n'acquitte rien de nouveau, sans pour
+  // autant signaler de trou
+  int ack_sonde = s->sonde_plafond != 0 && ack->timestamp == s->sonde_ts;
 
+  uint32_t ack_seq;
+  if(!numero_ack(s, ack, &ack_seq)){
+    return 0;
+  }
 
-        // Envoi du paquet sur le réseau
-        bytes_sent = sendto(sockfd, (void *) buffer_encode, len_buffer_encode, 0, servinfo->ai_addr, servinfo->ai_addrlen);
-        if(bytes_sent == -1){
-          perror("Erreur sendto packet");
-          return -1;
-        }
+  if(ack->type == PTYPE_NACK){
+    // Le paquet a ete tronque : on le renvoie directement
+    // La troncation est un signal de congestion du reseau
+    pkt_t* packet_renvoi = get_from_buffer(s->buffer_envoi, ack_seq);
+    if(packet_renvoi != NULL){
+      fprintf(stderr, "NACK : renvoi du paquet avec numéro de séquence %u\n", ack_seq);
+      cc_on_loss(&s->cc, s->nb_envoyes, time_now_us());
+      maj_pacing(s);
+      return envoyer_paquet(s, packet_renvoi, time_now_us());
+    }
+    return 0;
+  }
 
+  if(ack->type != PTYPE_ACK){
+    return 0;
+  }
 
-        struct sockaddr_in6 receiver_addr;
-        memset(&receiver_addr, 0, sizeof(receiver_addr));
-        socklen_t addr_len = sizeof(struct sockaddr);
-
-        FD_ZERO(&readfds);
-        FD_SET(sockfd, &readfds);
-
-        tv.tv_sec = 4;
-        tv.tv_usec = 500000;
-
-        sret = select(sockfd+1, &readfds, NULL, NULL, &tv);
-        while(1){
-
-          //struct timeval * rto = (struct timeval *)malloc(sizeof(struct timeval));
-
-          while(sret == 0){
-            //gettimeofday (rto, NULL);
-            //int temps_actuel = rto->tv_sec * 1000 + rto->tv_usec;
-            //if (pkt_get_timestamp(packet) + tv.tv_sec * 1000 + tv.tv_usec < temps_actuel) {
-
-            printf("Renvoi du paquet avec numéro de séquence %u\n", pkt_get_seqnum(packet));
-            bytes_sent = sendto(sockfd, (void *) buffer_encode, len_buffer_encode, 0, servinfo->ai_addr, servinfo->ai_addrlen);
-            if(bytes_sent == -1){
-              perror("Erreur sendto packet");
-              free(payload_buf);
-              pkt_del(packet);
-              close(sockfd);
-              close(fd);
-              return -1;
-            }
-
-
-            FD_ZERO(&readfds);
-            FD_SET(sockfd, &readfds);
-
-            tv.tv_sec = 2;
-            tv.tv_usec = 500000;
-
-            sret = select(sockfd+1, &readfds, NULL, NULL, &tv);
-          }
-          //free(rto);
-
-          bytes_received = recvfrom(sockfd, ack_buffer, 528, 0, (struct sockaddr *) &receiver_addr, &addr_len);
-          if(bytes_received < 0){
-            perror("Erreur receive ACK");
-            close(sockfd);
-            close(fd);
-            return -1;
-          }
-
-
-          err_code = ack_decode(ack_buffer, 12, ack_received);
-          if(err_code != PKT_OK){
-            fprintf(stderr, "Erreur decode\n");
-            free(ack_received);
-            close(sockfd);
-            close(fd);
-            return -1;
-          }
-
-          if(ack_received->type == PTYPE_ACK){
-
-            // On retire les paquets du buffer d'envoi
-            uint8_t seqnum_ack_received = ack_received->seqnum;
-            int i;
-            for(i = min_window; i <= seqnum_ack_received-1; i++){
-              int err_retire_buffer = retire_buffer(buffer_envoi, i);
-              if (err_retire_buffer == -1){
-                fprintf(stderr, "Erreur retire buffer\n");
-                free(ack_received);
-                close(sockfd);
-                close(fd);
-                return -1;
-              }
-              window++;
-              decale_window(&min_window, &max_window);
-            }
-            break;
-          }
-          else {
-            uint8_t seqnum = ack_received->seqnum;
-            pkt_t* packet_renvoi = get_from_buffer(buffer_envoi, seqnum);
-            uint8_t * buffer_encode2 = (uint8_t *)malloc(528);
-            if (buffer_encode2 == NULL){
-              fprintf(stderr, "Erreur malloc : buffer_encode\n");
-              return -1;
-            }
-
-
-            err_code = pkt_encode(packet_renvoi, buffer_encode2, 528);
-            if(err_code != PKT_OK){
-              fprintf(stderr, "Erreur encode\n");
-              return -1;
-            }
-
-
-            bytes_sent = sendto(sockfd, (void *) buffer_encode2, 528, 0, servinfo->ai_addr, servinfo->ai_addrlen);
-            if(bytes_sent == -1){
-              perror("Erreur sendto packet");
-              return -1;
-            }
-
-            sret = select(sockfd+1, &readfds, NULL, NULL, &tv);
-
-            while(sret == 0){
-              printf("Renvoi du paquet avec numéro de séquence %u\n", pkt_get_seqnum(packet_renvoi));
-              bytes_sent = sendto(sockfd, (void *) buffer_encode2, 528, 0, servinfo->ai_addr, servinfo->ai_addrlen);
-              if(bytes_sent == -1){
-                perror("Erreur sendto packet");
-                free(payload_buf);
-                pkt_del(packet);
-                close(sockfd);
-                close(fd);
-                return -1;
-              }
-
-
-              FD_ZERO(&readfds);
-              FD_SET(sockfd, &readfds);
-
-              tv.tv_sec = 2;
-              tv.tv_usec = 500000;
-
-              sret = select(sockfd+1, &readfds, NULL, NULL, &tv);
-            }
-
-            free(buffer_encode2);
-          }
+  // L'acquittement est cumulatif : il porte le prochain numero de sequence
+  // attendu. On ignore ceux qui n'acquittent aucun paquet en vol.
+  uint32_t acquittes = ack_seq - s->min_window;
+  if(acquittes > (uint32_t) s->en_vol){
+    return 0;
+  }
 
-        }
-        err = pkt_set_type(packet, PTYPE_DATA);
-        memset(ack_received, 0, 12);
-        packet->crc1 = 0;
-        packet->crc2 = 0;
-        packet->window = 0;
-        packet->tr = 0;
-        packet->length = 1;
-        strcpy(packet->payload, "");
-        ack_received->type = PTYPE_ACK;
+  // Avec l'extension, la fenetre annoncee est a l'echelle wscale. Un ACK
+  // tronque a perdu l'echelle : on garde la fenetre precedente.
+  if(!s->ext || ack->has_seq32){
+    s->window = s->ext ? (uint32_t) ack->window << s->wscale : ack->window;
+  }
+  else if(!ack->tr){
+    s->window = ack->window;
+  }
+  if(ack->has_sack){
+    s->sack_actif = 1;
+  }
+
+  // Un ACK qui n'acquitte rien alors que des paquets sont en vol signifie que
+  // le receiver a recu un paquet apres un trou : au troisieme, on renvoie le
+  // paquet manquant sans attendre son timer. Pendant une recuperation, les
+  // doublons viennent des renvois deja faits et ne signalent pas de perte.
+  if(acquittes == 0){
+    // Un doublon arrive apres l'ACK du dernier paquet en vol (plusieurs ACK
+    // du meme lot) ne signale plus rien
+    if(ack_sonde || s->en_vol == 0){
+      return 0;
+    }
+    // Avec SACK, on sait exactement quels paquets le receiver possede
+    if(ack->has_sack){
+      return traiter_sack(s, ack);
+    }
+    // Le paquet qui a declenche l'ACK est arrive apres le trou : seul le trou
+    // est suspect, les timers des paquets qui le suivent sont repousses
+    s->report_trou = time_now_us() + s->rtt.rto;
+    if(++s->nb_dupacks == SEUIL_DUPACKS && !s->cc.in_recovery){
+      cc_on_loss(&s->cc, s->nb_envoyes, time_now_us());
+      maj_pacing(s);
+      return renvoi_rapide(s);
+    }
+    return 0;
+  }
+  s->nb_dupacks = 0;
+
+  // On retire les paquets acquittes du buffer d'envoi et on fait glisser la fenetre
+  int en_vol = s->en_vol;
+  while(s->min_window != ack_seq){
+    pkt_t* packet = get_from_buffer(s->buffer_envoi, s->min_window);
+    if(packet == NULL || retire_buffer(s->buffer_envoi, s->min_window) != 0){
+      fprintf(stderr, "Erreur retire buffer\n");
+      return -1;
+    }
+    timer_cancel(s->timers, s->min_window);
+    if(s->sacke[s->min_window & (s->capacite - 1)]){
+      s->sacke[s->min_window & (s->capacite - 1)] = 0;
+      s->nb_sackes--;
+    }
+    pkt_slot_release(s->slab, packet);
+    s->en_vol--;
+    s->min_window++;
+  }
+  // Les plus grands paquets acquittes selectivement le sont maintenant tous
+  while(s->nb_plus_hauts > 0 && seq_lt(s->plus_hauts[s->nb_plus_hauts - 1], s->min_window)){
+    s->nb_plus_hauts--;
+  }
+  s->nb_acquittes += acquittes;
+  cc_on_ack(&s->cc, acquittes, s->nb_acquittes, en_vol, time_now_us(), &s->rtt);
+  maj_pacing(s);
 
+  // Le receiver progresse : on relance les timers des paquets en vol
+  // (RFC 6298, 5.3). Ils ne sont repousses qu'a leur expiration, pour ne pas
+  // parcourir tous les paquets en vol a chaque ACK.
+  s->report = time_now_us() + s->rtt.rto;
+
+  if(ack->has_sack){
+    return traiter_sack(s, ack);
+  }
+
+  // ACK partiel pendant la recuperation (NewReno) : le paquet suivant est
+  // lui aussi perdu, on le renvoie tout de suite. Avec le pacing, les paquets
+  // envoyes avant le renvoi arrivent encore un par un : seul un ACK declenche
+  // par un paquet parti apres le renvoi (timestamp renvoye) prouve le trou.
+  if(s->cc.in_recovery == CC_RECOVERY_LOSS && s->en_vol > 0 &&
+     (int32_t) (ack->timestamp - s->ts_renvoi_rapide) >= 0){
+    return renvoi_rapide(s);
+  }
+  return 0;
+}
+
+
+/*
+* recevoir_acks : Lit d'un coup tous les acquittements deja arrives et les
+* traite dans l'ordre. Les nouveaux paquets ne partent qu'ensuite, une fois
+* la fenetre mise a jour par tout le lot.
+*
+* @s : l'etat de l'emetteur
+*
+* @return : 0 si tout s'est bien deroule
+*           -1 en cas d'erreur
+*/
+static int recevoir_acks(sender_t *s){
+  ack_t *ack_received = s->ack_recu;
+
+  int nb_recus = rx_batch_recv(s->rx, MSG_DONTWAIT);
+  if(nb_recus < 0){
+    // Le socket connecte signale qu'un datagramme n'a pas trouve le receiver :
+    // pour nous, c'est une perte
+    if(errno == ECONNREFUSED || errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR){
+      return 0;
+    }
+    perror("Erreur receive ACK");
+    return -1;
+  }
+
+  size_t len;
+  uint8_t *data;
+  while((data = rx_batch_next(s->rx, &len)) != NULL){
+    // Un acquittement corrompu est simplement ignore
+    if(ack_decode(data, len, ack_received) != PKT_OK){
+      fprintf(stderr, "Acquittement ignoré\n");
+      continue;
+    }
+    if(traiter_ack(s, ack_received) == -1){
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+/*
+* gerer_timeouts : Renvoie chaque paquet dont le timer de retransmission a
+* expire. Un timer qui expire avant le report du dernier ACK (ou, apres le
+* trou, du dernier ACK duplique) est simplement rearme a cette heure. Le
+* paquet de fin est renvoye comme les autres, au plus MAX_RENVOIS_DECONNEXION
+* fois.
+*
+* @s : l'etat de l'emetteur
+*
+* @return : 0 si tout s'est bien deroule
+*           1 si on renonce a l'acquittement du paquet de fin
+*           -1 en cas d'erreur
+*/
+static int gerer_timeouts(sender_t *s){
+  uint32_t expires[MAX_TIMERS_EXPIRES];
+  uint64_t now = time_now_us();
+  int n = timer_expire(s->timers, now, expires, MAX_TIMERS_EXPIRES);
+  int i;
+  // Les cles des timers sont les numeros de sequence modulo capacite : les
+  // paquets en vol sont tous dans [min_window, min_window + capacite[
+  int nb_expires = 0;
+  for(i = 0; i < n; i++){
+    uint32_t seq = s->min_window + ((expires[i] - s->min_window) & (s->capacite - 1));
+    uint64_t report = s->report;
+    if(seq != s->min_window && s->report_trou > report){
+      report = s->report_trou;
+    }
+    if(report > now){
+      timer_arm(s->timers, seq, report);
+      continue;
+    }
+    expires[nb_expires++] = seq;
+  }
+  n = nb_expires;
+  // Sans reponse, le HELLO s'est peut-etre perdu : il repart avec les renvois
+  if(n > 0 && !s->connecte && s->nb_hello < MAX_HELLO && envoyer_hello(s) == -1){
+    return -1;
+  }
+  // Les paquets espaces par le pacer expirent l'un apres l'autre : on ne
+  // double le RTO qu'a l'expiration du plus ancien paquet non acquitte, une
+  // fois par episode, et non a chaque paquet
+  for(i = 0; i < n; i++){
+    if(expires[i] == s->min_window){
+      rtt_backoff(&s->rtt);
+      cc_on_timeout(&s->cc, s->nb_envoyes, time_now_us());
+      maj_pacing(s);
+      break;
+    }
+  }
+  for(i = 0; i < n; i++){
+    // Toutes les donnees ont ete acquittees : seul l'acquittement de fin s'est perdu
+    if(s->fin_envoyee && expires[i] == s->seq_fin && ++s->renvois_fin > MAX_RENVOIS_DECONNEXION){
+      fprintf(stderr, "Pas d'ACK de déconnexion, abandon.\n");
+      return 1;
+    }
+    pkt_t* packet_renvoi = get_from_buffer(s->buffer_envoi, expires[i]);
+    if(packet_renvoi != NULL){
+      fprintf(stderr, "Renvoi du paquet avec numéro de séquence %u\n", expires[i]);
+      if(envoyer_paquet(s, packet_renvoi, time_now_us()) == -1){
+        return -1;
       }
     }
   }
+  return 0;
+}
+
+
+/*
+* prochain_timeout : Calcule le temps d'attente jusqu'a la prochaine echeance :
+* expiration d'un timer de retransmission ou heure de depart du prochain paquet
+*
+* @s : l'etat de l'emetteur
+*
+* @return : le temps d'attente en microsecondes, ou -1 s'il n'y a aucune echeance
+*/
+static int64_t prochain_timeout(sender_t *s){
+  uint64_t now = time_now_us();
+  int64_t timeout = -1;
+
+  uint64_t deadline;
+  if(timer_next_deadline(s->timers, &deadline)){
+    timeout = deadline > now ? (int64_t) (deadline - now) : 0;
+  }
+
+  // Echeance de la sonde en vol
+  if(s->sonde_taille != 0){
+    int64_t delai = s->sonde_echeance > now ? (int64_t) (s->sonde_echeance - now) : 0;
+    if(timeout < 0 || delai < timeout){
+      timeout = delai;
+    }
+  }
+
+  // Le pacer ne compte que s'il retient un paquet que la fenetre laisserait partir
+  if(!s->txtime && !s->fin_lecture && !s->entree_vide && fenetre_ouverte(s)){
+    int64_t delai = (int64_t) pacer_delay(&s->pacer, now);
+    if(timeout < 0 || delai < timeout){
+      timeout = delai;
+    }
+  }
+  return timeout;
+}
+
+
+/*
+* envoyer_fin : Envoie le paquet de fin de transfert, une fois toutes les
+* donnees acquittees. Il est en vol comme un paquet de donnees : renvoye a
+* l'expiration de son timer, et retire de la fenetre par son acquittement.
+*
+* @s : l'etat de l'emetteur
+*
+* @return : 0 si le paquet a ete envoye
+*           -1 en cas d'erreur
+*/
+static int envoyer_fin(sender_t *s){
+
+  fprintf(stderr, "Déconnexion...\n");
+
+  pkt_t* packet = pkt_slot_acquire(s->slab);
+  if(packet == NULL){
+    fprintf(stderr, "Erreur de création du paquet \n");
+    return -1;
+  }
+
+  // Le paquet de fin a pour numero de sequence le dernier numero acquitte
+  if(pkt_set_seqnum(packet, s->seqnum) != PKT_OK || pkt_set_length(packet, 0) != PKT_OK ||
+     pkt_set_ext(packet, s->ext) != PKT_OK || ajout_buffer(packet, s->buffer_envoi) != 0){
+    pkt_slot_release(s->slab, packet);
+    return -1;
+  }
+  s->fin_envoyee = 1;
+  s->seq_fin = s->seqnum;
+  s->en_vol++;
+  s->seqnum++;
+  return envoyer_paquet(s, packet, time_now_us());
+}
+
+
+/*
+* avant_attente : Fait tout ce qui est pret avant que la boucle ne dorme :
+* nouveaux paquets, sonde du chemin ou paquet de fin, envoi du lot. Arme
+* ensuite la prochaine echeance.
+*
+* @ctx : l'etat de l'emetteur
+*
+* @return : 0 pour continuer
+*           1 quand le paquet de fin est acquitte
+*           -1 en cas d'erreur
+*/
+static int avant_attente(void *ctx){
+  sender_t *s = (sender_t *) ctx;
+
+  if(s->fin_envoyee){
+    if(s->en_vol == 0){
+      fprintf(stderr, "Reçu ACK de déconnexion.\n");
+      return 1;
+    }
+  }
+  else{
+    if(envoyer_donnees(s) == -1 || sonder_chemin(s) == -1){
+      return -1;
+    }
+    if(s->fin_lecture && s->en_vol == 0 && envoyer_fin(s) == -1){
+      return -1;
+    }
+  }
 
-  free(ack_received);
-  free(buffer_envoi);
-  pkt_del(packet);
+  // Tout ce qui est pret part en un appel systeme avant de dormir : un
+  // datagramme n'attend jamais plus d'un tour de boucle. Les lectures
+  // preparees entre-temps partent de meme.
+  if(s->io != NULL && io_ring_submit(s->io) == -1){
+    return -1;
+  }
+  if(tx_batch_flush(s->lot) == -1){
+    return -1;
+  }
+  return event_loop_timer(s->boucle, prochain_timeout(s));
+}
+
+
+/*
+* echeance : Une echeance a expire (peut-etre en avance) : chaque paquet
+* perdu est renvoye a l'expiration de son propre timer
+*
+* @ctx : l'etat de l'emetteur
+*
+* @return : 0 pour continuer, 1 pour arreter, -1 en cas d'erreur
+*/
+static int echeance(void *ctx){
+  return gerer_timeouts((sender_t *) ctx);
+}
 
 
-  freeaddrinfo(servinfo);
-  close(sockfd);
-  if(fd != 0){
-    close(fd);
+/*
+* socket_lisible : Des acquittements sont arrives
+*
+* @ctx : l'etat de l'emetteur
+*
+* @return : 0 pour continuer, -1 en cas d'erreur
+*/
+static int socket_lisible(void *ctx){
+  sender_t *s = (sender_t *) ctx;
+  // Les notifications MSG_ZEROCOPY signalent aussi le socket
+  if(tx_batch_completions(s->lot) == -1){
+    return -1;
   }
+  return recevoir_acks(s);
+}
 
-  printf("Fin de la transmission.\n");
+
+/*
+* entree_lisible : L'entree a de nouveau des donnees a lire
+*
+* @ctx : l'etat de l'emetteur
+*
+* @return : 0
+*/
+static int entree_lisible(void *ctx){
+  ((sender_t *) ctx)->entree_vide = 0;
   return 0;
 }
+
+
+/*
+* lectures_terminees : Des lectures io_uring du fichier d'entree sont
+* terminees
+*
+* @ctx : l'etat de l'emetteur
+*
+* @return : 0 pour continuer, -1 en cas d'erreur
+*/
+static int lectures_terminees(void *ctx){
+  sender_t *s = (sender_t *) ctx;
+  return io_ring_reap(s->io, lecture_terminee, s, 0) == -1 ? -1 : 0;
+}
+
+
+/*
+* lire_par_uring : Lit le fichier d'entree en avance par io_uring, a partir
+* de sa position courante
+*
+* @s : l'etat de l'emetteur
+*
+* @return : 0 si les premieres lectures sont soumises
+*           1 si io_uring n'est pas disponible
+*           -1 en cas d'erreur
+*/
+static int lire_par_uring(sender_t *s){
+  size_t taille_region;
+  void *region = pkt_slab_region(s->slab, &taille_region);
+  s->io = io_ring_new(2 * LECTURES_EN_AVANCE, region, taille_region);
+  if(s->io == NULL){
+    return 1;
+  }
+  off_t debut = lseek(s->fd, 0, SEEK_CUR);
+  s->offset_lecture = debut > 0 ? (uint64_t) debut : 0;
+  if(event_loop_add(s->boucle, io_ring_fd(s->io), 0, lectures_terminees) == -1 || lire_en_avance(s) == -1){
+    fprintf(stderr, "Erreur de lecture par io_uring\n");
+    return -1;
+  }
+  fprintf(stderr, "Lecture du fichier par io_uring\n");
+  return 0;
+}
+
+
+/*
+* main : Fonction principale
+*
+*/
+int main(int argc, char *argv[]) {
+
+  int err; // Variable pour error check
+
+  // Vérification du nombre d'arguments
+  err = arg_check(argc, 3, 15);
+  if(err == -1){
+    return -1;
+  }
+
+  sender_t s;
+  memset(&s, 0, sizeof(s));
+  s.fd = STDIN; // File descriptor avec lequel on va lire les données
+  // A l'ouverture de la connexion, le receiver est cense annoncer une fenetre de 1
+  s.window = 1;
+  s.min_window = 0;
+  s.seqnum = 0;
+  s.fenetre_max = MAX_WINDOW_SIZE;
+  s.mss = MAX_PAYLOAD_SIZE;
+  s.mss_max = MAX_PAYLOAD_SIZE;
+  rtt_init(&s.rtt);
+  s.csum = CSUM_CRC32;
+  crc_init(1);
+
+
+  // Prise en compte des arguments en ligne de commande
+  int a = 1;
+  char* hostname = NULL;
+  int host_set = 0;
+  char* port = NULL;
+  const cc_ops_t* algo_cc = cc_find("cubic");
+  int txtime = 0;
+  int zerocopy = 0;
+  int uring = 0;
+  for(; a < argc; a++){
+    if(strcmp(argv[a], "-f") == 0 && a + 1 < argc){
+      a++;
+      fprintf(stderr, "Lecture dans le fichier %s\n", argv[a]);
+      s.fd = open(argv[a], O_RDONLY);
+      if(s.fd == -1){
+        perror("Erreur open fichier source");
+        return -1;
+      }
+    }
+    else if(strcmp(argv[a], "-c") == 0 && a + 1 < argc){
+      a++;
+      algo_cc = cc_find(argv[a]);
+      if(algo_cc == NULL){
+        fprintf(stderr, "Controle de congestion inconnu : %s (newreno ou cubic)\n", argv[a]);
+        return -1;
+      }
+    }
+    else if(strcmp(argv[a], "-W") == 0 && a + 1 < argc){
+      // Accepte l'extension de sequence si le receiver l'offre, avec au plus
+      // MAX_WINDOW_SIZE << wscale paquets en vol
+      a++;
+      int wscale = atoi(argv[a]);
+      if(wscale < 0 || wscale > WSCALE_MAX){
+        fprintf(stderr, "Facteur d'echelle invalide : %s (0 a %d)\n", argv[a], WSCALE_MAX);
+        return -1;
+      }
+      s.offre_ext = 1;
+      s.wscale_max = wscale;
+    }
+    else if(strcmp(argv[a], "-M") == 0 && a + 1 < argc){
+      // Accepte des paquets jusqu'a n octets de payload si le receiver les
+      // offre et que le chemin les laisse passer
+      a++;
+      int mss = atoi(argv[a]);
+      if(mss < MAX_PAYLOAD_SIZE || mss > MSS_MAX){
+        fprintf(stderr, "Taille de payload invalide : %s (%d a %d)\n", argv[a], MAX_PAYLOAD_SIZE, MSS_MAX);
+        return -1;
+      }
+      s.mss_max = mss;
+    }
+    else if(strcmp(argv[a], "-t") == 0){
+      txtime = 1;
+    }
+    else if(strcmp(argv[a], "-Z") == 0){
+      // Le noyau envoie les payloads sans les copier (MSG_ZEROCOPY) : utile
+      // pour de grands paquets (-M), sinon la notification coute plus que la
+      // copie evitee
+      zerocopy = 1;
+    }
+    else if(strcmp(argv[a], "-U") == 0){
+      // Lit un fichier regulier par io_uring plutot que de le projeter en
+      // memoire
+      uring = 1;
+    }
+    else if(strcmp(argv[a], "-C") == 0){
+      // Propose CRC32C au receiver pour les paquets de donnees (instruction
+      // crc32 de SSE4.2)
+      s.offre_crc32c = 1;
+    }
+    else if(host_set == 0){
+      hostname = argv[a];
+      fprintf(stderr, "Hostname : %s\n", hostname);
+      host_set = 1;
+    }
+    else{
+      port = argv[a];
+      fprintf(stderr, "Port : %s\n", port);
+    }
+  }
+  if(s.fd == STDIN){
+    fprintf(stderr, "Lecture sur l'entrée standard.\n");
+  }
+  fprintf(stderr, "Controle de congestion : %s\n", algo_cc->name);
+  cc_init(&s.cc, algo_cc, time_now_us());
+  pacer_init(&s.pacer, TAILLE_PAQUET);
+
+  // Création du socket
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET6;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_protocol = IPPROTO_UDP;
+
+  err = getaddrinfo(hostname, port, &hints, &s.servinfo);
+  if(err != 0){
+    fprintf(stderr, "Erreur getaddrinfo : %s\n", gai_strerror(err));
+    return -1;
+  }
+
+  s.sockfd = socket(s.servinfo->ai_family, s.servinfo->ai_socktype, s.servinfo->ai_protocol);
+  if(s.sockfd == -1){
+    perror("Erreur socket");
+    freeaddrinfo(s.servinfo);
+    return -1;
+  }
+
+  // Socket connecte : les envois ne portent plus l'adresse du receiver, et
+  // seuls ses datagrammes sont recus
+  if(connect(s.sockfd, s.servinfo->ai_addr, s.servinfo->ai_addrlen) == -1){
+    perror("Erreur connect");
+    freeaddrinfo(s.servinfo);
+    close(s.sockfd);
+    return -1;
+  }
+
+#ifdef SO_TXTIME
+  // Heures de depart confiees au noyau : demande une qdisc qui les respecte
+  // (fq ou etf), sinon les paquets partent immediatement
+  if(txtime){
+    struct sock_txtime cfg = { .clockid = CLOCK_MONOTONIC, .flags = 0 };
+    if(setsockopt(s.sockfd, SOL_SOCKET, SO_TXTIME, &cfg, sizeof(cfg)) == 0){
+      s.txtime = 1;
+      fprintf(stderr, "Pacing par le noyau (SO_TXTIME)\n");
+    }
+    else{
+      perror("SO_TXTIME indisponible, pacing dans l'espace utilisateur");
+    }
+  }
+#else
+  if(txtime){
+    fprintf(stderr, "SO_TXTIME indisponible, pacing dans l'espace utilisateur\n");
+  }
+#endif
+
+#ifdef IPV6_DONTFRAG
+  // Les sondes ne doivent pas etre fragmentees : un paquet trop grand pour le
+  // chemin est refuse par le noyau ou perdu, jamais decoupe
+  if(s.mss_max > MAX_PAYLOAD_SIZE){
+    int un = 1;
+    if(setsockopt(s.sockfd, IPPROTO_IPV6, IPV6_DONTFRAG, &un, sizeof(un)) == -1){
+      perror("IPV6_DONTFRAG indisponible");
+    }
+  }
+#endif
+
+  s.taille_encode = (size_t) s.mss_max + 16;
+  s.buffer_encode = (uint8_t *) malloc(s.taille_encode);
+  s.buffer_lecture = (char *) malloc(s.mss_max);
+  s.lot = tx_batch_new(s.sockfd, TX_BATCH_MAX, s.taille_encode, s.txtime);
+  s.rx = rx_batch_new(s.sockfd, RX_BATCH_MAX, 12 + MAX_ACK_PAYLOAD_SIZE + 4, 0);
+  if(s.buffer_encode == NULL || s.buffer_lecture == NULL || s.lot == NULL || s.rx == NULL){
+    fprintf(stderr, "Erreur malloc\n");
+    return -1;
+  }
+  if(zerocopy){
+    if(tx_batch_zerocopy(s.lot) == 0){
+      fprintf(stderr, "Envoi sans copie (MSG_ZEROCOPY)\n");
+    }
+    else{
+      perror("MSG_ZEROCOPY indisponible");
+    }
+  }
+
+  s.ack_recu = ack_new();
+  if(s.ack_recu == NULL){
+    fprintf(stderr, "Erreur de création du paquet d'acquittement \n");
+    return -1;
+  }
+
+  // Les tables indexees par numero de sequence couvrent la plus grande
+  // fenetre possible
+  uint32_t fenetre = s.offre_ext ? (uint32_t) MAX_WINDOW_SIZE << s.wscale_max : MAX_WINDOW_SIZE;
+  s.capacite = 64;
+  while(s.capacite <= fenetre){
+    s.capacite <<= 1;
+  }
+  s.sacke = (uint8_t *) calloc(s.capacite, sizeof(uint8_t));
+  s.saut = (uint32_t *) calloc(s.capacite, sizeof(uint32_t));
+  if(s.sacke == NULL || s.saut == NULL){
+    fprintf(stderr, "Erreur malloc\n");
+    return -1;
+  }
+
+  s.timers = timer_wheel_new(s.capacite, time_now_us());
+  if(s.timers == NULL){
+    fprintf(stderr, "Erreur de création des timers \n");
+    return -1;
+  }
+
+  // Tous les paquets de la fenetre sont alloues des le depart, ainsi que
+  // ceux des lectures en avance : en regime etabli, l'envoi ne fait plus
+  // aucune allocation
+  s.slab = pkt_slab_new(fenetre + 1 + LECTURES_EN_AVANCE, s.mss_max);
+  s.buffer_envoi = pkt_buffer_new(s.capacite);
+  if(s.slab == NULL || s.buffer_envoi == NULL){
+    fprintf(stderr, "Erreur de création des paquets \n");
+    return -1;
+  }
+
+  // Boucle d'envoi : on remplit la fenetre a chaque tour, et on se reveille
+  // pour un acquittement, une echeance ou de nouvelles donnees en entree
+  s.boucle = event_loop_new(&s, avant_attente, echeance);
+  if(s.boucle == NULL || event_loop_add(s.boucle, s.sockfd, 0, socket_lisible) == -1){
+    fprintf(stderr, "Erreur de création de la boucle d'événements\n");
+    return -1;
+  }
+  // Un pipe ou un terminal est surveille : sa lecture ne bloque plus
+  // l'envoi. Un fichier regulier est toujours lisible (EPERM) : il est
+  // projete en memoire, et les paquets envoient leur payload depuis la
+  // projection. Avec -U, il est plutot lu en avance par io_uring, s'il est
+  // disponible ; io_uring est aussi le recours quand la projection echoue.
+  int flags_entree = fcntl(s.fd, F_GETFL);
+  if(event_loop_add(s.boucle, s.fd, 1, entree_lisible) == 0){
+    fcntl(s.fd, F_SETFL, flags_entree | O_NONBLOCK);
+  }
+  else if(errno == EPERM){
+    int err = 1;
+    if(uring){
+      err = lire_par_uring(&s);
+      if(err == 1){
+        fprintf(stderr, "io_uring indisponible\n");
+      }
+    }
+    if(err == 1 && projeter_entree(&s) == 0){
+      fprintf(stderr, "Fichier projeté en mémoire\n");
+      err = 0;
+    }
+    if(err == 1 && !uring){
+      err = lire_par_uring(&s);
+    }
+    if(err == -1){
+      return -1;
+    }
+  }
+  else{
+    perror("Erreur epoll entrée");
+    return -1;
+  }
+
+  // Les premieres donnees suivent directement le HELLO
+  int ret = envoyer_hello(&s);
+  if(ret == 0){
+    ret = event_loop_run(s.boucle);
+  }
+
+  event_loop_del(s.boucle);
+  fcntl(s.fd, F_SETFL, flags_entree);
+  if(s.io != NULL){
+    // Les lectures encore en vol ecrivent dans le slab : on attend leur fin
+    while(io_ring_en_vol(s.io) > 0 && io_ring_reap(s.io, lecture_terminee, &s, 1) != -1);
+    for(; s.nb_lectures > 0; s.nb_lectures--){
+      pkt_slot_release(s.slab, s.lectures[s.premiere_lecture]);
+      s.premiere_lecture = (s.premiere_lecture + 1) % LECTURES_EN_AVANCE;
+    }
+    io_ring_del(s.io);
+  }
+  if(s.projection != NULL){
+    munmap((void *) s.projection, s.taille_projection);
+  }
+  buffer_vider(s.buffer_envoi, s.slab);
+  pkt_buffer_del(s.buffer_envoi);
+  free(s.sacke);
+  free(s.saut);
+  free(s.buffer_encode);
+  tx_batch_del(s.lot);
+  rx_batch_del(s.rx);
+  free(s.buffer_lecture);
+  free(s.ack_recu);
+  timer_wheel_del(s.timers);
+  pkt_slab_del(s.slab);
+
+  freeaddrinfo(s.servinfo);
+  close(s.sockfd);
+  if(s.fd != STDIN){
+    close(s.fd);
+  }
+
+  if(ret == 0){
+    fprintf(stderr, "Fin de la transmission.\n");
+  }
+  return ret;
+}
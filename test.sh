@@ -1,18 +1,58 @@
 #!/bin/bash
 
-# cleanup d'un test précédent
-rm -f received_file input_file
+# Transfert d'un fichier aléatoire à travers le simulateur de lien, avec 10%
+# de pertes et un délais de 50ms
+# $1 : taille du fichier en octets
+# $2 : options communes au sender et au receiver
+# $3 : options du receiver seul
+transfert()
+{
+  # cleanup d'un test précédent
+  rm -f received_file input_file
+
+  # Fichier au contenu aléatoire
+  head -c $1 /dev/urandom > input_file
+
+  # On lance le simulateur de lien avec 10% de pertes et un délais de 50ms
+  ./link_sim -p 1341 -P 2456 -l 10 -d 50 -R  &> link.log &
+  link_pid=$!
+
+  # On lance le receiver et capture sa sortie standard
+  ./receiver $2 $3 -f received_file :: 2456  2> receiver.log &
+  receiver_pid=$!
 
-# Fichier au contenu aléatoire de 512 octets
-dd if=/dev/urandom of=input_file bs=1 count=512 &> /dev/null
+  # On démarre le transfert
+  if ! ./sender $2 ::1 1341 < input_file 2> sender.log ; then
+    echo "Crash du sender!"
+    cat sender.log
+    err=1  # On enregistre l'erreur
+  fi
+
+  sleep 5 # On attend 5 seconde que le receiver finisse
+
+  if kill -0 $receiver_pid &> /dev/null ; then
+    echo "Le receiver ne s'est pas arreté à la fin du transfert!"
+    kill -9 $receiver_pid
+    err=1
+  else  # On teste la valeur de retour du receiver
+    if ! wait $receiver_pid ; then
+      echo "Crash du receiver!"
+      cat receiver.log
+      err=1
+    fi
+  fi
 
-# On lance le simulateur de lien avec 10% de pertes et un délais de 50ms
-./link_sim -p 1341 -P 2456 -l 10 -d 50 -R  &> link.log &
-link_pid=$!
+  # On arrête le simulateur de lien
+  kill -9 $link_pid &> /dev/null
 
-# On lance le receiver et capture sa sortie standard
-./receiver -f received_file :: 2456  2> receiver.log &
-receiver_pid=$!
+  # On vérifie que le transfert s'est bien déroulé
+  if [[ "$(md5sum input_file | awk '{print $1}')" != "$(md5sum received_file | awk '{print $1}')" ]]; then
+    echo "Le transfert a corrompu le fichier!"
+    echo "Diff binaire des deux fichiers: (attendu vs produit)"
+    diff -C 9 <(od -Ax -t x1z input_file) <(od -Ax -t x1z received_file)
+    exit 1
+  fi
+}
 
 cleanup()
 {
@@ -22,37 +62,12 @@ cleanup()
 }
 trap cleanup SIGINT  # Kill les process en arrière plan en cas de ^-C
 
-# On démarre le transfert
-if ! ./sender ::1 1341 < input_file 2> sender.log ; then
-  echo "Crash du sender!"
-  cat sender.log
-  err=1  # On enregistre l'erreur
-fi
-
-sleep 5 # On attend 5 seconde que le receiver finisse
-
-if kill -0 $receiver_pid &> /dev/null ; then
-  echo "Le receiver ne s'est pas arreté à la fin du transfert!"
-  kill -9 $receiver_pid
-  err=1
-else  # On teste la valeur de retour du receiver
-  if ! wait $receiver_pid ; then
-    echo "Crash du receiver!"
-    cat receiver.log
-    err=1
-  fi
-fi
-
-# On arrête le simulateur de lien
-kill -9 $link_pid &> /dev/null
-
-# On vérifie que le transfert s'est bien déroulé
-if [[ "$(md5sum input_file | awk '{print $1}')" != "$(md5sum received_file | awk '{print $1}')" ]]; then
-  echo "Le transfert a corrompu le fichier!"
-  echo "Diff binaire des deux fichiers: (attendu vs produit)"
-  diff -C 9 <(od -Ax -t x1z input_file) <(od -Ax -t x1z received_file)
-  exit 1
-else
-  echo "Le transfert est réussi!"
-  exit ${err:-0}  # En cas d'erreurs avant, on renvoie le code d'erreur
-fi
+# 512 octets avec la fenetre de base
+transfert 512 ""
+
+# 100 ko avec une fenetre agrandie (extension de sequence) : les pertes sont
+# reparees par SACK sur toute la fenetre
+transfert 102400 "-W 4" "-s"
+
+echo "Le transfert est réussi!"
+exit ${err:-0}  # En cas d'erreurs avant, on renvoie le code d'erreur
@@ -0,0 +1,248 @@
+// @Titre : Projet LINGI1341 : Réseaux informatiques
+// @Auteurs : Francois DE KEERSMAEKER (7367 1600) & Margaux GERARD (7659 1600)
+// @Date : 22 octobre 2018
+
+/*
+* Bench CRC : compare les moteurs de checksum de la librairie (slicing-by-8,
+*             PCLMULQDQ, SSE4.2), seuls et par lots (crc32_multi), au crc32
+*             de zlib, apres avoir verifie qu'ils donnent les memes resultats.
+*
+*/
+
+#include "../src/lib.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+
+/* Octets traites pour chaque mesure */
+#define OCTETS_PAR_MESURE (256u << 20)
+
+/* Tailles mesurees : un header, un payload par defaut, un jumbo, 64 Ko */
+static const size_t tailles[] = {8, 512, 9000, 65536};
+
+/* Buffers par appel de crc32_multi, comme un lot de paquets */
+#define LOT_BUFFERS 32
+
+/* Donnees aleatoires : un lot de buffers de la plus grande taille */
+#define TAILLE_DONNEES (LOT_BUFFERS * 65536 + 8)
+
+
+/*
+* crc32c_reference : Calcule le CRC32C bit a bit, sans table
+*
+* @crc : le CRC des donnees precedentes (0 au depart)
+* @p : les donnees
+* @len : leur taille
+*
+* @return : le CRC des donnees precedentes suivies de p
+*/
+static uint32_t crc32c_reference(uint32_t crc, const uint8_t *p, size_t len){
+  crc = ~crc;
+  while(len-- > 0){
+    crc ^= *p++;
+    int k;
+    for(k = 0; k < 8; k++){
+      crc = crc & 1 ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+    }
+  }
+  return ~crc;
+}
+
+
+static uint32_t crc32_zlib(uint32_t crc, const void *buf, size_t len){
+  return (uint32_t) crc32(crc, (const Bytef *) buf, len);
+}
+
+
+/*
+* verifier : Compare les moteurs courants aux references, pour toutes les
+* tailles jusqu'a 1 Ko et tous les alignements, et en plusieurs morceaux
+*
+* @buf : des donnees aleatoires d'au moins 65536 + 8 octets
+*
+* @return : le nombre de resultats faux
+*/
+static int verifier(const uint8_t *buf){
+  int faux = 0;
+  size_t debut, len;
+  for(debut = 0; debut < 8; debut++){
+    for(len = 0; len <= 1024; len++){
+      if(crc32_ieee(0, buf + debut, len) != crc32_zlib(0, buf + debut, len)){
+        faux++;
+      }
+      if(crc32c(0, buf + debut, len) != crc32c_reference(0, buf + debut, len)){
+        faux++;
+      }
+      // Continuation : le CRC2 d'un paquet etendu est calcule en deux fois
+      if(crc32_ieee(crc32_ieee(0, buf, debut), buf + debut, len) != crc32_zlib(0, buf, debut + len)){
+        faux++;
+      }
+    }
+  }
+  // Copie avec checksum : meme CRC, copie exacte, rien d'ecrit apres
+  uint8_t copie[1024 + 8];
+  for(debut = 0; debut < 8; debut++){
+    for(len = 0; len <= 1024; len++){
+      memset(copie, 0xA5, sizeof(copie));
+      if(crc_copier(CSUM_CRC32, 0, copie + debut, buf + len % 8, len) != crc32_zlib(0, buf + len % 8, len) ||
+         memcmp(copie + debut, buf + len % 8, len) != 0 || copie[debut + len] != 0xA5){
+        faux++;
+      }
+      if(crc_copier(CSUM_CRC32C, 0, copie + debut, buf + len % 8, len) != crc32c_reference(0, buf + len % 8, len) ||
+         memcmp(copie + debut, buf + len % 8, len) != 0){
+        faux++;
+      }
+    }
+  }
+  if(crc32_ieee(0, buf, 65536) != crc32_zlib(0, buf, 65536) ||
+     crc32c(0, buf, 65536) != crc32c_reference(0, buf, 65536)){
+    faux++;
+  }
+  // Lots de buffers de tailles et d'alignements differents, avec un CRC
+  // initial comme le CRC2 d'un paquet etendu
+  int lot;
+  for(lot = 0; lot < 2000; lot++){
+    const uint8_t *bufs[LOT_BUFFERS];
+    size_t lens[LOT_BUFFERS];
+    uint32_t initial[LOT_BUFFERS], crcs[LOT_BUFFERS], crcs_c[LOT_BUFFERS];
+    int n = 1 + rand() % LOT_BUFFERS;
+    int j;
+    for(j = 0; j < n; j++){
+      bufs[j] = buf + rand() % 64;
+      lens[j] = rand() % 4 == 0 ? 8 : (size_t) rand() % 2000;
+      initial[j] = crcs[j] = crcs_c[j] = (uint32_t) rand();
+    }
+    crc32_multi(CSUM_CRC32, bufs, lens, crcs, n);
+    crc32_multi(CSUM_CRC32C, bufs, lens, crcs_c, n);
+    for(j = 0; j < n; j++){
+      if(crcs[j] != crc32_zlib(initial[j], bufs[j], lens[j]) ||
+         crcs_c[j] != crc32c_reference(initial[j], bufs[j], lens[j])){
+        faux++;
+      }
+    }
+  }
+  return faux;
+}
+
+
+/*
+* mesurer : Affiche le debit d'un checksum pour chaque taille de buffer
+*
+* @nom : le nom affiche
+* @crc : le checksum
+* @buf : les donnees
+*
+* @return : /
+*/
+static void mesurer(const char *nom, crc_fn_t crc, const uint8_t *buf){
+  printf("%-22s", nom);
+  size_t i;
+  for(i = 0; i < sizeof(tailles) / sizeof(tailles[0]); i++){
+    size_t n = OCTETS_PAR_MESURE / tailles[i];
+    uint32_t c = 0;
+    uint64_t debut = time_now_us();
+    size_t k;
+    for(k = 0; k < n; k++){
+      c ^= crc(0, buf, tailles[i]);
+    }
+    uint64_t duree = time_now_us() - debut;
+    // c est affiche pour que le compilateur ne supprime pas la boucle
+    printf(" %8.2f", duree > 0 ? (double) n * tailles[i] / duree / 1000.0 : 0.0);
+    if(c == 0x12345678){
+      printf("*");
+    }
+  }
+  printf("\n");
+}
+
+
+/*
+* mesurer_multi : Affiche le debit de crc32_multi sur des lots de buffers
+* distincts, pour chaque taille de buffer
+*
+* @nom : le nom affiche
+* @csum : le checksum
+* @buf : les donnees, d'au moins LOT_BUFFERS * 65536 octets
+*
+* @return : /
+*/
+static void mesurer_multi(const char *nom, uint8_t csum, const uint8_t *buf){
+  printf("%-22s", nom);
+  size_t i;
+  for(i = 0; i < sizeof(tailles) / sizeof(tailles[0]); i++){
+    const uint8_t *bufs[LOT_BUFFERS];
+    size_t lens[LOT_BUFFERS];
+    uint32_t crcs[LOT_BUFFERS];
+    int j;
+    for(j = 0; j < LOT_BUFFERS; j++){
+      bufs[j] = buf + (size_t) j * tailles[i];
+      lens[j] = tailles[i];
+    }
+    size_t n = OCTETS_PAR_MESURE / tailles[i] / LOT_BUFFERS;
+    uint32_t c = 0;
+    uint64_t debut = time_now_us();
+    size_t k;
+    for(k = 0; k < n; k++){
+      memset(crcs, 0, sizeof(crcs));
+      crc32_multi(csum, bufs, lens, crcs, LOT_BUFFERS);
+      c ^= crcs[k % LOT_BUFFERS];
+    }
+    uint64_t duree = time_now_us() - debut;
+    printf(" %8.2f", duree > 0 ? (double) n * LOT_BUFFERS * tailles[i] / duree / 1000.0 : 0.0);
+    if(c == 0x12345678){
+      printf("*");
+    }
+  }
+  printf("\n");
+}
+
+
+/*
+* main : Fonction principale
+*
+*/
+int main(void){
+  uint8_t *buf = (uint8_t *) malloc(TAILLE_DONNEES);
+  if(buf == NULL){
+    fprintf(stderr, "Erreur malloc\n");
+    return 1;
+  }
+  srand(42);
+  size_t i;
+  for(i = 0; i < TAILLE_DONNEES; i++){
+    buf[i] = (uint8_t) rand();
+  }
+
+  printf("%-22s", "Go/s");
+  for(i = 0; i < sizeof(tailles) / sizeof(tailles[0]); i++){
+    printf(" %8zu", tailles[i]);
+  }
+  printf("\n");
+  mesurer("zlib crc32", crc32_zlib, buf);
+
+  int faux = 0;
+  int materiel;
+  for(materiel = 0; materiel <= 1; materiel++){
+    crc_init(materiel);
+    faux += verifier(buf);
+    char nom[64];
+    snprintf(nom, sizeof(nom), "CRC32 %s", crc_moteur(CSUM_CRC32));
+    mesurer(nom, crc32_ieee, buf);
+    snprintf(nom, sizeof(nom), "CRC32C %s", crc_moteur(CSUM_CRC32C));
+    mesurer(nom, crc32c, buf);
+    snprintf(nom, sizeof(nom), "CRC32 %s x%d", crc_moteur(CSUM_CRC32), LOT_BUFFERS);
+    mesurer_multi(nom, CSUM_CRC32, buf);
+    snprintf(nom, sizeof(nom), "CRC32C %s x%d", crc_moteur(CSUM_CRC32C), LOT_BUFFERS);
+    mesurer_multi(nom, CSUM_CRC32C, buf);
+  }
+
+  free(buf);
+  if(faux > 0){
+    fprintf(stderr, "%d résultats faux\n", faux);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,185 @@
+// @Titre : Projet LINGI1341 : Réseaux informatiques
+// @Auteurs : Francois DE KEERSMAEKER (7367 1600) & Margaux GERARD (7659 1600)
+// @Date : 22 octobre 2018
+
+/*
+* Test des acquittements : verifie l'encodage puis le decodage des options
+*                          TLV des ACK (SACK, WSCALE, SEQ32, MSS, SACK_OK,
+*                          ACK_DELAY, CSUM), ainsi que le rejet d'un TLV
+*                          tronque et l'option inconnue ignoree.
+*
+*/
+
+#include "../src/lib.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+/* Taille maximale d'un ACK encode : header, options et CRC2 */
+#define TAILLE_MAX_ACK (12 + MAX_ACK_PAYLOAD_SIZE + 4)
+
+static int nb_erreurs = 0;
+
+#define VERIFIER(cond) do{ \
+    if(!(cond)){ \
+      fprintf(stderr, "%s:%d : echec de %s\n", __FILE__, __LINE__, #cond); \
+      nb_erreurs++; \
+    } \
+  } while(0)
+
+
+/*
+* construire : Ecrit un ACK a la main autour d'options deja encodees, avec
+* ses deux CRC
+*
+* @buf : le buffer, d'au moins TAILLE_MAX_ACK octets
+* @options : les options
+* @length : la taille des options
+*
+* @return : la taille de l'ACK
+*/
+static size_t construire(uint8_t *buf, const uint8_t *options, uint16_t length){
+  buf[0] = (PTYPE_ACK << 6) | 7;
+  buf[1] = 42;
+  uint16_t length_net = htons(length);
+  memcpy(buf+2, &length_net, 2);
+  uint32_t timestamp = htonl(0xdeadbeef);
+  memcpy(buf+4, &timestamp, 4);
+  uint32_t crc1 = htonl(crc32_ieee(0, buf, 8));
+  memcpy(buf+8, &crc1, 4);
+  if(length == 0){
+    return 12;
+  }
+  memcpy(buf+12, options, length);
+  uint32_t crc2 = htonl(crc32_ieee(0, options, length));
+  memcpy(buf+12+length, &crc2, 4);
+  return 12 + length + 4;
+}
+
+
+/*
+* test_aller_retour : Encode un ACK portant toutes les options et verifie
+* qu'elles sont retrouvees au decodage
+*
+* @return : /
+*/
+static void test_aller_retour(void){
+  ack_t *ack = ack_new();
+  ack_t *decode = ack_new();
+  uint8_t buf[TAILLE_MAX_ACK];
+  size_t len = sizeof(buf);
+
+  sack_bloc_t blocs[ACK_SACK_MAX_BLOCS];
+  int i;
+  for(i = 0; i < ACK_SACK_MAX_BLOCS; i++){
+    blocs[i].debut = 1 + 300 * i;
+    blocs[i].nb = 1000 - i;
+  }
+  ack->type = PTYPE_ACK;
+  ack->window = 17;
+  ack->seqnum = 0x12345678;
+  ack->timestamp = 0xcafe;
+  ack_set_sack(ack, 1, blocs, ACK_SACK_MAX_BLOCS);
+  ack_set_ext(ack, 1, 6, 1);
+  ack_set_mss(ack, 1, 1400, 1200);
+  ack_set_hello(ack, 1, 2500, CSUM_CRC32 | CSUM_CRC32C);
+
+  VERIFIER(ack_encode(ack, buf, &len) == PKT_OK);
+  VERIFIER(len == (size_t) 12 + ack->length + 4);
+  VERIFIER(ack_decode(buf, len, decode) == PKT_OK);
+  VERIFIER(decode->type == PTYPE_ACK && decode->window == 17 && decode->timestamp == 0xcafe);
+  VERIFIER(decode->has_seq32 && decode->seqnum == 0x12345678);
+  VERIFIER(decode->has_sack && decode->nb_sack == ACK_SACK_MAX_BLOCS);
+  VERIFIER(memcmp(decode->sack, blocs, sizeof(blocs)) == 0);
+  VERIFIER(decode->has_wscale && decode->wscale == 6);
+  VERIFIER(decode->has_mss && decode->mss == 1400 && decode->mss_recu == 1200);
+  VERIFIER(decode->sack_ok && decode->ack_delay == 2500);
+  VERIFIER(decode->csum == (CSUM_CRC32 | CSUM_CRC32C));
+
+  // Option SACK vide : l'ACK annonce seulement qu'il est selectif
+  ack_set_sack(ack, 1, NULL, 0);
+  ack_set_ext(ack, 0, 0, 0);
+  ack_set_mss(ack, 0, 0, 0);
+  ack_set_hello(ack, 0, 0, 0);
+  len = sizeof(buf);
+  VERIFIER(ack_encode(ack, buf, &len) == PKT_OK);
+  VERIFIER(ack_decode(buf, len, decode) == PKT_OK);
+  VERIFIER(decode->has_sack && decode->nb_sack == 0);
+  VERIFIER(!decode->has_seq32 && decode->seqnum == 0x78);
+  VERIFIER(!decode->has_wscale && !decode->has_mss && !decode->sack_ok);
+  VERIFIER(decode->ack_delay == 0 && decode->csum == 0);
+
+  // Sans option, l'ACK n'a pas de CRC2
+  ack_set_sack(ack, 0, NULL, 0);
+  len = sizeof(buf);
+  VERIFIER(ack_encode(ack, buf, &len) == PKT_OK && len == 12);
+  VERIFIER(ack_decode(buf, len, decode) == PKT_OK && !decode->has_sack);
+
+  free(ack);
+  free(decode);
+}
+
+
+/*
+* test_options_a_la_main : Decode des ACK construits a la main : option
+* inconnue, TLV tronque, taille incoherente
+*
+* @return : /
+*/
+static void test_options_a_la_main(void){
+  ack_t *decode = ack_new();
+  uint8_t buf[TAILLE_MAX_ACK + 8];
+
+  // Une option inconnue est ignoree, celles qui l'entourent sont lues
+  uint8_t inconnue[] = {ACK_OPT_WSCALE, ACK_OPT_WSCALE_LEN, 3,
+                        200, 5, 1, 2, 3, 4, 5,
+                        ACK_OPT_CSUM, ACK_OPT_CSUM_LEN, CSUM_CRC32};
+  size_t len = construire(buf, inconnue, sizeof(inconnue));
+  VERIFIER(ack_decode(buf, len, decode) == PKT_OK);
+  VERIFIER(decode->has_wscale && decode->wscale == 3);
+  VERIFIER(decode->csum == CSUM_CRC32 && !decode->has_sack);
+
+  // Une option de taille inattendue est ignoree comme une option inconnue
+  uint8_t mauvaise_taille[] = {ACK_OPT_SEQ32, 2, 0, 1,
+                               ACK_OPT_SACK, 3, 0, 1, 0};
+  len = construire(buf, mauvaise_taille, sizeof(mauvaise_taille));
+  VERIFIER(ack_decode(buf, len, decode) == PKT_OK);
+  VERIFIER(!decode->has_seq32 && !decode->has_sack && decode->seqnum == 42);
+
+  // La valeur du dernier TLV depasse les options : l'ACK est rejete
+  uint8_t tronque[] = {ACK_OPT_SACK_OK, ACK_OPT_SACK_OK_LEN,
+                       ACK_OPT_ACK_DELAY, ACK_OPT_ACK_DELAY_LEN, 0, 0};
+  len = construire(buf, tronque, sizeof(tronque));
+  VERIFIER(ack_decode(buf, len, decode) == E_UNCONSISTENT);
+
+  // Un octet isole en fin d'options ne forme pas de TLV : il est ignore
+  uint8_t octet_isole[] = {ACK_OPT_SACK_OK, ACK_OPT_SACK_OK_LEN, ACK_OPT_CSUM};
+  len = construire(buf, octet_isole, sizeof(octet_isole));
+  VERIFIER(ack_decode(buf, len, decode) == PKT_OK && decode->sack_ok && decode->csum == 0);
+
+  // Taille du datagramme differente de celle annoncee, ou trop grande
+  len = construire(buf, inconnue, sizeof(inconnue));
+  VERIFIER(ack_decode(buf, len - 1, decode) == E_UNCONSISTENT);
+  VERIFIER(ack_decode(buf, len + 1, decode) == E_UNCONSISTENT);
+  VERIFIER(ack_decode(buf, TAILLE_MAX_ACK + 1, decode) == E_UNCONSISTENT);
+
+  // Options corrompues : le CRC2 ne correspond plus
+  buf[12 + 2] ^= 1;
+  VERIFIER(ack_decode(buf, len, decode) == E_CRC);
+
+  free(decode);
+}
+
+
+int main(void){
+  test_aller_retour();
+  test_options_a_la_main();
+  if(nb_erreurs > 0){
+    fprintf(stderr, "Options des ACK : %d erreurs\n", nb_erreurs);
+    return EXIT_FAILURE;
+  }
+  printf("Options des ACK : OK\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,222 @@
+// @Titre : Projet LINGI1341 : Réseaux informatiques
+// @Auteurs : Francois DE KEERSMAEKER (7367 1600) & Margaux GERARD (7659 1600)
+// @Date : 22 octobre 2018
+
+/*
+* Test des timers : verifie la roue de timers de la librairie (armement,
+*                   annulation, expiration, prochaine echeance), en
+*                   particulier au passage d'un tour de roue et pour des
+*                   echeances a plus de TIMER_WHEEL_SLOTS tours.
+*
+*/
+
+#include "../src/lib.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Nombre de cles de la roue du test aleatoire */
+#define NB_CLES 512
+/* Nombre d'operations du test aleatoire */
+#define NB_OPERATIONS 200000
+
+/* Duree d'un tour de roue, en microsecondes */
+#define TOUR_US ((uint64_t) TIMER_WHEEL_SLOTS * TIMER_WHEEL_TICK_US)
+
+static int nb_erreurs = 0;
+
+#define VERIFIER(cond) do{ \
+    if(!(cond)){ \
+      fprintf(stderr, "%s:%d : echec de %s\n", __FILE__, __LINE__, #cond); \
+      nb_erreurs++; \
+    } \
+  } while(0)
+
+
+/*
+* expirer : Fait expirer les timers a une heure donnee
+*
+* @tw : la roue de timers
+* @now : l'heure
+* @cle : ou stocker la cle expiree, s'il y en a une seule
+*
+* @return : le nombre de timers expires
+*/
+static int expirer(timer_wheel_t *tw, uint64_t now, uint32_t *cle){
+  uint32_t cles[NB_CLES];
+  int n = timer_expire(tw, now, cles, NB_CLES);
+  if(n == 1){
+    *cle = cles[0];
+  }
+  return n;
+}
+
+
+/*
+* attendre : Simule la boucle d'evenements : dort jusqu'a la prochaine
+* echeance annoncee et fait expirer les timers, jusqu'a en obtenir un
+*
+* @tw : la roue de timers
+* @now : l'heure courante, avancee jusqu'a l'expiration
+* @reveils : le nombre de reveils necessaires
+*
+* @return : la cle expiree, ou NB_CLES si aucune
+*/
+static uint32_t attendre(timer_wheel_t *tw, uint64_t *now, int *reveils){
+  uint64_t deadline;
+  uint32_t cle = NB_CLES;
+  *reveils = 0;
+  while(timer_next_deadline(tw, &deadline) && *reveils < 1000){
+    if(deadline > *now){
+      *now = deadline;
+    }
+    (*reveils)++;
+    if(expirer(tw, *now, &cle) > 0){
+      return cle;
+    }
+  }
+  return NB_CLES;
+}
+
+
+/*
+* test_tours : Timers au passage d'un tour de roue, au-dela d'un tour, et a
+* plus de TIMER_WHEEL_SLOTS tours (meme case de debordement qu'un tour proche)
+*
+* @return : /
+*/
+static void test_tours(void){
+  // Dernier tick d'un tour
+  uint64_t now = 1000 * TOUR_US + TOUR_US - TIMER_WHEEL_TICK_US;
+  timer_wheel_t *tw = timer_wheel_new(NB_CLES, now);
+  uint32_t cle;
+  int reveils;
+  uint64_t deadline;
+
+  // Echeances de part et d'autre du debut du tour suivant
+  timer_arm(tw, 1, now + 2 * TIMER_WHEEL_TICK_US);
+  timer_arm(tw, 2, now + 300 * TIMER_WHEEL_TICK_US);
+  VERIFIER(timer_next_deadline(tw, &deadline) && deadline == now + 2 * TIMER_WHEEL_TICK_US);
+  VERIFIER(expirer(tw, now + TIMER_WHEEL_TICK_US, &cle) == 0);
+  VERIFIER(expirer(tw, now + 2 * TIMER_WHEEL_TICK_US, &cle) == 1 && cle == 1);
+  VERIFIER(attendre(tw, &now, &reveils) == 2 && now == 1001 * TOUR_US + 299 * TIMER_WHEEL_TICK_US);
+
+  // Un tour plus loin que TIMER_WHEEL_SLOTS tours partage la case de
+  // debordement du tour suivant : il ne doit pas expirer avec lui
+  uint64_t proche = now + TOUR_US + 17;
+  uint64_t lointain = proche + TIMER_WHEEL_SLOTS * TOUR_US;
+  timer_arm(tw, 3, lointain);
+  timer_arm(tw, 4, proche);
+  VERIFIER(timer_next_deadline(tw, &deadline) && deadline <= proche);
+  VERIFIER(attendre(tw, &now, &reveils) == 4 && now == proche && reveils <= 2);
+  VERIFIER(timer_is_armed(tw, 3) && !timer_is_armed(tw, 4));
+  VERIFIER(attendre(tw, &now, &reveils) == 3 && now == lointain && reveils <= 2);
+
+  // Un timer annule dans la roue de debordement n'expire plus
+  timer_arm(tw, 5, now + 10 * TOUR_US);
+  timer_cancel(tw, 5);
+  VERIFIER(!timer_is_armed(tw, 5) && !timer_next_deadline(tw, &deadline));
+  VERIFIER(expirer(tw, now + 20 * TOUR_US, &cle) == 0);
+
+  // Rearme plus tot depuis la roue de debordement, puis plus tard
+  now += 20 * TOUR_US;
+  timer_arm(tw, 6, now + 5 * TOUR_US);
+  timer_arm(tw, 6, now + 3);
+  VERIFIER(attendre(tw, &now, &reveils) == 6 && reveils == 1);
+  timer_arm(tw, 7, now + 3);
+  timer_arm(tw, 7, now + 700 * TOUR_US);
+  VERIFIER(expirer(tw, now + TOUR_US, &cle) == 0);
+  // Un reveil par passage sur sa case de debordement, puis l'echeance exacte
+  VERIFIER(attendre(tw, &now, &reveils) == 7 && reveils <= 700 / TIMER_WHEEL_SLOTS + 2);
+
+  // Echeance deja depassee : expire au prochain appel
+  timer_arm(tw, 8, now - 5 * TOUR_US);
+  VERIFIER(timer_next_deadline(tw, &deadline) && deadline <= now);
+  VERIFIER(expirer(tw, now, &cle) == 1 && cle == 8);
+
+  timer_wheel_del(tw);
+}
+
+
+/*
+* test_aleatoire : Compare la roue a un modele naif sur une suite aleatoire
+* d'armements, d'annulations et d'avances de l'heure, courtes ou longues
+*
+* @return : /
+*/
+static void test_aleatoire(void){
+  uint64_t now = 123456789;
+  uint64_t echeances[NB_CLES];
+  int armes[NB_CLES];
+  memset(armes, 0, sizeof(armes));
+  timer_wheel_t *tw = timer_wheel_new(NB_CLES, now);
+  srand(1341);
+
+  int i;
+  for(i = 0; i < NB_OPERATIONS; i++){
+    uint32_t cle = rand() % NB_CLES;
+    int op = rand() % 8;
+    if(op < 3){
+      // Jusqu'a 1 s, parfois jusqu'a 100 s
+      uint64_t delai = (uint64_t) rand() % (op == 0 ? 100000000 : 1000000);
+      echeances[cle] = now + delai;
+      armes[cle] = 1;
+      timer_arm(tw, cle, echeances[cle]);
+    }
+    else if(op == 3){
+      armes[cle] = 0;
+      timer_cancel(tw, cle);
+    }
+    else{
+      uint64_t deadline;
+      uint64_t min = 0;
+      int nb_armes = 0;
+      uint32_t k;
+      for(k = 0; k < NB_CLES; k++){
+        VERIFIER(timer_is_armed(tw, k) == armes[k]);
+        if(armes[k] && (nb_armes++ == 0 || echeances[k] < min)){
+          min = echeances[k];
+        }
+      }
+      // La prochaine echeance ne doit jamais etre plus tard que la vraie
+      int trouve = timer_next_deadline(tw, &deadline);
+      VERIFIER(trouve == (nb_armes > 0));
+      VERIFIER(!trouve || deadline <= min);
+
+      // Avance jusqu'a l'echeance annoncee, ou plus loin
+      if(op == 4 && trouve && deadline > now){
+        now = deadline;
+      }
+      else{
+        now += (uint64_t) rand() % (op == 5 ? 3 * TOUR_US : 2000);
+      }
+      uint32_t cles[NB_CLES];
+      int n = timer_expire(tw, now, cles, NB_CLES);
+      int j;
+      for(j = 0; j < n; j++){
+        VERIFIER(armes[cles[j]] && echeances[cles[j]] <= now);
+        armes[cles[j]] = 0;
+      }
+      for(k = 0; k < NB_CLES; k++){
+        VERIFIER(!armes[k] || echeances[k] > now);
+      }
+    }
+    if(nb_erreurs > 10){
+      break;
+    }
+  }
+  timer_wheel_del(tw);
+}
+
+
+int main(void){
+  test_tours();
+  test_aleatoire();
+  if(nb_erreurs > 0){
+    fprintf(stderr, "Roue de timers : %d erreurs\n", nb_erreurs);
+    return EXIT_FAILURE;
+  }
+  printf("Roue de timers : OK\n");
+  return EXIT_SUCCESS;
+}